@@ -39,12 +39,47 @@
  * -----------------------------------------------------------------------------*/
 
 #define _USE_MATH_DEFINES
+#include <limits.h>
 #include <math.h>
-#include <Windows.h>  //To be removed when speedtesting is complete
-#include <stdio.h>    //To be removed when speedtesting is complete
-#include <inttypes.h> //To be removed when speedtesting is complete
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "AvCalc.h"
 
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <Windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+/* The batch kernels use x86 intrinsics selected per function with the GCC
+   target attribute, so the library itself is still built without -mavx. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define AVCALC_X86_SIMD 1
+    #include <immintrin.h>
+#else
+    #define AVCALC_X86_SIMD 0
+#endif
+
+/* Floating point exception flags are not part of the interface of this
+   library. Without this the compiler must keep every comparison behind a
+   branch, which stops the batch loops from being vectorized. The same
+   holds for errno and sqrt(), which is why the build scripts pass
+   -fno-math-errno (it cannot be set from a pragma). */
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC optimize ("no-trapping-math")
+#endif
+
+/* Helpers of the batch loops must be inlined into each per-kernel copy,
+   or the loops calling them are not vectorized */
+#if defined(__GNUC__)
+    #define AVCALC_INLINE static inline __attribute__((always_inline))
+#else
+    #define AVCALC_INLINE static __forceinline
+#endif
+
 
 /*--------------------------------------------------------------------------
   Section with calculations pertaining to navigation
@@ -174,114 +209,6855 @@ void AVCALCCALL IntermediatePoint (const double *lat1, const double *lon1, const
 
 
 /*--------------------------------------------------------------------------
-  Section with calculations pertaining to the ICAO standard atmoshpere
+  Section with calculations on prepared points
+
+  A prepared point holds the sine and cosine of its latitude and longitude
+  and its unit vector, so that functions taking prepared points need no
+  conversion to radians and no sin/cos of the end points. Points that are
+  used many times, such as a waypoint database, can be prepared once.
 --------------------------------------------------------------------------*/
 
 
 /*--------------------------------------------------------------------------
-  The standard temperature at altitude
-
-  Given the geopotential altitude in feet, the function returns
-  temperature in °C
+  Prepare a point
 ----------------------------------------------------------------------------
   Implementation
-  Argument 1: INPUT - Pointer to double containing altitude in feet
+  Argument 1: INPUT  - Pointer to double containing Latitude  in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude in degrees
+  Argument 3: OUTPUT - Pointer to the prepared point
 
-  RETURN: Double containing temperature in °C
+  RETURN: None
 --------------------------------------------------------------------------*/
-double AVCALCCALL Standard_temperature(const double *pressure_alt){
-    const double h = *pressure_alt; // feet
+void AVCALCCALL PreparePoint(const double *lat, const double *lon, PreparedPoint *point)
+{
+    double radLat = D2R * *lat;
+    double radLon = D2R * *lon;
 
-    // Band boundaries (feet)
-    const double h0 = -5000 / 0.3048;  // -5 km  (below sea level)
-    const double h1 = 0.0;             //  0 km  (sea level)
-    const double h2 = 11000 / 0.3048;  // 11 km  (lower tropopause)
-    const double h3 = 20000 / 0.3048;  // 20 km  (upper tropopause)
-    const double h4 = 32000 / 0.3048;  // 32 km  (middle stratosphere)
-    const double h5 = 47000 / 0.3048;  // 47 km  (lower stratopause)
-    const double h6 = 51000 / 0.3048;  // 51 km  (upper stratopause)
-    const double h7 = 71000 / 0.3048;  // 71 km  (middle mesosphere)
-    const double h8 = 80000 / 0.3048;  // 80 km  (lower mesopause)
-
-    // Reject out-of-range inputs
-    if (h < h0 || h > h8) {
-        return NAN; // Out of modeled range [-5 km, 80 km]
+    point->lat    = *lat;
+    point->lon    = *lon;
+    point->sinlat = sin(radLat);
+    point->coslat = cos(radLat);
+    point->sinlon = sin(radLon);
+    point->coslon = cos(radLon);
+    point->x = point->coslat * point->coslon;
+    point->y = point->coslat * point->sinlon;
+    point->z = point->sinlat;
+    point->psi = atanh(point->sinlat);
+}
+
+/*--------------------------------------------------------------------------
+  Prepare n points given as separate arrays
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  in degrees
+  Argument 2: INPUT  - Array of n longitudes in degrees
+  Argument 3: OUTPUT - Array of n prepared points
+  Argument 4: INPUT  - Number of points
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL PreparePoints(const double *lat, const double *lon, PreparedPoint *points, int n)
+{
+    for (int i = 0; i < n; i++) {
+        PreparePoint(&lat[i], &lon[i], &points[i]);
     }
+}
 
-    // Lapse rates (°C per foot), converted from °C/km
-    const double L0 = -6.5 / 3280.84; // -5 km to 0 km  (troposphere)
-    const double L1 = -6.5 / 3280.84; //  0 km to 11 km (troposphere)
-    const double L2 =  0.0;           // 11 km to 20 km (tropsopause, isothermal)
-    const double L3 =  1.0 / 3280.84; // 20 km to 32 km (stratosphere, lower)
-    const double L4 =  2.8 / 3280.84; // 32 km to 47 km (stratosphere, upper)
-    const double L5 =  0.0;           // 47 km to 51 km (stratopause, isothermal)
-    const double L6 = -2.8 / 3280.84; // 51 km to 71 km (mesosphere, lower)
-    const double L7 = -2.0 / 3280.84; // 71 km to 80 km (mesosphere, upper)
-
-    // Anchor temperatures at band starts (continuous)
-    const double T0 = 15.0 - L0 * (h1 - h0);           // at -5 km (≈47.5°C)
-    const double T1 = 15.0;                            // at 0 ft
-    const double T2 = T1 + L1 * (h2 - h1);             // at 11 km
-    const double T3 = T2 + L2 * (h3 - h2);             // at 20 km
-    const double T4 = T3 + L3 * (h4 - h3);             // at 32 km
-    const double T5 = T4 + L4 * (h5 - h4);             // at 47 km
-    const double T6 = T5 + L5 * (h6 - h5);             // at 51 km
-    const double T7 = T6 + L6 * (h7 - h6);             // at 71 km
-    const double T8 = T7 + L7 * (h8 - h7);             // at 80 km
-
-    // Calculate temperature based on altitude band
-    if (h < h1) return T0 + L0 * (h - h0);        // -5 km to 0 km
-    if (h < h2) return T1 + L1 * (h - h1);        // 0 to 11 km
-    if (h < h3) return T2 + L2 * (h - h2);        // 11 to 20 km (iso)
-    if (h < h4) return T3 + L3 * (h - h3);        // 20 to 32 km
-    if (h < h5) return T4 + L4 * (h - h4);        // 32 to 47 km
-    if (h < h6) return T5 + L5 * (h - h5);        // 47 to 51 km (iso)
-    if (h < h7) return T6 + L6 * (h - h6);        // 51 to 71 km
-    /* h <= h8 */ return T7 + L7 * (h - h7);      // 71 to 80 km
+/* Angle in radians between two prepared points, from the cross and dot
+   products of their unit vectors. Also returns |p1 x p2| = sin(d). */
+static double prepared_angle(const PreparedPoint *p1, const PreparedPoint *p2, double *sind)
+{
+    double cx = p1->y * p2->z - p1->z * p2->y;
+    double cy = p1->z * p2->x - p1->x * p2->z;
+    double cz = p1->x * p2->y - p1->y * p2->x;
+    double dot = p1->x * p2->x + p1->y * p2->y + p1->z * p2->z;
+
+    *sind = sqrt(cx * cx + cy * cy + cz * cz);
+    return atan2(*sind, dot);
 }
 
+/*--------------------------------------------------------------------------
+  Distance between prepared points
 
+  Same great circle distance as Distance(). The angle is taken as
+  atan2(|p1 x p2|, p1 . p2), which is well conditioned both for nearby
+  and for nearly antipodal points.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to prepared point 1
+  Argument 2: INPUT - Pointer to prepared point 2
 
-double AVCALCCALL TAS_2(const double *CAS, const double *pressure_alt, const double *oat){
-    return -1; //To be implemented
+  RETURN: Double containing distance in nautical miles (1nm = 1852m)
+--------------------------------------------------------------------------*/
+double AVCALCCALL DistancePrepared(const PreparedPoint *p1, const PreparedPoint *p2)
+{
+    double sind;
+
+    return 60 * R2D * prepared_angle(p1, p2, &sind);
 }
-double AVCALCCALL CAS_2(const double *TAS, const double *pressure_alt, const double *oat){
-    return -1; //To be implemented	
+
+/*--------------------------------------------------------------------------
+  Course between prepared points
+
+  Same initial course as CourseInitial(), including the special case of a
+  pole as starting point. sin and cos of the longitude difference follow
+  from the cached values by the angle difference identities.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to prepared point 1
+  Argument 2: INPUT - Pointer to prepared point 2
+
+  RETURN: Double containing initial course in degrees from point1 to point 2
+--------------------------------------------------------------------------*/
+double AVCALCCALL CourseInitialPrepared(const PreparedPoint *p1, const PreparedPoint *p2)
+{
+    double sindlon, cosdlon;
+
+    if (p1->coslat < EPS) {     // EPS a small number ~ machine precision
+        if (p1->sinlat > 0) {
+            return R2D * M_PI;      //  Starting position is North pole, return true course south
+        } else {
+            return R2D * 2*M_PI;    //  Starting position is South pole, return true course north
+        }
+    }
+
+    sindlon = p2->sinlon * p1->coslon - p2->coslon * p1->sinlon;   // sin(lon2-lon1)
+    cosdlon = p2->coslon * p1->coslon + p2->sinlon * p1->sinlon;   // cos(lon2-lon1)
+    return R2D * fmod(atan2(sindlon * p2->coslat,
+                            p1->coslat * p2->sinlat - p1->sinlat * p2->coslat * cosdlon
+                           ),
+                      2*M_PI
+                     );
 }
 
-double AVCALCCALL Speed_of_sound(const double *oat){
-    return 38.967854 * sqrt(273.15 + *oat); //Speed of sound in ft/s
+/*--------------------------------------------------------------------------
+  Intermediate point between prepared points
+
+  Same point as IntermediatePoint(). The unit vectors of the end points
+  are cached and sin(d) is the length of their cross product, so only
+  the two weights need a sine. If the points coincide the result is
+  point 1.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to prepared point 1
+  Argument 2: INPUT  - Pointer to prepared point 2
+  Argument 3: INPUT  - Pointer to double containing the fraction of the
+                       distance from point 1 (0) to point 2 (1)
+  Argument 4: OUTPUT - Pointer to double receiving Latitude  in degrees
+  Argument 5: OUTPUT - Pointer to double receiving Longitude in degrees
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL IntermediatePointPrepared(const PreparedPoint *p1, const PreparedPoint *p2, const double *fraction, double *latresult, double *lonresult)
+{
+    double A, B, x, y, z, d, sind;
+
+    d = prepared_angle(p1, p2, &sind);
+    if (sind == 0.0) {
+        *latresult = p1->lat;
+        *lonresult = p1->lon;
+        return;
+    }
+
+    A = sin((1-*fraction)*d)/sind;
+    B = sin(*fraction*d)/sind;
+    x = A*p1->x + B*p2->x;
+    y = A*p1->y + B*p2->y;
+    z = A*p1->z + B*p2->z;
+    *latresult = R2D * atan2(z,sqrt(x*x+y*y));
+    *lonresult = R2D * atan2(y,x);
 }
 
-double AVCALCCALL Pressure_at_altitude(const double *h){
-    double p = 0.0;
-	  double p_Tr = 0.0;
-
-    if (*h < 36089.24) {
-        p = P_0 * pow(1.0 - 6.8755856e-6 * (*h), 5.2558797);
-        return p;
-    } else if ((*h >= 36089.24) && (*h < 65616.8)) {
-        p_Tr = 22632.06;  //Pressure at the tropopause
-        p = p_Tr * exp(-4.806346e-5 * (*h - 36089.24));
-        return p;
+
+
+
+/*--------------------------------------------------------------------------
+  Section with batch (structure-of-arrays) navigation calculations
+
+  The batch functions take separate arrays for each coordinate and process
+  a whole array per call. They use polynomial approximations of sin, cos
+  and asin in place of the C library so that the same arithmetic can run
+  in SIMD registers. Each kernel (scalar, AVX2, AVX-512) performs exactly
+  the same sequence of IEEE operations, without fused multiply-add, so all
+  kernels return the same results on SSE2 and later.
+
+  The kernel is chosen when the library is loaded, based on the features
+  of the CPU, and can be overridden with BatchKernelSelect().
+--------------------------------------------------------------------------*/
+
+// Keep the compiler from fusing multiply-add pairs, which would make the
+// results depend on the kernel and on the compiler flags
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC push_options
+    #pragma GCC optimize ("fp-contract=off")
+#endif
+
+// sin(x) = x + x^3*S(x^2) on [-pi/4, pi/4] (Cephes sin.c)
+static const double poly_sin_coef[6] = {
+     1.58962301576546568060E-10,
+    -2.50507477628578072866E-8,
+     2.75573136213857245213E-6,
+    -1.98412698295895385996E-4,
+     8.33333333332211858878E-3,
+    -1.66666666666666307295E-1
+};
+
+// cos(x) = 1 - x^2/2 + x^4*C(x^2) on [-pi/4, pi/4] (Cephes sin.c)
+static const double poly_cos_coef[6] = {
+    -1.13585365213876817300E-11,
+     2.08757008419747316778E-9,
+    -2.75573141792967388112E-7,
+     2.48015872888517045348E-5,
+    -1.38888888888730564116E-3,
+     4.16666666666665929218E-2
+};
+
+// asin(x) = x + x^3*P(x^2)/Q(x^2) for 0 <= x <= 0.625 (Cephes asin.c)
+static const double poly_asin_p[6] = {
+     4.253011369004428248960E-3,
+    -6.019598008014123785661E-1,
+     5.444622390564711410273E0,
+    -1.626247967210700244449E1,
+     1.956261983317594739197E1,
+    -8.198089802484824371615E0
+};
+static const double poly_asin_q[5] = {   // leading coefficient 1 implied
+    -1.474091372988853791896E1,
+     7.049610280856842141659E1,
+    -1.471791292232726029859E2,
+     1.395105614657485689735E2,
+    -4.918853881490881290097E1
+};
+
+// asin(1-x) = pi/2 - sqrt(2x)*(1 + x*R(x)/S(x)) for x = 1-a, a > 0.625
+static const double poly_asin_r[5] = {
+     2.967721961301243206100E-3,
+    -5.634242780008963776856E-1,
+     6.968710824104713396794E0,
+    -2.556901049652824852289E1,
+     2.853665548261061424989E1
+};
+static const double poly_asin_s[4] = {   // leading coefficient 1 implied
+    -2.194779531642920639778E1,
+     1.470656354026814941758E2,
+    -3.838770957603691357202E2,
+     3.424398657913078477438E2
+};
+
+#define POLY_PIO4     7.85398163397448309616E-1
+#define POLY_MOREBITS 6.123233995736765886130E-17
+#define NM_PER_HALF_RADIAN (120.0 * R2D)   // 2 * 60 * R2D, nm per radian of half angle
+
+
+/*--------------------------------------------------------------------------
+  Scalar polynomial kernels
+
+  sin of an angle in degrees. The argument is reduced by whole quadrants
+  in degrees, which is exact, before it is converted to radians. quadrant
+  is added to the quadrant count, so 1 gives the cosine.
+--------------------------------------------------------------------------*/
+static double poly_sind(double deg, double quadrant)
+{
+    double k = nearbyint(deg * (1.0 / 90.0));
+    double r = (deg - k * 90.0) * D2R;
+    double q = k + quadrant;
+    double z = r * r;
+    double s, c, v;
+
+    q = q - 4.0 * floor(q * 0.25);    // quadrant 0..3
+
+    s = poly_sin_coef[0];
+    s = s * z + poly_sin_coef[1];
+    s = s * z + poly_sin_coef[2];
+    s = s * z + poly_sin_coef[3];
+    s = s * z + poly_sin_coef[4];
+    s = s * z + poly_sin_coef[5];
+    s = r + r * z * s;
+
+    c = poly_cos_coef[0];
+    c = c * z + poly_cos_coef[1];
+    c = c * z + poly_cos_coef[2];
+    c = c * z + poly_cos_coef[3];
+    c = c * z + poly_cos_coef[4];
+    c = c * z + poly_cos_coef[5];
+    c = 1.0 - 0.5 * z + z * z * c;
+
+    v = (q == 1.0 || q == 3.0) ? c : s;
+    return (q >= 2.0) ? -v : v;
+}
+
+// asin of a non-negative argument a <= 1
+static double poly_asin_pos(double a)
+{
+    double zz, p, q, z;
+
+    if (a > 0.625) {
+        zz = 1.0 - a;
+        p = poly_asin_r[0];
+        p = p * zz + poly_asin_r[1];
+        p = p * zz + poly_asin_r[2];
+        p = p * zz + poly_asin_r[3];
+        p = p * zz + poly_asin_r[4];
+        q = zz + poly_asin_s[0];
+        q = q * zz + poly_asin_s[1];
+        q = q * zz + poly_asin_s[2];
+        q = q * zz + poly_asin_s[3];
+        p = zz * p / q;
+        zz = sqrt(zz + zz);
+        z = POLY_PIO4 - zz;
+        zz = zz * p - POLY_MOREBITS;
+        z = z - zz;
+        return z + POLY_PIO4;
     } else {
-        return -1; //Error condition	
+        zz = a * a;
+        p = poly_asin_p[0];
+        p = p * zz + poly_asin_p[1];
+        p = p * zz + poly_asin_p[2];
+        p = p * zz + poly_asin_p[3];
+        p = p * zz + poly_asin_p[4];
+        p = p * zz + poly_asin_p[5];
+        q = zz + poly_asin_q[0];
+        q = q * zz + poly_asin_q[1];
+        q = q * zz + poly_asin_q[2];
+        q = q * zz + poly_asin_q[3];
+        q = q * zz + poly_asin_q[4];
+        z = zz * p / q;
+        return a * z + a;
     }
 }
 
-double AVCALCCALL Density_at_altitude(const double *h, const double *oat){
-    double rho = 0.0;
-    double rho_Tr = 0.0;
-
-    if (*h < 36089.24) {
-        rho	= rho_0*pow(1.0 - 6.8755856e-6 * (*h), 4.2558797);
-        return rho;
-    } else if ((*h >= 36089.24) && (*h < 65616.8)) {
-        rho_Tr = 0.2970756 * rho_0;
-        rho=rho_Tr*exp(-4.806346e-5 * (*h-36089.24));
-        return rho;
-    } else {
-        return -1; //Error condition
+// Haversine distance in nm, same formula as Distance()
+static double distance_poly(double lat1, double lon1, double lat2, double lon2)
+{
+    double s1 = poly_sind((lat1 - lat2) * 0.5, 0.0);
+    double s2 = poly_sind((lon2 - lon1) * 0.5, 0.0);
+    double c1 = poly_sind(lat1, 1.0);
+    double c2 = poly_sind(lat2, 1.0);
+    double h  = s1 * s1 + s2 * s2 * c1 * c2;
+
+    h = (h < 1.0) ? h : 1.0;    // rounding can push antipodal points past 1
+    return NM_PER_HALF_RADIAN * poly_asin_pos(sqrt(h));
+}
+
+static void distance_batch_scalar(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dist[i] = distance_poly(lat1[i], lon1[i], lat2[i], lon2[i]);
+    }
+}
+
+/* Distance in nm from one unit vector {x1,y1,z1} to m others, from the
+   chord between them. The vectors are built by unit_vector_poly(). */
+static void distance_row_scalar(double x1, double y1, double z1, const double *x2, const double *y2, const double *z2, double *dist, int m)
+{
+    for (int j = 0; j < m; j++) {
+        double dx = x1 - x2[j];
+        double dy = y1 - y2[j];
+        double dz = z1 - z2[j];
+        double a  = 0.5 * sqrt(dx * dx + dy * dy + dz * dz);
+
+        a = (a < 1.0) ? a : 1.0;
+        dist[j] = NM_PER_HALF_RADIAN * poly_asin_pos(a);
+    }
+}
+
+// Unit (earth centred, earth fixed) vector of a point in degrees
+static void unit_vector_poly(double lat, double lon, double *x, double *y, double *z)
+{
+    double coslat = poly_sind(lat, 1.0);
+
+    *x = coslat * poly_sind(lon, 1.0);
+    *y = coslat * poly_sind(lon, 0.0);
+    *z = poly_sind(lat, 0.0);
+}
+
+
+#if AVCALC_X86_SIMD
+/*--------------------------------------------------------------------------
+  AVX2 kernels, 4 lanes. Mirrors the scalar kernels operation by operation.
+--------------------------------------------------------------------------*/
+#define AVX2_POLY(acc, x, coef, i) acc = _mm256_add_pd(_mm256_mul_pd(acc, x), _mm256_set1_pd(coef[i]))
+
+__attribute__((target("avx2")))
+static __m256d poly_sind_avx2(__m256d deg, double quadrant)
+{
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(deg, _mm256_set1_pd(1.0 / 90.0)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_mul_pd(_mm256_sub_pd(deg, _mm256_mul_pd(k, _mm256_set1_pd(90.0))), _mm256_set1_pd(D2R));
+    __m256d q = _mm256_add_pd(k, _mm256_set1_pd(quadrant));
+    __m256d z = _mm256_mul_pd(r, r);
+    __m256d s, c, v, swap, neg;
+
+    q = _mm256_sub_pd(q, _mm256_mul_pd(_mm256_set1_pd(4.0), _mm256_floor_pd(_mm256_mul_pd(q, _mm256_set1_pd(0.25)))));
+
+    s = _mm256_set1_pd(poly_sin_coef[0]);
+    AVX2_POLY(s, z, poly_sin_coef, 1);
+    AVX2_POLY(s, z, poly_sin_coef, 2);
+    AVX2_POLY(s, z, poly_sin_coef, 3);
+    AVX2_POLY(s, z, poly_sin_coef, 4);
+    AVX2_POLY(s, z, poly_sin_coef, 5);
+    s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), s));
+
+    c = _mm256_set1_pd(poly_cos_coef[0]);
+    AVX2_POLY(c, z, poly_cos_coef, 1);
+    AVX2_POLY(c, z, poly_cos_coef, 2);
+    AVX2_POLY(c, z, poly_cos_coef, 3);
+    AVX2_POLY(c, z, poly_cos_coef, 4);
+    AVX2_POLY(c, z, poly_cos_coef, 5);
+    c = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(0.5), z)),
+                      _mm256_mul_pd(_mm256_mul_pd(z, z), c));
+
+    swap = _mm256_or_pd(_mm256_cmp_pd(q, _mm256_set1_pd(1.0), _CMP_EQ_OQ),
+                        _mm256_cmp_pd(q, _mm256_set1_pd(3.0), _CMP_EQ_OQ));
+    neg  = _mm256_cmp_pd(q, _mm256_set1_pd(2.0), _CMP_GE_OQ);
+    v = _mm256_blendv_pd(s, c, swap);
+    return _mm256_xor_pd(v, _mm256_and_pd(neg, _mm256_set1_pd(-0.0)));
+}
+
+__attribute__((target("avx2")))
+static __m256d poly_asin_pos_avx2(__m256d a)
+{
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d zz, p, q, hi, lo;
+
+    // a > 0.625
+    zz = _mm256_sub_pd(one, a);
+    p = _mm256_set1_pd(poly_asin_r[0]);
+    AVX2_POLY(p, zz, poly_asin_r, 1);
+    AVX2_POLY(p, zz, poly_asin_r, 2);
+    AVX2_POLY(p, zz, poly_asin_r, 3);
+    AVX2_POLY(p, zz, poly_asin_r, 4);
+    q = _mm256_add_pd(zz, _mm256_set1_pd(poly_asin_s[0]));
+    AVX2_POLY(q, zz, poly_asin_s, 1);
+    AVX2_POLY(q, zz, poly_asin_s, 2);
+    AVX2_POLY(q, zz, poly_asin_s, 3);
+    p = _mm256_div_pd(_mm256_mul_pd(zz, p), q);
+    zz = _mm256_sqrt_pd(_mm256_add_pd(zz, zz));
+    hi = _mm256_sub_pd(_mm256_set1_pd(POLY_PIO4), zz);
+    zz = _mm256_sub_pd(_mm256_mul_pd(zz, p), _mm256_set1_pd(POLY_MOREBITS));
+    hi = _mm256_sub_pd(hi, zz);
+    hi = _mm256_add_pd(hi, _mm256_set1_pd(POLY_PIO4));
+
+    // a <= 0.625
+    zz = _mm256_mul_pd(a, a);
+    p = _mm256_set1_pd(poly_asin_p[0]);
+    AVX2_POLY(p, zz, poly_asin_p, 1);
+    AVX2_POLY(p, zz, poly_asin_p, 2);
+    AVX2_POLY(p, zz, poly_asin_p, 3);
+    AVX2_POLY(p, zz, poly_asin_p, 4);
+    AVX2_POLY(p, zz, poly_asin_p, 5);
+    q = _mm256_add_pd(zz, _mm256_set1_pd(poly_asin_q[0]));
+    AVX2_POLY(q, zz, poly_asin_q, 1);
+    AVX2_POLY(q, zz, poly_asin_q, 2);
+    AVX2_POLY(q, zz, poly_asin_q, 3);
+    AVX2_POLY(q, zz, poly_asin_q, 4);
+    lo = _mm256_div_pd(_mm256_mul_pd(zz, p), q);
+    lo = _mm256_add_pd(_mm256_mul_pd(a, lo), a);
+
+    return _mm256_blendv_pd(lo, hi, _mm256_cmp_pd(a, _mm256_set1_pd(0.625), _CMP_GT_OQ));
+}
+
+__attribute__((target("avx2")))
+static void distance_batch_avx2(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d la1 = _mm256_loadu_pd(lat1 + i);
+        __m256d lo1 = _mm256_loadu_pd(lon1 + i);
+        __m256d la2 = _mm256_loadu_pd(lat2 + i);
+        __m256d lo2 = _mm256_loadu_pd(lon2 + i);
+        __m256d s1 = poly_sind_avx2(_mm256_mul_pd(_mm256_sub_pd(la1, la2), half), 0.0);
+        __m256d s2 = poly_sind_avx2(_mm256_mul_pd(_mm256_sub_pd(lo2, lo1), half), 0.0);
+        __m256d c1 = poly_sind_avx2(la1, 1.0);
+        __m256d c2 = poly_sind_avx2(la2, 1.0);
+        __m256d h  = _mm256_add_pd(_mm256_mul_pd(s1, s1),
+                                   _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(s2, s2), c1), c2));
+
+        h = _mm256_min_pd(h, _mm256_set1_pd(1.0));
+        h = poly_asin_pos_avx2(_mm256_sqrt_pd(h));
+        _mm256_storeu_pd(dist + i, _mm256_mul_pd(_mm256_set1_pd(NM_PER_HALF_RADIAN), h));
+    }
+    distance_batch_scalar(lat1 + i, lon1 + i, lat2 + i, lon2 + i, dist + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void distance_row_avx2(double x1, double y1, double z1, const double *x2, const double *y2, const double *z2, double *dist, int m)
+{
+    const __m256d vx1 = _mm256_set1_pd(x1), vy1 = _mm256_set1_pd(y1), vz1 = _mm256_set1_pd(z1);
+    int j = 0;
+
+    for (; j + 4 <= m; j += 4) {
+        __m256d dx = _mm256_sub_pd(vx1, _mm256_loadu_pd(x2 + j));
+        __m256d dy = _mm256_sub_pd(vy1, _mm256_loadu_pd(y2 + j));
+        __m256d dz = _mm256_sub_pd(vz1, _mm256_loadu_pd(z2 + j));
+        __m256d a  = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+
+        a = _mm256_min_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_sqrt_pd(a)), _mm256_set1_pd(1.0));
+        _mm256_storeu_pd(dist + j, _mm256_mul_pd(_mm256_set1_pd(NM_PER_HALF_RADIAN), poly_asin_pos_avx2(a)));
+    }
+    distance_row_scalar(x1, y1, z1, x2 + j, y2 + j, z2 + j, dist + j, m - j);
+}
+
+
+/*--------------------------------------------------------------------------
+  AVX-512 kernels, 8 lanes. Mirrors the scalar kernels operation by operation.
+--------------------------------------------------------------------------*/
+#define AVX512_POLY(acc, x, coef, i) acc = _mm512_add_pd(_mm512_mul_pd(acc, x), _mm512_set1_pd(coef[i]))
+
+__attribute__((target("avx512f")))
+static __m512d poly_sind_avx512(__m512d deg, double quadrant)
+{
+    __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(deg, _mm512_set1_pd(1.0 / 90.0)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_mul_pd(_mm512_sub_pd(deg, _mm512_mul_pd(k, _mm512_set1_pd(90.0))), _mm512_set1_pd(D2R));
+    __m512d q = _mm512_add_pd(k, _mm512_set1_pd(quadrant));
+    __m512d z = _mm512_mul_pd(r, r);
+    __m512d s, c, v;
+    __mmask8 swap, neg;
+
+    q = _mm512_sub_pd(q, _mm512_mul_pd(_mm512_set1_pd(4.0),
+                                       _mm512_roundscale_pd(_mm512_mul_pd(q, _mm512_set1_pd(0.25)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+
+    s = _mm512_set1_pd(poly_sin_coef[0]);
+    AVX512_POLY(s, z, poly_sin_coef, 1);
+    AVX512_POLY(s, z, poly_sin_coef, 2);
+    AVX512_POLY(s, z, poly_sin_coef, 3);
+    AVX512_POLY(s, z, poly_sin_coef, 4);
+    AVX512_POLY(s, z, poly_sin_coef, 5);
+    s = _mm512_add_pd(r, _mm512_mul_pd(_mm512_mul_pd(r, z), s));
+
+    c = _mm512_set1_pd(poly_cos_coef[0]);
+    AVX512_POLY(c, z, poly_cos_coef, 1);
+    AVX512_POLY(c, z, poly_cos_coef, 2);
+    AVX512_POLY(c, z, poly_cos_coef, 3);
+    AVX512_POLY(c, z, poly_cos_coef, 4);
+    AVX512_POLY(c, z, poly_cos_coef, 5);
+    c = _mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(1.0), _mm512_mul_pd(_mm512_set1_pd(0.5), z)),
+                      _mm512_mul_pd(_mm512_mul_pd(z, z), c));
+
+    swap = _mm512_cmp_pd_mask(q, _mm512_set1_pd(1.0), _CMP_EQ_OQ) |
+           _mm512_cmp_pd_mask(q, _mm512_set1_pd(3.0), _CMP_EQ_OQ);
+    neg  = _mm512_cmp_pd_mask(q, _mm512_set1_pd(2.0), _CMP_GE_OQ);
+    v = _mm512_mask_blend_pd(swap, s, c);
+    return _mm512_castsi512_pd(_mm512_mask_xor_epi64(_mm512_castpd_si512(v), neg, _mm512_castpd_si512(v),
+                                                     _mm512_castpd_si512(_mm512_set1_pd(-0.0))));
+}
+
+__attribute__((target("avx512f")))
+static __m512d poly_asin_pos_avx512(__m512d a)
+{
+    __m512d one = _mm512_set1_pd(1.0);
+    __m512d zz, p, q, hi, lo;
+
+    // a > 0.625
+    zz = _mm512_sub_pd(one, a);
+    p = _mm512_set1_pd(poly_asin_r[0]);
+    AVX512_POLY(p, zz, poly_asin_r, 1);
+    AVX512_POLY(p, zz, poly_asin_r, 2);
+    AVX512_POLY(p, zz, poly_asin_r, 3);
+    AVX512_POLY(p, zz, poly_asin_r, 4);
+    q = _mm512_add_pd(zz, _mm512_set1_pd(poly_asin_s[0]));
+    AVX512_POLY(q, zz, poly_asin_s, 1);
+    AVX512_POLY(q, zz, poly_asin_s, 2);
+    AVX512_POLY(q, zz, poly_asin_s, 3);
+    p = _mm512_div_pd(_mm512_mul_pd(zz, p), q);
+    zz = _mm512_sqrt_pd(_mm512_add_pd(zz, zz));
+    hi = _mm512_sub_pd(_mm512_set1_pd(POLY_PIO4), zz);
+    zz = _mm512_sub_pd(_mm512_mul_pd(zz, p), _mm512_set1_pd(POLY_MOREBITS));
+    hi = _mm512_sub_pd(hi, zz);
+    hi = _mm512_add_pd(hi, _mm512_set1_pd(POLY_PIO4));
+
+    // a <= 0.625
+    zz = _mm512_mul_pd(a, a);
+    p = _mm512_set1_pd(poly_asin_p[0]);
+    AVX512_POLY(p, zz, poly_asin_p, 1);
+    AVX512_POLY(p, zz, poly_asin_p, 2);
+    AVX512_POLY(p, zz, poly_asin_p, 3);
+    AVX512_POLY(p, zz, poly_asin_p, 4);
+    AVX512_POLY(p, zz, poly_asin_p, 5);
+    q = _mm512_add_pd(zz, _mm512_set1_pd(poly_asin_q[0]));
+    AVX512_POLY(q, zz, poly_asin_q, 1);
+    AVX512_POLY(q, zz, poly_asin_q, 2);
+    AVX512_POLY(q, zz, poly_asin_q, 3);
+    AVX512_POLY(q, zz, poly_asin_q, 4);
+    lo = _mm512_div_pd(_mm512_mul_pd(zz, p), q);
+    lo = _mm512_add_pd(_mm512_mul_pd(a, lo), a);
+
+    return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, _mm512_set1_pd(0.625), _CMP_GT_OQ), lo, hi);
+}
+
+__attribute__((target("avx512f")))
+static void distance_batch_avx512(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n)
+{
+    const __m512d half = _mm512_set1_pd(0.5);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512d la1 = _mm512_loadu_pd(lat1 + i);
+        __m512d lo1 = _mm512_loadu_pd(lon1 + i);
+        __m512d la2 = _mm512_loadu_pd(lat2 + i);
+        __m512d lo2 = _mm512_loadu_pd(lon2 + i);
+        __m512d s1 = poly_sind_avx512(_mm512_mul_pd(_mm512_sub_pd(la1, la2), half), 0.0);
+        __m512d s2 = poly_sind_avx512(_mm512_mul_pd(_mm512_sub_pd(lo2, lo1), half), 0.0);
+        __m512d c1 = poly_sind_avx512(la1, 1.0);
+        __m512d c2 = poly_sind_avx512(la2, 1.0);
+        __m512d h  = _mm512_add_pd(_mm512_mul_pd(s1, s1),
+                                   _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(s2, s2), c1), c2));
+
+        h = _mm512_min_pd(h, _mm512_set1_pd(1.0));
+        h = poly_asin_pos_avx512(_mm512_sqrt_pd(h));
+        _mm512_storeu_pd(dist + i, _mm512_mul_pd(_mm512_set1_pd(NM_PER_HALF_RADIAN), h));
+    }
+    distance_batch_scalar(lat1 + i, lon1 + i, lat2 + i, lon2 + i, dist + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void distance_row_avx512(double x1, double y1, double z1, const double *x2, const double *y2, const double *z2, double *dist, int m)
+{
+    const __m512d vx1 = _mm512_set1_pd(x1), vy1 = _mm512_set1_pd(y1), vz1 = _mm512_set1_pd(z1);
+    int j = 0;
+
+    for (; j + 8 <= m; j += 8) {
+        __m512d dx = _mm512_sub_pd(vx1, _mm512_loadu_pd(x2 + j));
+        __m512d dy = _mm512_sub_pd(vy1, _mm512_loadu_pd(y2 + j));
+        __m512d dz = _mm512_sub_pd(vz1, _mm512_loadu_pd(z2 + j));
+        __m512d a  = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), _mm512_mul_pd(dz, dz));
+
+        a = _mm512_min_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), _mm512_sqrt_pd(a)), _mm512_set1_pd(1.0));
+        _mm512_storeu_pd(dist + j, _mm512_mul_pd(_mm512_set1_pd(NM_PER_HALF_RADIAN), poly_asin_pos_avx512(a)));
+    }
+    distance_row_scalar(x1, y1, z1, x2 + j, y2 + j, z2 + j, dist + j, m - j);
+}
+#endif /* AVCALC_X86_SIMD */
+
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC pop_options
+#endif
+
+
+/*--------------------------------------------------------------------------
+  Section with polynomial math kernels
+
+  Replacements for sin, cos, asin, atan2, exp, log, pow and fmod written
+  without branches or library calls, so that loops over arrays can be
+  vectorized by the compiler. Each function comes in three accuracy tiers:
+
+      AVCALC_ACCURACY_FULL     Full double precision
+      AVCALC_ACCURACY_NAV      About 1e-9 rad, about 6 mm on the earth
+      AVCALC_ACCURACY_DISPLAY  About 1e-6 rad, about 6 m on the earth
+
+  Maximum error against the C library over the ranges given, as checked
+  by test_MathBatch (absolute error in radians, or relative error):
+
+      Function  Range                     FULL      NAV       DISPLAY
+      sin, cos  |x| <= 100                3e-16     1e-10     1e-6
+      asin      |x| <= 1                  5e-16     2e-10     6e-8
+      atan2     any y, x                  5e-16     2e-10     2e-7
+      exp       |x| <= 708, relative      3e-16     6e-11     2e-7
+      log       normal x > 0, relative    1e-15     1e-11     2e-7
+      pow       0.1 <= x <= 2, |y| <= 6,  3e-15     1e-10     4e-7
+                relative
+      fmod      |x| <= 20, y = 2*pi       0         0         0
+
+  pow(x, y) is exp(y*log(x)) and fmod(x, y) is x - trunc(x/y)*y, whose
+  error grows with the size of x/y. Arguments outside these ranges,
+  infinities and subnormal numbers are not handled. The speed of each
+  tier against the C library is reported by AvCalc_bench.c.
+--------------------------------------------------------------------------*/
+
+// Tier used when AVCALC_ACCURACY_GLOBAL is given, see AccuracySelect()
+static int accuracy_global = AVCALC_ACCURACY_FULL;
+
+// Polynomial coefficients, highest power first. The FULL tier of sin and
+// cos use the Cephes coefficients of the batch section. The others are
+// minimax fits over the reduced range of each kernel.
+static const double math_sin_nav[4] = {
+     2.71601386957755291783e-6,
+    -1.98390437509145526051e-4,
+     8.33332823863353556861e-3,
+    -1.66666666279980013014e-1
+};
+static const double math_sin_display[2] = {
+     8.15299129353381801386e-3,
+    -1.66628337490783762992e-1
+};
+static const double math_cos_nav[3] = {
+     2.44384496816742354546e-5,
+    -1.38873674967071565489e-3,
+     4.16666468659858473192e-2
+};
+static const double math_cos_display[2] = {
+    -1.36524487839362088732e-3,
+     4.16612785455526271922e-2
+};
+
+// asin(x) = x + x^3*A(x^2) for 0 <= x <= 0.5
+static const double math_asin_full[11] = {
+     3.32028497848309043775e-2,
+    -1.40932400385818787757e-2,
+     1.97260552635719699115e-2,
+     8.86560276993142489878e-3,
+     1.44350819718075061611e-2,
+     1.72981522294646127339e-2,
+     2.23763402765184527448e-2,
+     3.03817401717579338519e-2,
+     4.46428630915915570487e-2,
+     7.49999999097902185468e-2,
+     1.66666666667180981601e-1
+};
+static const double math_asin_nav[6] = {
+     3.90885219134017325327e-2,
+     1.32107800585797690096e-2,
+     3.21702367860876664105e-2,
+     4.44671792003028269148e-2,
+     7.50081440182757694635e-2,
+     1.66666532454708595442e-1
+};
+static const double math_asin_display[4] = {
+     5.15870254183028277013e-2,
+     3.91933621316474213148e-2,
+     7.55403196561070496978e-2,
+     1.66649261817959454521e-1
+};
+
+// atan(t) = t + t^3*T(t^2) for 0 <= t <= tan(pi/8)
+static const double math_atan_full[10] = {
+     2.06599717109031557549e-2,
+    -4.30593567858005818577e-2,
+     5.67242283229779969291e-2,
+    -6.63688228358160036824e-2,
+     7.68952461537518555225e-2,
+    -9.09073886347022428955e-2,
+     1.11111045062263424471e-1,
+    -1.42857141336574210924e-1,
+     1.99999999981831644523e-1,
+    -3.33333333333251892558e-1
+};
+static const double math_atan_nav[5] = {
+    -5.94835233373990386321e-2,
+     1.05361154043474520328e-1,
+    -1.42345084323958078991e-1,
+     1.99978953753111534172e-1,
+    -3.33333029810176635978e-1
+};
+static const double math_atan_display[3] = {
+    -1.1053672503935156589e-1,
+     1.96702373577539226079e-1,
+    -3.33228925750797237587e-1
+};
+
+// log(m) = 2s + s^3*L(s^2), s = (m-1)/(m+1), sqrt(1/2) <= m < sqrt(2)
+static const double math_log_full[6] = {
+     1.68965829286798265868e-1,
+     1.81165981341701150858e-1,
+     2.22236159737628923778e-1,
+     2.85714131921667694661e-1,
+     4.00000000810616096057e-1,
+     6.6666666666513845628e-1
+};
+static const double math_log_nav[4] = {
+     2.36687925549035903608e-1,
+     2.85320666278231036205e-1,
+     4.00004338777242519185e-1,
+     6.66666650852529307091e-1
+};
+static const double math_log_display[2] = {
+     4.12874792303728416007e-1,
+     6.66534274475550129194e-1
+};
+
+// exp(r) = 1 + r + r^2*E(r) for |r| <= ln(2)/2
+static const double math_exp_full[10] = {
+     2.50000742363097938113e-8,
+     2.76302344676457828249e-7,
+     2.75575862629115945084e-6,
+     2.48014931345522698329e-5,
+     1.98412695067794018609e-4,
+     1.38888889435993787175e-3,
+     8.33333333349433599212e-3,
+     4.1666666666530259178e-2,
+     1.6666666666666412764e-1,
+     5.00000000000001061759e-1
+};
+static const double math_exp_nav[6] = {
+     1.97903571383627190127e-4,
+     1.3944649272940725518e-3,
+     8.33349700309045261222e-3,
+     4.16662950824599396077e-2,
+     1.66666658694164892582e-1,
+     5.00000006764648742082e-1
+};
+static const double math_exp_display[4] = {
+     8.31252696909070033018e-3,
+     4.18901162526049793043e-2,
+     1.66671144520420518738e-1,
+     4.99992317620524959369e-1
+};
+
+// pi/2 in three parts for exact argument reduction (fdlibm)
+#define MATH_PIO2_1 1.57079632673412561417e+00
+#define MATH_PIO2_2 6.07710050630396597660e-11
+#define MATH_PIO2_3 2.02226624871116645580e-21
+// ln(2) in two parts (fdlibm)
+#define MATH_LN2_HI 6.93147180369123816490e-01
+#define MATH_LN2_LO 1.90821492927058770002e-10
+#define MATH_TAN_PIO8 0.41421356237309504880
+#define MATH_SQRT2    1.41421356237309504880
+#define MATH_2P52     4503599627370496.0       // 2^52
+#define MATH_ROUNDER  6755399441055744.0       // 1.5 * 2^52, adding it rounds to an integer
+
+#define ARRAY_LEN(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+/* The tier argument of the kernels below is expected to be a constant, or
+   at least the same for every element of a loop, so that the compiler can
+   move the tier switch out of the loop and unroll the polynomials. Both
+   sides of every selection are computed, and ?: only picks between the
+   results, so that the loops contain no branches. */
+static inline double poly_eval(double z, const double *c, int n)
+{
+    double p = c[0];
+
+    for (int k = 1; k < n; k++) {
+        p = p * z + c[k];
     }
+    return p;
+}
+
+#define TIER_POLY(z, tier, full, nav, display)                            \
+    ((tier) == AVCALC_ACCURACY_FULL ? poly_eval(z, full, ARRAY_LEN(full)) : \
+     (tier) == AVCALC_ACCURACY_NAV  ? poly_eval(z, nav,  ARRAY_LEN(nav))  : \
+                                      poly_eval(z, display, ARRAY_LEN(display)))
+
+static inline double math_asdouble(uint64_t bits)
+{
+    double x;
+    memcpy(&x, &bits, sizeof x);
+    return x;
+}
+
+static inline uint64_t math_asuint(double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    return bits;
+}
+
+// sin(x + quadrant*pi/2) for x in radians, quadrant 0 or 1
+static inline double math_sin_quadrant(double x, double quadrant, int tier)
+{
+    double k = rint(x * (2.0 / M_PI));
+    double r = ((x - k * MATH_PIO2_1) - k * MATH_PIO2_2) - k * MATH_PIO2_3;
+    double q = k + quadrant;
+    double z = r * r;
+    double s, c, v, h;
+
+    q = q - 4.0 * floor(q * 0.25);    // quadrant 0..3
+    h = q * 0.5;
+    s = r + r * z * TIER_POLY(z, tier, poly_sin_coef, math_sin_nav, math_sin_display);
+    c = 1.0 - 0.5 * z + z * z * TIER_POLY(z, tier, poly_cos_coef, math_cos_nav, math_cos_display);
+    v = (h != floor(h)) ? c : s;      // odd quadrant
+    return (q >= 2.0) ? -v : v;
+}
+
+static inline double math_sin(double x, int tier)
+{
+    return math_sin_quadrant(x, 0.0, tier);
+}
+
+static inline double math_cos(double x, int tier)
+{
+    return math_sin_quadrant(x, 1.0, tier);
+}
+
+// sin(x) and cos(x) from a single reduction
+AVCALC_INLINE void math_sincos(double x, double *sinx, double *cosx, int tier)
+{
+    double k = rint(x * (2.0 / M_PI));
+    double r = ((x - k * MATH_PIO2_1) - k * MATH_PIO2_2) - k * MATH_PIO2_3;
+    double q = k - 4.0 * floor(k * 0.25);    // quadrant 0..3
+    double z = r * r;
+    double s = r + r * z * TIER_POLY(z, tier, poly_sin_coef, math_sin_nav, math_sin_display);
+    double c = 1.0 - 0.5 * z + z * z * TIER_POLY(z, tier, poly_cos_coef, math_cos_nav, math_cos_display);
+    double odd = (q == 1.0 || q == 3.0) ? 1.0 : 0.0;
+    double sv = (odd != 0.0) ? c : s;
+    double cv = (odd != 0.0) ? s : c;
+
+    *sinx = (q >= 2.0) ? -sv : sv;
+    *cosx = (q == 1.0 || q == 2.0) ? -cv : cv;
+}
+
+// asin(x) for |x| <= 1, using asin(a) = pi/2 - 2*asin(sqrt((1-a)/2)) above 0.5
+static inline double math_asin(double x, int tier)
+{
+    double a = fabs(x);
+    double w = sqrt((1.0 - a) * 0.5);
+    double t = (a > 0.5) ? w : a;
+    double z = t * t;
+    double p = t + t * z * TIER_POLY(z, tier, math_asin_full, math_asin_nav, math_asin_display);
+    double q = M_PI_2 - 2.0 * p;
+
+    return copysign((a > 0.5) ? q : p, x);
+}
+
+// atan2(y, x), reduced to atan(t) for 0 <= t <= tan(pi/8)
+static inline double math_atan2(double y, double x, int tier)
+{
+    double ax  = fabs(x);
+    double ay  = fabs(y);
+    double num = (ay > ax) ? ax : ay;
+    double den = (ay > ax) ? ay : ax;
+    double t   = num / ((den > 0.0) ? den : 1.0);                 // 0 <= t <= 1
+    double u   = (t - 1.0) / (t + 1.0);                           // atan(t) = pi/4 + atan(u)
+    double v   = (t > MATH_TAN_PIO8) ? u : t;
+    double z   = v * v;
+    double a   = v + v * z * TIER_POLY(z, tier, math_atan_full, math_atan_nav, math_atan_display);
+
+    a = (t > MATH_TAN_PIO8) ? M_PI_4 + a : a;
+    a = (ay > ax) ? M_PI_2 - a : a;
+    a = (x < 0.0) ? M_PI - a : a;
+    return copysign(a, y);
+}
+
+// exp(x) for |x| <= 708
+static inline double math_exp(double x, int tier)
+{
+    double k, r, p;
+    uint64_t scale;
+
+    x = (x < -708.0) ? -708.0 : x;
+    x = (x >  709.0) ?  709.0 : x;
+    k = rint(x * M_LOG2E);
+    r = (x - k * MATH_LN2_HI) - k * MATH_LN2_LO;
+    p = 1.0 + r + r * r * TIER_POLY(r, tier, math_exp_full, math_exp_nav, math_exp_display);
+
+    // 2^k, built from the integer k held in the low bits of k + 1.5*2^52
+    scale = (math_asuint(k + MATH_ROUNDER) + 1023) << 52;
+    return p * math_asdouble(scale);
+}
+
+// log(x) for positive normal x, -inf for 0 and NaN for negative x
+static inline double math_log(double x, int tier)
+{
+    uint64_t bits = math_asuint(x);
+    double   m    = math_asdouble((bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL);   // 1 <= m < 2
+    double   e    = math_asdouble((bits >> 52) | 0x4330000000000000ULL) - (MATH_2P52 + 1023.0);
+    double   h    = m * 0.5;
+    double   s, z, r;
+
+    e = (m > MATH_SQRT2) ? e + 1.0 : e;
+    m = (m > MATH_SQRT2) ? h : m;
+    s = (m - 1.0) / (m + 1.0);
+    z = s * s;
+    r = 2.0 * s + s * z * TIER_POLY(z, tier, math_log_full, math_log_nav, math_log_display);
+    r = e * MATH_LN2_HI + (e * MATH_LN2_LO + r);
+    r = (x == 0.0) ? -INFINITY : r;
+    return (x < 0.0) ? NAN : r;
+}
+
+// x^y for x >= 0
+static inline double math_pow(double x, double y, int tier)
+{
+    double r    = math_exp(y * math_log(x, tier), tier);
+    double zero = (y > 0.0) ? 0.0 : INFINITY;
+
+    r = (x == 0.0) ? zero : r;
+    return (x < 0.0) ? NAN : r;
+}
+
+// Remainder of x/y with the sign of x, as fmod()
+static inline double math_fmod(double x, double y)
+{
+    return x - trunc(x / y) * y;
 }
 
+static inline int math_tier(int accuracy)
+{
+    return (accuracy == AVCALC_ACCURACY_GLOBAL) ? accuracy_global : accuracy;
+}
+
+// One loop per function, so each loop body is a single straight line kernel
+#define MATH_BATCH_LOOPS(function, x, y, result, n, tier)                                                     \
+    switch (function) {                                                                                      \
+    case AVCALC_MATH_SIN:   for (int i = 0; i < n; i++) result[i] = math_sin(x[i], tier);         break;    \
+    case AVCALC_MATH_COS:   for (int i = 0; i < n; i++) result[i] = math_cos(x[i], tier);         break;    \
+    case AVCALC_MATH_ASIN:  for (int i = 0; i < n; i++) result[i] = math_asin(x[i], tier);        break;    \
+    case AVCALC_MATH_ATAN2: for (int i = 0; i < n; i++) result[i] = math_atan2(x[i], y[i], tier); break;    \
+    case AVCALC_MATH_EXP:   for (int i = 0; i < n; i++) result[i] = math_exp(x[i], tier);         break;    \
+    case AVCALC_MATH_LOG:   for (int i = 0; i < n; i++) result[i] = math_log(x[i], tier);         break;    \
+    case AVCALC_MATH_POW:   for (int i = 0; i < n; i++) result[i] = math_pow(x[i], y[i], tier);   break;    \
+    case AVCALC_MATH_FMOD:  for (int i = 0; i < n; i++) result[i] = math_fmod(x[i], y[i]);        break;    \
+    }
+
+// The tier switch sits outside the loops, giving one loop per function and
+// tier, each with its polynomial degrees known at compile time
+#define TIER_SWITCH(tier, statement)                                            \
+    switch (tier) {                                                             \
+    case AVCALC_ACCURACY_FULL: { enum { TIER = AVCALC_ACCURACY_FULL }; statement } break;  \
+    case AVCALC_ACCURACY_NAV:  { enum { TIER = AVCALC_ACCURACY_NAV };  statement } break;  \
+    default:                   { enum { TIER = AVCALC_ACCURACY_DISPLAY }; statement } break; \
+    }
+
+/* Batch loops written in plain C are compiled once per kernel. name##_body
+   holds the loops, BATCH_KERNEL stamps out a scalar, an AVX2 and an
+   AVX-512 copy of it, and BATCH_RUN calls the copy for the active kernel.
+   Unlike the distance kernels the wider copies may use fused multiply-add,
+   so their results can differ from the scalar copy in the last bit. */
+#if AVCALC_X86_SIMD
+    #define BATCH_KERNEL(name, params, args)                                   \
+        static void name##_scalar params { name##_body args; }                 \
+        __attribute__((target("avx2,fma")))                                    \
+        static void name##_avx2 params { name##_body args; }                   \
+        __attribute__((target("avx512f")))                                     \
+        static void name##_avx512 params { name##_body args; }
+
+    #define BATCH_RUN(name, args)                                              \
+        switch (active_kernel) {                                               \
+        case AVCALC_KERNEL_AVX512: name##_avx512 args; break;                  \
+        case AVCALC_KERNEL_AVX2:   name##_avx2 args;   break;                  \
+        default:                   name##_scalar args; break;                  \
+        }
+#else
+    #define BATCH_KERNEL(name, params, args)                                   \
+        static void name##_scalar params { name##_body args; }
+
+    #define BATCH_RUN(name, args) name##_scalar args
+#endif
+
+AVCALC_INLINE void math_batch_body(int function, const double *x, const double *y, double *result, int n, int tier)
+{
+    TIER_SWITCH(tier, MATH_BATCH_LOOPS(function, x, y, result, n, TIER))
+}
+
+BATCH_KERNEL(math_batch, (int function, const double *x, const double *y, double *result, int n, int tier),
+                         (function, x, y, result, n, tier))
+
+
+/*--------------------------------------------------------------------------
+  Select the accuracy tier used by default
+
+  The batch functions that use the polynomial kernels, and MathBatch()
+  called with AVCALC_ACCURACY_GLOBAL, use this tier. The default is
+  AVCALC_ACCURACY_FULL.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - One of AVCALC_ACCURACY_FULL, _NAV or _DISPLAY
+
+  RETURN: The tier now active, or -1 if the tier is not valid
+--------------------------------------------------------------------------*/
+int AVCALCCALL AccuracySelect(int accuracy)
+{
+    if (accuracy < AVCALC_ACCURACY_FULL || accuracy > AVCALC_ACCURACY_DISPLAY) {
+        return -1;
+    }
+    accuracy_global = accuracy;
+    return accuracy;
+}
+
+/*--------------------------------------------------------------------------
+  RETURN: The accuracy tier currently used by default
+--------------------------------------------------------------------------*/
+int AVCALCCALL AccuracyActive(void)
+{
+    return accuracy_global;
+}
+
+
+/*--------------------------------------------------------------------------
+  Kernel dispatch
+--------------------------------------------------------------------------*/
+typedef struct {
+    void (*distance)(const double*, const double*, const double*, const double*, double*, int);
+    void (*distance_row)(double, double, double, const double*, const double*, const double*, double*, int);
+} batch_kernels;
+
+static const batch_kernels kernels_scalar = {distance_batch_scalar, distance_row_scalar};
+#if AVCALC_X86_SIMD
+static const batch_kernels kernels_avx2   = {distance_batch_avx2,   distance_row_avx2};
+static const batch_kernels kernels_avx512 = {distance_batch_avx512, distance_row_avx512};
+#endif
+
+// The scalar kernels are always valid; the load time selection upgrades them
+static const batch_kernels *kernels = &kernels_scalar;
+static int active_kernel = AVCALC_KERNEL_SCALAR;
+
+static int kernel_supported(int kernel)
+{
+    switch (kernel) {
+    case AVCALC_KERNEL_SCALAR:
+        return 1;
+#if AVCALC_X86_SIMD
+    case AVCALC_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case AVCALC_KERNEL_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return 0;
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Select the kernel used by the batch functions
+
+  AVCALC_KERNEL_AUTO picks the widest kernel the CPU supports. This is done
+  automatically when the library is loaded; call this function only to
+  force a specific kernel, e.g. for testing or benchmarking.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - One of the AVCALC_KERNEL_ constants
+
+  RETURN: The kernel now active, or -1 if the CPU does not support the
+          requested kernel (the active kernel is then left unchanged)
+--------------------------------------------------------------------------*/
+int AVCALCCALL BatchKernelSelect(int kernel)
+{
+    if (kernel == AVCALC_KERNEL_AUTO) {
+        kernel = kernel_supported(AVCALC_KERNEL_AVX512) ? AVCALC_KERNEL_AVX512 :
+                 kernel_supported(AVCALC_KERNEL_AVX2)   ? AVCALC_KERNEL_AVX2   :
+                                                          AVCALC_KERNEL_SCALAR;
+    } else if (!kernel_supported(kernel)) {
+        return -1;
+    }
+
+    switch (kernel) {
+#if AVCALC_X86_SIMD
+    case AVCALC_KERNEL_AVX512: kernels = &kernels_avx512; break;
+    case AVCALC_KERNEL_AVX2:   kernels = &kernels_avx2;   break;
+#endif
+    default:                   kernels = &kernels_scalar; break;
+    }
+    active_kernel = kernel;
+    return kernel;
+}
+
+/*--------------------------------------------------------------------------
+  RETURN: The kernel currently used by the batch functions
+--------------------------------------------------------------------------*/
+int AVCALCCALL BatchKernelActive(void)
+{
+    return active_kernel;
+}
+
+#if defined(__GNUC__)
+__attribute__((constructor))
+static void batch_kernel_load(void)
+{
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+#endif
+
+
+/*--------------------------------------------------------------------------
+  Distance between many pairs of points
+
+  Same great circle distance as Distance(), for n pairs of points given as
+  separate arrays. Element i of the output is the distance from
+  {lat1[i],lon1[i]} to {lat2[i],lon2[i]}.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 4: INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 5: OUTPUT - Array of n distances in nautical miles
+  Argument 6: INPUT  - Number of pairs
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL DistanceBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n)
+{
+    if (n > 0) {
+        kernels->distance(lat1, lon1, lat2, lon2, dist, n);
+    }
+}
+
+
+
+
+AVCALC_INLINE void inverse_pair(double lat1, double lon1, double lat2, double lon2,
+                                double *dist, double *course_initial, double *course_final, int tier)
+{
+    double sinLat1, cosLat1, sinLat2, cosLat2, sinDLon, cosDLon, north, east, initial, final;
+
+    math_sincos(D2R * lat1, &sinLat1, &cosLat1, tier);
+    math_sincos(D2R * lat2, &sinLat2, &cosLat2, tier);
+    math_sincos(D2R * (lon2 - lon1), &sinDLon, &cosDLon, tier);
+
+    north = cosLat1 * sinLat2 - sinLat1 * cosLat2 * cosDLon;
+    east  = sinDLon * cosLat2;
+    *dist = 60 * R2D * math_atan2(sqrt(east * east + north * north),
+                                  sinLat1 * sinLat2 + cosLat1 * cosLat2 * cosDLon, tier);
+
+    initial = R2D * math_atan2(east, north, tier);
+    initial = (cosLat1 < EPS && lat1 > 0) ? R2D * M_PI   : initial;
+    initial = (cosLat1 < EPS && lat1 < 0) ? R2D * 2*M_PI : initial;
+    *course_initial = initial;
+
+    final = R2D * math_atan2(sinDLon * cosLat1, sinLat2 * cosLat1 * cosDLon - cosLat2 * sinLat1, tier);
+    final = (cosLat2 < EPS && lat2 > 0) ? R2D * 2*M_PI : final;
+    final = (cosLat2 < EPS && lat2 < 0) ? R2D * M_PI   : final;
+    *course_final = final;
+}
+
+AVCALC_INLINE void inverse_batch_body(const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                                      double *restrict dist, double *restrict course_initial, double *restrict course_final, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) inverse_pair(lat1[i], lon1[i], lat2[i], lon2[i], &dist[i], &course_initial[i], &course_final[i], TIER);)
+}
+
+BATCH_KERNEL(inverse_batch, (const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                             double *restrict dist, double *restrict course_initial, double *restrict course_final, int n, int tier),
+                            (lat1, lon1, lat2, lon2, dist, course_initial, course_final, n, tier))
+
+/*--------------------------------------------------------------------------
+  Distance and courses between points
+
+  Solves the inverse problem in one call: distance, initial course at
+  point 1 and final course at point 2, all from the sine and cosine of
+  lat1, lat2 and lon2-lon1. The distance is taken as
+
+    d = atan2(sqrt((cos(lat2)*sin(dlon))^2 + (cos(lat1)*sin(lat2)-sin(lat1)*cos(lat2)*cos(dlon))^2),
+              sin(lat1)*sin(lat2)+cos(lat1)*cos(lat2)*cos(dlon))
+
+  whose first argument is reused by the initial course. The final course
+  is the initial course from point 2 to point 1, turned 180 degrees.
+  Courses are in the range of CourseInitial(), with the same answers when
+  starting from a pole; arriving at a pole gives north or south likewise.
+  The trigonometry runs in the polynomial kernels at full accuracy, which
+  are faster than the C library and give the same results as InverseBatch().
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: OUTPUT - Pointer to double receiving distance in nautical miles
+  Argument 6: OUTPUT - Pointer to double receiving initial course in degrees
+  Argument 7: OUTPUT - Pointer to double receiving final course in degrees
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL Inverse(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course_initial, double *course_final)
+{
+    inverse_pair(*lat1, *lon1, *lat2, *lon2, dist, course_initial, course_final, AVCALC_ACCURACY_FULL);
+}
+
+/*--------------------------------------------------------------------------
+  Distance and courses between many pairs of points
+
+  Same results as Inverse(), for n pairs of points given as separate
+  arrays, at the accuracy tier set by AccuracySelect(). The output arrays
+  must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 4: INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 5: OUTPUT - Array of n distances in nautical miles
+  Argument 6: OUTPUT - Array of n initial courses in degrees
+  Argument 7: OUTPUT - Array of n final courses in degrees
+  Argument 8: INPUT  - Number of pairs
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL InverseBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course_initial, double *course_final, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(inverse_batch, (lat1, lon1, lat2, lon2, dist, course_initial, course_final, n, accuracy_global))
+    }
+}
+
+
+
+
+/* Point at distance d (radians) on course tc from a start point given by
+   the sine and cosine of its latitude. The end point is found as a unit
+   vector in a frame turned so that the start point has longitude 0,
+   giving the general form of the formula, valid for any distance:
+
+     lat  = atan2(z, sqrt(x^2+y^2))
+     dlon = atan2(y, x)
+       x = cos(lat1)*cos(d) - sin(lat1)*sin(d)*cos(tc)
+       y = sin(d)*sin(tc)
+       z = sin(lat1)*cos(d) + cos(lat1)*sin(d)*cos(tc)
+
+   The longitude is returned in the range [-180, 180). */
+AVCALC_INLINE void direct_point(double sinLat1, double cosLat1, double lon1, double course, double dist,
+                                double *lat, double *lon, int tier)
+{
+    double sinCrs, cosCrs, sinD, cosD, x, y, z, l;
+
+    math_sincos(D2R * course, &sinCrs, &cosCrs, tier);
+    math_sincos(D2R * dist / 60, &sinD, &cosD, tier);
+
+    x = cosLat1 * cosD - sinLat1 * sinD * cosCrs;
+    y = sinD * sinCrs;
+    z = sinLat1 * cosD + cosLat1 * sinD * cosCrs;
+
+    *lat = R2D * math_atan2(z, sqrt(x * x + y * y), tier);
+    l = lon1 + R2D * math_atan2(y, x, tier) + 180.0;
+    *lon = l - 360.0 * floor(l * (1.0 / 360.0)) - 180.0;
+}
+
+AVCALC_INLINE void direct_batch_body(const double *lat1, const double *lon1, const double *course, const double *dist,
+                                     double *restrict lat, double *restrict lon, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double s;
+                          double c;
+                          math_sincos(D2R * lat1[i], &s, &c, TIER);
+                          direct_point(s, c, lon1[i], course[i], dist[i], &lat[i], &lon[i], TIER);
+                      })
+}
+
+// All points from the same start point, whose trigonometry is done once
+AVCALC_INLINE void direct_from_body(double sinLat1, double cosLat1, double lon1, const double *course, const double *dist,
+                                    double *restrict lat, double *restrict lon, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) direct_point(sinLat1, cosLat1, lon1, course[i], dist[i], &lat[i], &lon[i], TIER);)
+}
+
+BATCH_KERNEL(direct_batch, (const double *lat1, const double *lon1, const double *course, const double *dist,
+                            double *restrict lat, double *restrict lon, int n, int tier),
+                           (lat1, lon1, course, dist, lat, lon, n, tier))
+BATCH_KERNEL(direct_from, (double sinLat1, double cosLat1, double lon1, const double *course, const double *dist,
+                           double *restrict lat, double *restrict lon, int n, int tier),
+                          (sinLat1, cosLat1, lon1, course, dist, lat, lon, n, tier))
+
+/*--------------------------------------------------------------------------
+  Lat/lon given radial and distance
+
+  The point a distance d out on the radial tc from point 1. Uses the
+  general form of the formula, which holds for any distance, also beyond
+  a quarter of the circumference of the earth. From a pole the course is
+  taken relative to the meridian lon1, so course 180 from the North pole
+  follows that meridian south.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing true course in degrees
+  Argument 4: INPUT  - Pointer to double containing distance in nautical miles
+  Argument 5: OUTPUT - Pointer to double receiving Latitude  in degrees
+  Argument 6: OUTPUT - Pointer to double receiving Longitude in degrees,
+                       in the range [-180, 180)
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL Direct(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult)
+{
+    double sinLat1, cosLat1;
+
+    math_sincos(D2R * *lat1, &sinLat1, &cosLat1, AVCALC_ACCURACY_FULL);
+    direct_point(sinLat1, cosLat1, *lon1, *course, *dist, latresult, lonresult, AVCALC_ACCURACY_FULL);
+}
+
+/*--------------------------------------------------------------------------
+  Lat/lon given radial and distance, for many points
+
+  Same results as Direct(), for n points given as separate arrays, at the
+  accuracy tier set by AccuracySelect(). The output arrays must not
+  overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of the start points in degrees
+  Argument 2: INPUT  - Array of n longitudes of the start points in degrees
+  Argument 3: INPUT  - Array of n true courses in degrees
+  Argument 4: INPUT  - Array of n distances in nautical miles
+  Argument 5: OUTPUT - Array of n latitudes  in degrees
+  Argument 6: OUTPUT - Array of n longitudes in degrees
+  Argument 7: INPUT  - Number of points
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL DirectBatch(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(direct_batch, (lat1, lon1, course, dist, latresult, lonresult, n, accuracy_global))
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Lat/lon given radials and distances from one start point
+
+  As DirectBatch(), with all points out from the same start point, whose
+  trigonometry is then done only once.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of the start point in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of the start point in degrees
+  Argument 3: INPUT  - Array of n true courses in degrees
+  Argument 4: INPUT  - Array of n distances in nautical miles
+  Argument 5: OUTPUT - Array of n latitudes  in degrees
+  Argument 6: OUTPUT - Array of n longitudes in degrees
+  Argument 7: INPUT  - Number of points
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL DirectBatchFrom(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult, int n)
+{
+    double sinLat1, cosLat1;
+
+    if (n > 0) {
+        math_sincos(D2R * *lat1, &sinLat1, &cosLat1, accuracy_global);
+        BATCH_RUN(direct_from, (sinLat1, cosLat1, *lon1, course, dist, latresult, lonresult, n, accuracy_global))
+    }
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Rhumb lines
+
+  A rhumb line is a straight line on the Mercator chart, whose northing
+  is the isometric latitude psi = log(tan(pi/4 + lat/2)) = atanh(sin(lat)).
+  Between two points the line runs dlat north and q*dlon east, with
+
+    q = dlat/dpsi
+
+  the mean cosine of the latitude along it, giving the distance as
+  sqrt(dlat^2 + (q*dlon)^2) and the course as atan2(q*dlon, dlat). On
+  courses near east or west dlat/dpsi is 0/0 in the limit; there q is
+  taken from its series about the middle latitude m,
+
+    q = cos(m)*(1 - (1 + 2*tan(m)^2)*dlat^2/24)
+
+  which is used below RHUMB_EW in dlat/cos(m), where the next term is
+  beyond double precision and the quotient has lost no more than four
+  digits. Both are computed and one selected, so the batch loops have no
+  branch. dpsi is atanh of (sin(lat2)-sin(lat1))/(1-sin(lat1)*sin(lat2))
+  for one logarithm per pair, or the difference of the cached psi of
+  prepared points. dlon is taken in [-180, 180), the shorter way round.
+--------------------------------------------------------------------------*/
+#define RHUMB_EW 1e-4
+
+// Mercator northing from point 1 to point 2, infinite to a pole
+AVCALC_INLINE double rhumb_dpsi(double sinLat1, double sinLat2, int tier)
+{
+    double x = (sinLat2 - sinLat1) / (1.0 - sinLat1 * sinLat2);
+    double dpsi = 0.5 * math_log((1.0 + x) / (1.0 - x), tier);
+
+    return (fabs(x) < 1.0) ? dpsi : x * INFINITY;
+}
+
+// q from dlat and dpsi in radians and the squared cosine of the middle latitude
+AVCALC_INLINE double rhumb_q(double dlat, double dpsi, double cos2m)
+{
+    double t = (cos2m > 0.0) ? dlat * dlat / cos2m : 0.0;
+    double series = sqrt(cos2m) * (1.0 - (2.0 - cos2m) * t / 24.0);
+
+    return (t < RHUMB_EW * RHUMB_EW) ? series : dlat / dpsi;
+}
+
+AVCALC_INLINE void rhumb_leg(double dlat, double dpsi, double cos2m, double dlon,
+                             double *dist, double *course, int tier)
+{
+    double east;
+
+    dlon = dlon + 180.0;
+    dlon = D2R * (dlon - 360.0 * floor(dlon * (1.0 / 360.0)) - 180.0);
+    east = rhumb_q(dlat, dpsi, cos2m) * dlon;
+    *dist   = 60 * R2D * sqrt(dlat * dlat + east * east);
+    *course = R2D * math_atan2(east, dlat, tier);
+}
+
+AVCALC_INLINE void rhumb_pair(double lat1, double lon1, double lat2, double lon2,
+                              double *dist, double *course, int tier)
+{
+    double sinLat1, cosLat1, sinLat2, cosLat2;
+
+    math_sincos(D2R * lat1, &sinLat1, &cosLat1, tier);
+    math_sincos(D2R * lat2, &sinLat2, &cosLat2, tier);
+    rhumb_leg(D2R * (lat2 - lat1), rhumb_dpsi(sinLat1, sinLat2, tier),
+              0.5 * (1.0 + cosLat1 * cosLat2 - sinLat1 * sinLat2), lon2 - lon1, dist, course, tier);
+}
+
+/* Point dist out on the rhumb line of the given course from point 1, NaN
+   if the line reaches a pole before. The longitude is returned in the
+   range [-180, 180). */
+AVCALC_INLINE void rhumb_point(double lat1, double sinLat1, double lon1, double course, double dist,
+                               double *lat, double *lon, int tier)
+{
+    double sinCrs, cosCrs, d, dlat, lat2, cosm, dpsi, l;
+
+    math_sincos(D2R * course, &sinCrs, &cosCrs, tier);
+    d    = D2R * dist / 60;
+    dlat = d * cosCrs;
+    lat2 = D2R * lat1 + dlat;
+    cosm = math_cos(D2R * lat1 + 0.5 * dlat, tier);
+    dpsi = rhumb_dpsi(sinLat1, math_sin(lat2, tier), tier);
+
+    l = lon1 + R2D * d * sinCrs / rhumb_q(dlat, dpsi, cosm * cosm) + 180.0;
+    l = l - 360.0 * floor(l * (1.0 / 360.0)) - 180.0;
+    *lat = (fabs(lat2) > 0.5 * M_PI) ? NAN : R2D * lat2;
+    *lon = (fabs(lat2) > 0.5 * M_PI) ? NAN : l;
+}
+
+AVCALC_INLINE void rhumb_inverse_body(const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                                      double *restrict dist, double *restrict course, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) rhumb_pair(lat1[i], lon1[i], lat2[i], lon2[i], &dist[i], &course[i], TIER);)
+}
+
+AVCALC_INLINE void rhumb_direct_body(const double *lat1, const double *lon1, const double *course, const double *dist,
+                                     double *restrict lat, double *restrict lon, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) rhumb_point(lat1[i], math_sin(D2R * lat1[i], TIER), lon1[i], course[i], dist[i], &lat[i], &lon[i], TIER);)
+}
+
+BATCH_KERNEL(rhumb_inverse, (const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                             double *restrict dist, double *restrict course, int n, int tier),
+                            (lat1, lon1, lat2, lon2, dist, course, n, tier))
+BATCH_KERNEL(rhumb_direct, (const double *lat1, const double *lon1, const double *course, const double *dist,
+                            double *restrict lat, double *restrict lon, int n, int tier),
+                           (lat1, lon1, course, dist, lat, lon, n, tier))
+
+/*--------------------------------------------------------------------------
+  Rhumb line distance and course between points
+
+  The rhumb line, or loxodrome, is the track of constant true course from
+  point 1 to point 2, taken the shorter way round in longitude. To or
+  from a pole it follows the meridian. The trigonometry runs in the
+  polynomial kernels at full accuracy.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: OUTPUT - Pointer to double receiving distance in nautical miles
+  Argument 6: OUTPUT - Pointer to double receiving true course in degrees,
+                       in the range (-180, 180]
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RhumbInverse(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course)
+{
+    rhumb_pair(*lat1, *lon1, *lat2, *lon2, dist, course, AVCALC_ACCURACY_FULL);
+}
+
+/*--------------------------------------------------------------------------
+  Rhumb line distance and course between prepared points
+
+  Same results as RhumbInverse(), to within rounding, from the isometric
+  latitudes cached in the prepared points, which leaves no logarithm and
+  one atan2 per pair.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to prepared point 1
+  Argument 2: INPUT  - Pointer to prepared point 2
+  Argument 3: OUTPUT - Pointer to double receiving distance in nautical miles
+  Argument 4: OUTPUT - Pointer to double receiving true course in degrees
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RhumbInversePrepared(const PreparedPoint *p1, const PreparedPoint *p2, double *dist, double *course)
+{
+    rhumb_leg(D2R * (p2->lat - p1->lat), p2->psi - p1->psi,
+              0.5 * (1.0 + p1->coslat * p2->coslat - p1->sinlat * p2->sinlat), p2->lon - p1->lon,
+              dist, course, AVCALC_ACCURACY_FULL);
+}
+
+/*--------------------------------------------------------------------------
+  Rhumb line distance and course between many pairs of points
+
+  Same results as RhumbInverse(), for n pairs given as separate arrays, at
+  the accuracy tier set by AccuracySelect(). The output arrays must not
+  overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 4: INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 5: OUTPUT - Array of n distances in nautical miles
+  Argument 6: OUTPUT - Array of n true courses in degrees
+  Argument 7: INPUT  - Number of pairs
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RhumbInverseBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(rhumb_inverse, (lat1, lon1, lat2, lon2, dist, course, n, accuracy_global))
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Lat/lon given rhumb line course and distance
+
+  The point a distance d out on the rhumb line of true course tc from
+  point 1, which cannot be a pole. A rhumb line reaches a pole after a
+  finite distance, (90 - |lat1|)/|cos(tc)| degrees of arc, and ends there;
+  further points are NaN.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing true course in degrees
+  Argument 4: INPUT  - Pointer to double containing distance in nautical miles
+  Argument 5: OUTPUT - Pointer to double receiving Latitude  in degrees
+  Argument 6: OUTPUT - Pointer to double receiving Longitude in degrees,
+                       in the range [-180, 180)
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RhumbDirect(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult)
+{
+    rhumb_point(*lat1, math_sin(D2R * *lat1, AVCALC_ACCURACY_FULL), *lon1, *course, *dist, latresult, lonresult, AVCALC_ACCURACY_FULL);
+}
+
+/*--------------------------------------------------------------------------
+  Lat/lon given rhumb line course and distance, for many points
+
+  Same results as RhumbDirect(), for n points given as separate arrays, at
+  the accuracy tier set by AccuracySelect(). The output arrays must not
+  overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n true courses in degrees
+  Argument 4: INPUT  - Array of n distances in nautical miles
+  Argument 5: OUTPUT - Array of n latitudes  in degrees
+  Argument 6: OUTPUT - Array of n longitudes in degrees
+  Argument 7: INPUT  - Number of points
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RhumbDirectBatch(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(rhumb_direct, (lat1, lon1, course, dist, latresult, lonresult, n, accuracy_global))
+    }
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Earth models
+
+  The sphere of 60 nm per degree used by the spherical functions, and the
+  ellipsoids listed in the formulary, by semi-major axis a and flattening
+  f. The semi-minor axis is b = a*(1-f).
+
+  Every constant the geodesic series need is derived from a and f in the
+  initializer, so the whole table is folded at compile time and nothing
+  is derived per call. The series are evaluated as polynomials in
+  cos(alpha)^2 with these coefficients.
+--------------------------------------------------------------------------*/
+typedef struct {
+    double a;               // semi-major axis, nm
+    double f;               // flattening
+    double b;               // semi-minor axis, nm
+    double e2;              // first eccentricity squared, (a^2-b^2)/a^2
+    double ep2;             // second eccentricity squared, (a^2-b^2)/b^2
+    double A[4];            // Vincenty's A - 1 in powers 1 to 4 of cos(alpha)^2
+    double B[4];            // Vincenty's B in powers 1 to 4 of cos(alpha)^2
+    double C[2];            // Vincenty's C in powers 1 and 2 of cos(alpha)^2
+} earth_model;
+
+/* With u^2 = cos(alpha)^2*ep2, the series of Vincenty
+     A = 1 + u^2/16384*(4096 + u^2*(-768 + u^2*(320 - 175*u^2)))
+     B = u^2/1024*(256 + u^2*(-128 + u^2*(74 - 47*u^2)))
+     C = f/16*cos(alpha)^2*(4 + f*(4 - 3*cos(alpha)^2))
+   expanded in powers of cos(alpha)^2 */
+#define EARTH_EP2(f)   ((f) * (2 - (f)) / ((1 - (f)) * (1 - (f))))
+#define EARTH_MODEL(a, f)                                                                           \
+    { (a), (f), (a) * (1 - (f)), (f) * (2 - (f)), EARTH_EP2(f),                                     \
+      { EARTH_EP2(f) / 4, -3 * EARTH_EP2(f) * EARTH_EP2(f) / 64,                                    \
+        5 * EARTH_EP2(f) * EARTH_EP2(f) * EARTH_EP2(f) / 256,                                       \
+        -175 * EARTH_EP2(f) * EARTH_EP2(f) * EARTH_EP2(f) * EARTH_EP2(f) / 16384 },                 \
+      { EARTH_EP2(f) / 4, -EARTH_EP2(f) * EARTH_EP2(f) / 8,                                         \
+        37 * EARTH_EP2(f) * EARTH_EP2(f) * EARTH_EP2(f) / 512,                                      \
+        -47 * EARTH_EP2(f) * EARTH_EP2(f) * EARTH_EP2(f) * EARTH_EP2(f) / 1024 },                   \
+      { (f) * (1 + (f)) / 4, -3 * (f) * (f) / 16 } }
+
+static const earth_model earth_models[] = {
+    EARTH_MODEL(60 * R2D,                 0.0),                 // AVCALC_EARTH_SPHERE
+    EARTH_MODEL(6378137.0 / 1852,         1 / 298.257223563),   // AVCALC_EARTH_WGS84
+    EARTH_MODEL(6378137.0 / 1852,         1 / 298.257222101),   // AVCALC_EARTH_GRS80
+    EARTH_MODEL(6378145.0 / 1852,         1 / 298.25),          // AVCALC_EARTH_WGS66
+    EARTH_MODEL(6378160.0 / 1852,         1 / 298.2472),        // AVCALC_EARTH_GRS67
+    EARTH_MODEL(6378135.0 / 1852,         1 / 298.26),          // AVCALC_EARTH_WGS72
+    EARTH_MODEL(6378245.0 / 1852,         1 / 298.3),           // AVCALC_EARTH_KRASOVSKY
+    EARTH_MODEL(6378206.4 / 1852,         1 / 294.9786982138),  // AVCALC_EARTH_CLARKE66
+};
+
+// The model, or NULL if it is unknown
+static const earth_model *earth_model_get(int model)
+{
+    if (model < 0 || model >= (int)(sizeof(earth_models) / sizeof(earth_models[0]))) {
+        return NULL; //Error condition
+    }
+    return &earth_models[model];
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Geodesics on the ellipsoid
+
+  Vincenty's method. Each point is taken to the auxiliary sphere by its
+  reduced latitude U, tan(U) = (1-f)*tan(lat), where a geodesic is a great
+  circle. The inverse problem iterates on the longitude lambda on that
+  sphere, starting from the longitude difference L:
+
+    sin(sigma) = sqrt((cos(U2)*sin(lambda))^2 + (cos(U1)*sin(U2)-sin(U1)*cos(U2)*cos(lambda))^2)
+    cos(sigma) = sin(U1)*sin(U2) + cos(U1)*cos(U2)*cos(lambda)
+    sin(alpha) = cos(U1)*cos(U2)*sin(lambda)/sin(sigma)
+    cos(2sm)   = cos(sigma) - 2*sin(U1)*sin(U2)/cos(alpha)^2
+    C          = f/16*cos(alpha)^2*(4 + f*(4 - 3*cos(alpha)^2))
+    lambda     = L + (1-C)*f*sin(alpha)*(sigma + C*sin(sigma)*(cos(2sm) + C*cos(sigma)*(-1 + 2*cos(2sm)^2)))
+
+  until lambda changes by less than GEODESIC_TOLERANCE, after which
+
+    u^2 = cos(alpha)^2*(a^2-b^2)/b^2
+    A   = 1 + u^2/16384*(4096 + u^2*(-768 + u^2*(320 - 175*u^2)))
+    B   = u^2/1024*(256 + u^2*(-128 + u^2*(74 - 47*u^2)))
+    ds  = B*sin(sigma)*(cos(2sm) + B/4*(cos(sigma)*(-1 + 2*cos(2sm)^2)
+          - B/6*cos(2sm)*(-3 + 4*sin(sigma)^2)*(-3 + 4*cos(2sm)^2)))
+    s   = b*A*(sigma - ds)
+
+  which is good to a fraction of a millimetre. The direct problem solves
+  s = b*A*(sigma - ds) for sigma by fixed point iteration, where every
+  step gains a factor B ~ f, so five steps always suffice and the batch
+  loop needs no convergence test.
+
+  Near antipodal points the iteration on lambda converges slowly or not
+  at all. A batch runs the iteration for a block of pairs in vector
+  passes, each lane keeping its lambda once converged, until few enough
+  lanes are left to finish one at a time. Pairs still not converged after
+  GEODESIC_ITERATIONS steps, or with |lambda| > pi, are solved instead as
+  in Karney's method: by symmetry the points are arranged with lat1 <= 0,
+  |lat2| <= |lat1| and L >= 0, after which the longitude lambda12 reached
+  at latitude lat2 by the geodesic leaving point 1 on azimuth alpha1
+  grows from 0 to pi as alpha1 goes from 0 to pi, and alpha1 is found by
+  bracketed false position (the Illinois variant). The distance follows
+  from the same series.
+--------------------------------------------------------------------------*/
+#define GEODESIC_ITERATIONS         20
+#define GEODESIC_TOLERANCE          1e-12   // radians of lambda, about 6 micrometres
+#define GEODESIC_BLOCK              256
+
+// Sine and cosine of the reduced latitude
+AVCALC_INLINE void geodesic_reduced(double lat, double f, double *sinU, double *cosU, int tier)
+{
+    double s, c, h;
+
+    math_sincos(D2R * lat, &s, &c, tier);
+    s = (1.0 - f) * s;
+    h = 1.0 / sqrt(s * s + c * c);
+    *sinU = s * h;
+    *cosU = c * h;
+}
+
+// Longitude difference in radians, in [-pi, pi)
+AVCALC_INLINE double geodesic_dlon(double lon1, double lon2)
+{
+    double dlon = lon2 - lon1 + 180.0;
+
+    return D2R * (dlon - 360.0 * floor(dlon * (1.0 / 360.0)) - 180.0);
+}
+
+// Course in degrees in (-180, 180]
+static double geodesic_course(double course)
+{
+    course = remainder(course, 360.0);
+    return (course == -180.0) ? 180.0 : course;
+}
+
+// Vincenty's A and B for the azimuth alpha at the equator
+AVCALC_INLINE void geodesic_series(const earth_model *e, double cos2Alpha, double *A, double *B)
+{
+    *A = 1.0 + cos2Alpha * (e->A[0] + cos2Alpha * (e->A[1] + cos2Alpha * (e->A[2] + cos2Alpha * e->A[3])));
+    *B = cos2Alpha * (e->B[0] + cos2Alpha * (e->B[1] + cos2Alpha * (e->B[2] + cos2Alpha * e->B[3])));
+}
+
+// The length s from sigma, sigma being the angle on the auxiliary sphere
+AVCALC_INLINE double geodesic_length(const earth_model *e, double sigma, double sinSigma, double cosSigma,
+                                     double cos2Alpha, double cos2SigmaM)
+{
+    double A, B, ds;
+
+    geodesic_series(e, cos2Alpha, &A, &B);
+    ds = B * sinSigma * (cos2SigmaM + B / 4.0 * (cosSigma * (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM)
+         - B / 6.0 * cos2SigmaM * (-3.0 + 4.0 * sinSigma * sinSigma) * (-3.0 + 4.0 * cos2SigmaM * cos2SigmaM)));
+
+    return e->b * A * (sigma - ds);
+}
+
+// Longitude on the ellipsoid less that on the auxiliary sphere, over sigma
+AVCALC_INLINE double geodesic_lambda_gap(const earth_model *e, double sinAlpha, double cos2Alpha, double sigma,
+                                         double sinSigma, double cosSigma, double cos2SigmaM)
+{
+    double C = cos2Alpha * (e->C[0] + cos2Alpha * e->C[1]);
+
+    return (1.0 - C) * e->f * sinAlpha * (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM)));
+}
+
+/* One step of the iteration on lambda, returning the next lambda and the
+   angle on the auxiliary sphere it gives */
+AVCALC_INLINE double geodesic_step(const earth_model *e, double sinU1, double cosU1, double sinU2, double cosU2,
+                                   double L, double lambda, double *sigma, double *sinSigma, double *cosSigma,
+                                   double *cos2Alpha, double *cos2SigmaM, int tier)
+{
+    double sinLambda, cosLambda, east, north, sinAlpha;
+
+    math_sincos(lambda, &sinLambda, &cosLambda, tier);
+    east  = cosU2 * sinLambda;
+    north = cosU1 * sinU2 - sinU1 * cosU2 * cosLambda;
+    *sinSigma = sqrt(east * east + north * north);
+    *cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+    *sigma    = math_atan2(*sinSigma, *cosSigma, tier);
+
+    // Coincident points give sin(sigma) = 0, points on the equator cos(alpha) = 0
+    sinAlpha    = (*sinSigma > 0.0) ? cosU1 * cosU2 * sinLambda / *sinSigma : 0.0;
+    *cos2Alpha  = 1.0 - sinAlpha * sinAlpha;
+    *cos2SigmaM = (*cos2Alpha > 0.0) ? *cosSigma - 2.0 * sinU1 * sinU2 / *cos2Alpha : 0.0;
+    return L + geodesic_lambda_gap(e, sinAlpha, *cos2Alpha, *sigma, *sinSigma, *cosSigma, *cos2SigmaM);
+}
+
+AVCALC_INLINE void geodesic_start_body(const earth_model *model, const double *lat1, const double *lon1,
+                                       const double *lat2, const double *lon2,
+                                       double *restrict sinU1, double *restrict cosU1,
+                                       double *restrict sinU2, double *restrict cosU2,
+                                       double *restrict L, double *restrict lambda, double *restrict done, int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          geodesic_reduced(lat1[i], e.f, &sinU1[i], &cosU1[i], TIER);
+                          geodesic_reduced(lat2[i], e.f, &sinU2[i], &cosU2[i], TIER);
+                          L[i]      = geodesic_dlon(lon1[i], lon2[i]);
+                          lambda[i] = L[i];
+                          done[i]   = 0.0;
+                      })
+}
+
+// One vector pass: every lane steps, and keeps its lambda once converged
+AVCALC_INLINE void geodesic_iterate_body(const earth_model *model, const double *sinU1, const double *cosU1,
+                                         const double *sinU2, const double *cosU2, const double *L,
+                                         double *restrict lambda, double *restrict done, int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double sigma;
+                          double sinSigma;
+                          double cosSigma;
+                          double cos2Alpha;
+                          double cos2SigmaM;
+                          double next = geodesic_step(&e, sinU1[i], cosU1[i], sinU2[i], cosU2[i], L[i], lambda[i],
+                                                      &sigma, &sinSigma, &cosSigma, &cos2Alpha, &cos2SigmaM, TIER);
+                          double converged = (fabs(next - lambda[i]) < GEODESIC_TOLERANCE) ? 1.0 : 0.0;
+                          lambda[i] = (done[i] > 0.0) ? lambda[i] : next;
+                          done[i]   = (done[i] > 0.0) ? 1.0 : converged;
+                      })
+}
+
+AVCALC_INLINE void geodesic_finish_body(const earth_model *model, const double *sinU1, const double *cosU1,
+                                        const double *sinU2, const double *cosU2, const double *L, const double *lambda,
+                                        double *restrict dist, double *restrict course_initial, double *restrict course_final,
+                                        int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double sigma;
+                          double sinSigma;
+                          double cosSigma;
+                          double cos2Alpha;
+                          double cos2SigmaM;
+                          double sinLambda;
+                          double cosLambda;
+                          geodesic_step(&e, sinU1[i], cosU1[i], sinU2[i], cosU2[i], L[i], lambda[i],
+                                        &sigma, &sinSigma, &cosSigma, &cos2Alpha, &cos2SigmaM, TIER);
+                          math_sincos(lambda[i], &sinLambda, &cosLambda, TIER);
+                          dist[i] = geodesic_length(&e, sigma, sinSigma, cosSigma, cos2Alpha, cos2SigmaM);
+                          course_initial[i] = R2D * math_atan2(cosU2[i] * sinLambda,
+                                                               cosU1[i] * sinU2[i] - sinU1[i] * cosU2[i] * cosLambda, TIER);
+                          course_final[i]   = R2D * math_atan2(cosU1[i] * sinLambda,
+                                                               cosU1[i] * sinU2[i] * cosLambda - sinU1[i] * cosU2[i], TIER);
+                      })
+}
+
+// One step of the direct solution for sigma, from s0 = s/(b*A)
+AVCALC_INLINE double geodesic_sigma_step(double s0, double B, double sigma1, double sigma, int tier)
+{
+    double sinSigma, cosSigma, cos2SigmaM;
+
+    math_sincos(sigma, &sinSigma, &cosSigma, tier);
+    cos2SigmaM = math_cos(2.0 * sigma1 + sigma, tier);
+    return s0 + B * sinSigma * (cos2SigmaM + B / 4.0 * (cosSigma * (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM)
+           - B / 6.0 * cos2SigmaM * (-3.0 + 4.0 * sinSigma * sinSigma) * (-3.0 + 4.0 * cos2SigmaM * cos2SigmaM)));
+}
+
+AVCALC_INLINE void geodesic_point(const earth_model *e, double lat1, double lon1, double course, double dist,
+                                  double *lat2, double *lon2, double *course2, int tier)
+{
+    double sinU1, cosU1, sinCrs, cosCrs, sigma1, sinAlpha, cos2Alpha, A, B, s0, sigma;
+    double sinSigma, cosSigma, cos2SigmaM, north, lambda, lon;
+
+    geodesic_reduced(lat1, e->f, &sinU1, &cosU1, tier);
+    math_sincos(D2R * course, &sinCrs, &cosCrs, tier);
+    sigma1    = math_atan2(sinU1, cosU1 * cosCrs, tier);
+    sinAlpha  = cosU1 * sinCrs;
+    cos2Alpha = 1.0 - sinAlpha * sinAlpha;
+    geodesic_series(e, cos2Alpha, &A, &B);
+    s0 = dist / (e->b * A);
+
+    // Written out rather than looped, so the batch loop stays vectorizable
+    sigma = geodesic_sigma_step(s0, B, sigma1, s0, tier);
+    sigma = geodesic_sigma_step(s0, B, sigma1, sigma, tier);
+    sigma = geodesic_sigma_step(s0, B, sigma1, sigma, tier);
+    sigma = geodesic_sigma_step(s0, B, sigma1, sigma, tier);
+    sigma = geodesic_sigma_step(s0, B, sigma1, sigma, tier);
+    math_sincos(sigma, &sinSigma, &cosSigma, tier);
+    cos2SigmaM = math_cos(2.0 * sigma1 + sigma, tier);
+
+    north  = sinU1 * sinSigma - cosU1 * cosSigma * cosCrs;
+    *lat2  = R2D * math_atan2(sinU1 * cosSigma + cosU1 * sinSigma * cosCrs,
+                              (1.0 - e->f) * sqrt(sinAlpha * sinAlpha + north * north), tier);
+    lambda = math_atan2(sinSigma * sinCrs, cosU1 * cosSigma - sinU1 * sinSigma * cosCrs, tier);
+    lon    = lon1 + R2D * (lambda - geodesic_lambda_gap(e, sinAlpha, cos2Alpha, sigma, sinSigma, cosSigma, cos2SigmaM)) + 180.0;
+    *lon2  = lon - 360.0 * floor(lon * (1.0 / 360.0)) - 180.0;
+    *course2 = R2D * math_atan2(sinAlpha, -north, tier);
+}
+
+AVCALC_INLINE void geodesic_direct_body(const earth_model *model, const double *lat1, const double *lon1,
+                                        const double *course, const double *dist,
+                                        double *restrict lat2, double *restrict lon2, double *restrict course_final,
+                                        int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) geodesic_point(&e, lat1[i], lon1[i], course[i], dist[i], &lat2[i], &lon2[i], &course_final[i], TIER);)
+}
+
+BATCH_KERNEL(geodesic_start, (const earth_model *model, const double *lat1, const double *lon1,
+                              const double *lat2, const double *lon2,
+                              double *restrict sinU1, double *restrict cosU1,
+                              double *restrict sinU2, double *restrict cosU2,
+                              double *restrict L, double *restrict lambda, double *restrict done, int n, int tier),
+                             (model, lat1, lon1, lat2, lon2, sinU1, cosU1, sinU2, cosU2, L, lambda, done, n, tier))
+BATCH_KERNEL(geodesic_iterate, (const earth_model *model, const double *sinU1, const double *cosU1,
+                                const double *sinU2, const double *cosU2, const double *L,
+                                double *restrict lambda, double *restrict done, int n, int tier),
+                               (model, sinU1, cosU1, sinU2, cosU2, L, lambda, done, n, tier))
+BATCH_KERNEL(geodesic_finish, (const earth_model *model, const double *sinU1, const double *cosU1,
+                               const double *sinU2, const double *cosU2, const double *L, const double *lambda,
+                               double *restrict dist, double *restrict course_initial, double *restrict course_final,
+                               int n, int tier),
+                              (model, sinU1, cosU1, sinU2, cosU2, L, lambda, dist, course_initial, course_final, n, tier))
+BATCH_KERNEL(geodesic_direct, (const earth_model *model, const double *lat1, const double *lon1,
+                               const double *course, const double *dist,
+                               double *restrict lat2, double *restrict lon2, double *restrict course_final,
+                               int n, int tier),
+                              (model, lat1, lon1, course, dist, lat2, lon2, course_final, n, tier))
+
+/* Longitude difference reached at reduced latitude U2 by the geodesic
+   leaving U1 <= 0 on azimuth alpha1 in [0, pi], |U2| <= -U1, at its
+   first crossing of U2 heading north of east or west. Also returns the
+   azimuth there and what the length of the geodesic needs. */
+static double geodesic_lambda12(const earth_model *e, double sinU1, double cosU1, double sinU2, double cosU2,
+                                double alpha1, double *alpha2, double *sigma12, double *cos2Alpha, double *cos2SigmaM)
+{
+    double sinAlpha1 = sin(alpha1), cosAlpha1 = cos(alpha1);
+    double sinAlpha0 = sinAlpha1 * cosU1;       // Clairaut's constant, sin(alpha)*cos(U)
+    double north1 = cosAlpha1 * cosU1;          // cos(alpha)*cos(U) at point 1
+    double north2, sigma1, sigma2, omega1, omega2;
+
+    // cos(alpha)*cos(U) at point 2, from sin(alpha0) and taken >= 0
+    north2 = sqrt(north1 * north1 + (cosU2 - cosU1) * (cosU2 + cosU1));
+    sigma1 = atan2(sinU1, north1);
+    sigma2 = atan2(sinU2, north2);
+    omega1 = atan2(sinAlpha0 * sinU1, north1);
+    omega2 = atan2(sinAlpha0 * sinU2, north2);
+
+    *alpha2     = atan2(sinAlpha0, north2);
+    *sigma12    = sigma2 - sigma1;
+    *cos2Alpha  = 1.0 - sinAlpha0 * sinAlpha0;
+    *cos2SigmaM = cos(sigma1 + sigma2);
+    return omega2 - omega1 - geodesic_lambda_gap(e, sinAlpha0, *cos2Alpha, *sigma12, sin(*sigma12), cos(*sigma12), *cos2SigmaM);
+}
+
+// Inverse problem for a pair the iteration on lambda has not solved
+static void geodesic_fallback(const earth_model *e, double lat1, double lon1, double lat2, double lon2,
+                              double *dist, double *course_initial, double *course_final)
+{
+    double L = geodesic_dlon(lon1, lon2);
+    double sinU1, cosU1, sinU2, cosU2, t;
+    double lo = 0.0, hi = M_PI, glo, ghi, alpha1 = 0.0, alpha2, sigma12, cos2Alpha, cos2SigmaM;
+    int swap = fabs(lat1) < fabs(lat2), west, north, side = 0;
+
+    // Arrange for |lat2| <= |lat1|, L >= 0 and lat1 <= 0
+    if (swap) {
+        t = lat1; lat1 = lat2; lat2 = t;
+        L = -L;
+    }
+    west  = L < 0.0;
+    L     = fabs(L);
+    north = lat1 > 0.0;
+    geodesic_reduced(north ? -lat1 : lat1, e->f, &sinU1, &cosU1, AVCALC_ACCURACY_FULL);
+    geodesic_reduced(north ? -lat2 : lat2, e->f, &sinU2, &cosU2, AVCALC_ACCURACY_FULL);
+    sinU1 = -fabs(sinU1);       // -0 on the equator, so alpha1 > pi/2 sets out southward
+
+    glo = geodesic_lambda12(e, sinU1, cosU1, sinU2, cosU2, lo, &alpha2, &sigma12, &cos2Alpha, &cos2SigmaM) - L;
+    ghi = geodesic_lambda12(e, sinU1, cosU1, sinU2, cosU2, hi, &alpha2, &sigma12, &cos2Alpha, &cos2SigmaM) - L;
+    for (int k = 0; k < 200; k++) {
+        double g;
+
+        alpha1 = (ghi > glo) ? lo - glo * (hi - lo) / (ghi - glo) : 0.5 * (lo + hi);
+        alpha1 = (alpha1 > lo && alpha1 < hi) ? alpha1 : 0.5 * (lo + hi);
+        g = geodesic_lambda12(e, sinU1, cosU1, sinU2, cosU2, alpha1, &alpha2, &sigma12, &cos2Alpha, &cos2SigmaM) - L;
+        if (fabs(g) < 1e-14 || hi - lo < 1e-14) {
+            break;
+        }
+        if (g < 0.0) {
+            lo  = alpha1;
+            glo = g;
+            ghi = (side < 0) ? 0.5 * ghi : ghi;
+            side = -1;
+        } else {
+            hi  = alpha1;
+            ghi = g;
+            glo = (side > 0) ? 0.5 * glo : glo;
+            side = 1;
+        }
+    }
+    *dist = geodesic_length(e, sigma12, sin(sigma12), cos(sigma12), cos2Alpha, cos2SigmaM);
+
+    // Undo the arrangement, in reverse order
+    if (north) {
+        alpha1 = M_PI - alpha1;
+        alpha2 = M_PI - alpha2;
+    }
+    if (west) {
+        alpha1 = -alpha1;
+        alpha2 = -alpha2;
+    }
+    if (swap) {
+        t = alpha1;
+        alpha1 = alpha2 + M_PI;
+        alpha2 = t + M_PI;
+    }
+    *course_initial = geodesic_course(R2D * alpha1);
+    *course_final   = geodesic_course(R2D * alpha2);
+}
+
+// Inverse problem for one pair at full accuracy, as a batch lane would solve it
+static void geodesic_pair(const earth_model *e, double lat1, double lon1, double lat2, double lon2,
+                          double *dist, double *course_initial, double *course_final)
+{
+    double sinU1, cosU1, sinU2, cosU2, L, lambda, next;
+    double sigma, sinSigma, cosSigma, cos2Alpha, cos2SigmaM, sinLambda, cosLambda;
+    int k;
+
+    geodesic_reduced(lat1, e->f, &sinU1, &cosU1, AVCALC_ACCURACY_FULL);
+    geodesic_reduced(lat2, e->f, &sinU2, &cosU2, AVCALC_ACCURACY_FULL);
+    L = lambda = geodesic_dlon(lon1, lon2);
+    for (k = 0; k < GEODESIC_ITERATIONS; k++) {
+        next = geodesic_step(e, sinU1, cosU1, sinU2, cosU2, L, lambda,
+                             &sigma, &sinSigma, &cosSigma, &cos2Alpha, &cos2SigmaM, AVCALC_ACCURACY_FULL);
+        if (fabs(next - lambda) < GEODESIC_TOLERANCE) {
+            lambda = next;
+            break;
+        }
+        lambda = next;
+    }
+    if (k == GEODESIC_ITERATIONS || fabs(lambda) > M_PI) {
+        geodesic_fallback(e, lat1, lon1, lat2, lon2, dist, course_initial, course_final);
+        return;
+    }
+
+    geodesic_step(e, sinU1, cosU1, sinU2, cosU2, L, lambda,
+                  &sigma, &sinSigma, &cosSigma, &cos2Alpha, &cos2SigmaM, AVCALC_ACCURACY_FULL);
+    math_sincos(lambda, &sinLambda, &cosLambda, AVCALC_ACCURACY_FULL);
+    *dist = geodesic_length(e, sigma, sinSigma, cosSigma, cos2Alpha, cos2SigmaM);
+    *course_initial = R2D * math_atan2(cosU2 * sinLambda, cosU1 * sinU2 - sinU1 * cosU2 * cosLambda, AVCALC_ACCURACY_FULL);
+    *course_final   = R2D * math_atan2(cosU1 * sinLambda, cosU1 * sinU2 * cosLambda - sinU1 * cosU2, AVCALC_ACCURACY_FULL);
+}
+
+static void geodesic_inverse_run(const earth_model *e, const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                                 double *dist, double *course_initial, double *course_final, int n, int tier)
+{
+    double sinU1[GEODESIC_BLOCK], cosU1[GEODESIC_BLOCK], sinU2[GEODESIC_BLOCK], cosU2[GEODESIC_BLOCK];
+    double L[GEODESIC_BLOCK], lambda[GEODESIC_BLOCK], done[GEODESIC_BLOCK];
+
+    for (int start = 0; start < n; start += GEODESIC_BLOCK) {
+        int m = (n - start < GEODESIC_BLOCK) ? n - start : GEODESIC_BLOCK;
+        int pass = 0, active = m;
+
+        BATCH_RUN(geodesic_start, (e, &lat1[start], &lon1[start], &lat2[start], &lon2[start],
+                                   sinU1, cosU1, sinU2, cosU2, L, lambda, done, m, tier))
+
+        // Vector passes while many lanes are still going
+        while (pass < GEODESIC_ITERATIONS && 8 * active > m) {
+            BATCH_RUN(geodesic_iterate, (e, sinU1, cosU1, sinU2, cosU2, L, lambda, done, m, tier))
+            pass++;
+            active = 0;
+            for (int i = 0; i < m; i++) {
+                active += (done[i] == 0.0);
+            }
+        }
+
+        // The few lanes left, one at a time
+        for (int i = 0; i < m && active > 0; i++) {
+            double sigma, sinSigma, cosSigma, cos2Alpha, cos2SigmaM, next;
+
+            for (int k = pass; k < GEODESIC_ITERATIONS && done[i] == 0.0; k++) {
+                next = geodesic_step(e, sinU1[i], cosU1[i], sinU2[i], cosU2[i], L[i], lambda[i],
+                                     &sigma, &sinSigma, &cosSigma, &cos2Alpha, &cos2SigmaM, tier);
+                done[i]   = (fabs(next - lambda[i]) < GEODESIC_TOLERANCE) ? 1.0 : 0.0;
+                lambda[i] = next;
+            }
+        }
+
+        BATCH_RUN(geodesic_finish, (e, sinU1, cosU1, sinU2, cosU2, L, lambda,
+                                    &dist[start], &course_initial[start], &course_final[start], m, tier))
+        for (int i = 0; i < m; i++) {
+            if (done[i] == 0.0 || fabs(lambda[i]) > M_PI) {
+                geodesic_fallback(e, lat1[start + i], lon1[start + i], lat2[start + i], lon2[start + i],
+                                  &dist[start + i], &course_initial[start + i], &course_final[start + i]);
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Distance and courses between points on an ellipsoid
+
+  The geodesic, the shortest path on the ellipsoid, from point 1 to point
+  2. The distance is good to a fraction of a millimetre, also between
+  nearly antipodal points. Between exactly antipodal points there are
+  several shortest paths and the courses of one of them are given. With
+  AVCALC_EARTH_SPHERE the results are those of the great circle.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 6: OUTPUT - Pointer to double receiving distance in nautical miles
+  Argument 7: OUTPUT - Pointer to double receiving initial course in degrees,
+                       in the range (-180, 180]
+  Argument 8: OUTPUT - Pointer to double receiving final course in degrees,
+                       in the range (-180, 180]
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeodesicInverse(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int model,
+                               double *dist, double *course_initial, double *course_final)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    geodesic_pair(e, *lat1, *lon1, *lat2, *lon2, dist, course_initial, course_final);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Distance and courses between many pairs of points on an ellipsoid
+
+  Same results as GeodesicInverse(), for n pairs given as separate
+  arrays, at the accuracy tier set by AccuracySelect(). The output arrays
+  must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 4: INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 5: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 6: OUTPUT - Array of n distances in nautical miles
+  Argument 7: OUTPUT - Array of n initial courses in degrees
+  Argument 8: OUTPUT - Array of n final courses in degrees
+  Argument 9: INPUT  - Number of pairs
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeodesicInverseBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int model,
+                                    double *dist, double *course_initial, double *course_final, int n)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    geodesic_inverse_run(e, lat1, lon1, lat2, lon2, dist, course_initial, course_final, n, accuracy_global);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Lat/lon given course and distance on an ellipsoid
+
+  The point reached along the geodesic leaving point 1 on the given
+  initial course, and the course there.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing initial course in degrees
+  Argument 4: INPUT  - Pointer to double containing distance in nautical miles
+  Argument 5: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 6: OUTPUT - Pointer to double receiving Latitude  in degrees
+  Argument 7: OUTPUT - Pointer to double receiving Longitude in degrees,
+                       in the range [-180, 180)
+  Argument 8: OUTPUT - Pointer to double receiving final course in degrees,
+                       in the range (-180, 180]
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeodesicDirect(const double *lat1, const double *lon1, const double *course, const double *dist, int model,
+                              double *latresult, double *lonresult, double *course_final)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    geodesic_point(e, *lat1, *lon1, *course, *dist, latresult, lonresult, course_final, AVCALC_ACCURACY_FULL);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Lat/lon given course and distance on an ellipsoid, for many points
+
+  Same results as GeodesicDirect(), for n points given as separate
+  arrays, at the accuracy tier set by AccuracySelect(). The output arrays
+  must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n initial courses in degrees
+  Argument 4: INPUT  - Array of n distances in nautical miles
+  Argument 5: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 6: OUTPUT - Array of n latitudes  in degrees
+  Argument 7: OUTPUT - Array of n longitudes in degrees
+  Argument 8: OUTPUT - Array of n final courses in degrees
+  Argument 9: INPUT  - Number of points
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeodesicDirectBatch(const double *lat1, const double *lon1, const double *course, const double *dist, int model,
+                                   double *latresult, double *lonresult, double *course_final, int n)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(geodesic_direct, (e, lat1, lon1, course, dist, latresult, lonresult, course_final, n, accuracy_global))
+    }
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Geodetic, geocentric and earth-centred coordinates
+
+  Earth-centred, earth-fixed (ECEF) coordinates have x towards latitude 0
+  and longitude 0, y towards longitude 90 E and z towards the north pole.
+  A point at geodetic latitude lat, longitude lon and height h above the
+  ellipsoid lies at
+
+    N = a/sqrt(1 - e^2*sin(lat)^2)
+    p = (N + h)*cos(lat)            distance from the polar axis
+    x = p*cos(lon),  y = p*sin(lon)
+    z = (N*(1-e^2) + h)*sin(lat)
+
+  The geocentric latitude u and radius r, as in the formulary, are the
+  direction and length of (p, z) in the meridian plane. The inverse from
+  (p, z) uses Bowring's method on the parametric latitude beta, starting
+  from tan(beta) = z/((1-f)*p):
+
+    tan(lat)  = (z + ep2*b*sin(beta)^3)/(p - e^2*a*cos(beta)^3)
+    tan(beta) = (1-f)*tan(lat)
+
+  The first step is good to well under a millimetre near the surface, and
+  the second to a few nanometres from 1000 nm below the surface out beyond
+  the orbit of the moon, and to 0.1 mm deeper inside. The two steps are
+  written out, so every point costs the same. The height follows from
+  h = p*cos(lat) + z*sin(lat) - a*sqrt(1 - e^2*sin(lat)^2).
+  All lengths are in nautical miles.
+--------------------------------------------------------------------------*/
+// Meridian plane coordinates of a geodetic latitude and height
+AVCALC_INLINE void ecef_meridian(const earth_model *e, double lat, double height, double *p, double *z, int tier)
+{
+    double sinLat, cosLat, N;
+
+    math_sincos(D2R * lat, &sinLat, &cosLat, tier);
+    N  = e->a / sqrt(1.0 - e->e2 * sinLat * sinLat);
+    *p = (N + height) * cosLat;
+    *z = (N * (1.0 - e->e2) + height) * sinLat;
+}
+
+// Sine and cosine of the angle of (c, s), or 0 and 0 at the origin
+AVCALC_INLINE void ecef_direction(double s, double c, double *sinA, double *cosA)
+{
+    double norm = s * s + c * c;
+    double h    = (norm > 0.0) ? 1.0 / sqrt(norm) : 0.0;
+
+    *sinA = s * h;
+    *cosA = c * h;
+}
+
+// One step of Bowring's method, from the parametric latitude to the geodetic
+AVCALC_INLINE void ecef_bowring(const earth_model *e, double p, double z, double sinBeta, double cosBeta,
+                                double *sinLat, double *cosLat)
+{
+    ecef_direction(z + e->ep2 * e->b * sinBeta * sinBeta * sinBeta,
+                   p - e->e2 * e->a * cosBeta * cosBeta * cosBeta, sinLat, cosLat);
+}
+
+// Geodetic latitude and height from meridian plane coordinates, p >= 0
+AVCALC_INLINE void ecef_geodetic(const earth_model *e, double p, double z, double *lat, double *height, int tier)
+{
+    double sinBeta, cosBeta, sinLat, cosLat;
+
+    // Written out rather than looped, so the batch loop stays vectorizable
+    ecef_direction(z, (1.0 - e->f) * p, &sinBeta, &cosBeta);
+    ecef_bowring(e, p, z, sinBeta, cosBeta, &sinLat, &cosLat);
+    ecef_direction((1.0 - e->f) * sinLat, cosLat, &sinBeta, &cosBeta);
+    ecef_bowring(e, p, z, sinBeta, cosBeta, &sinLat, &cosLat);
+
+    *lat    = R2D * math_atan2(sinLat, cosLat, tier);
+    *height = p * cosLat + z * sinLat - e->a * sqrt(1.0 - e->e2 * sinLat * sinLat);
+}
+
+AVCALC_INLINE void ecef_from_geodetic_body(const earth_model *model, const double *lat, const double *lon, const double *height,
+                                           double *restrict x, double *restrict y, double *restrict z, int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double p;
+                          double sinLon;
+                          double cosLon;
+                          ecef_meridian(&e, lat[i], height[i], &p, &z[i], TIER);
+                          math_sincos(D2R * lon[i], &sinLon, &cosLon, TIER);
+                          x[i] = p * cosLon;
+                          y[i] = p * sinLon;
+                      })
+}
+
+AVCALC_INLINE void ecef_to_geodetic_body(const earth_model *model, const double *x, const double *y, const double *z,
+                                         double *restrict lat, double *restrict lon, double *restrict height, int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          ecef_geodetic(&e, sqrt(x[i] * x[i] + y[i] * y[i]), z[i], &lat[i], &height[i], TIER);
+                          lon[i] = R2D * math_atan2(y[i], x[i], TIER);
+                      })
+}
+
+AVCALC_INLINE void ecef_to_geocentric_body(const earth_model *model, const double *lat, const double *height,
+                                           double *restrict latc, double *restrict radius, int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double p;
+                          double z;
+                          ecef_meridian(&e, lat[i], height[i], &p, &z, TIER);
+                          latc[i]   = R2D * math_atan2(z, p, TIER);
+                          radius[i] = sqrt(p * p + z * z);
+                      })
+}
+
+AVCALC_INLINE void ecef_from_geocentric_body(const earth_model *model, const double *latc, const double *radius,
+                                             double *restrict lat, double *restrict height, int n, int tier)
+{
+    earth_model e = *model;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double sinU;
+                          double cosU;
+                          math_sincos(D2R * latc[i], &sinU, &cosU, TIER);
+                          ecef_geodetic(&e, radius[i] * fabs(cosU), radius[i] * sinU, &lat[i], &height[i], TIER);
+                      })
+}
+
+BATCH_KERNEL(ecef_from_geodetic, (const earth_model *model, const double *lat, const double *lon, const double *height,
+                                  double *restrict x, double *restrict y, double *restrict z, int n, int tier),
+                                 (model, lat, lon, height, x, y, z, n, tier))
+BATCH_KERNEL(ecef_to_geodetic, (const earth_model *model, const double *x, const double *y, const double *z,
+                                double *restrict lat, double *restrict lon, double *restrict height, int n, int tier),
+                               (model, x, y, z, lat, lon, height, n, tier))
+BATCH_KERNEL(ecef_to_geocentric, (const earth_model *model, const double *lat, const double *height,
+                                  double *restrict latc, double *restrict radius, int n, int tier),
+                                 (model, lat, height, latc, radius, n, tier))
+BATCH_KERNEL(ecef_from_geocentric, (const earth_model *model, const double *latc, const double *radius,
+                                    double *restrict lat, double *restrict height, int n, int tier),
+                                   (model, latc, radius, lat, height, n, tier))
+
+/*--------------------------------------------------------------------------
+  Earth-centred coordinates of geodetic points
+
+  For n points given as separate arrays, at the accuracy tier set by
+  AccuracySelect(). The output arrays must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n geodetic latitudes in degrees
+  Argument 2: INPUT  - Array of n longitudes in degrees
+  Argument 3: INPUT  - Array of n heights above the ellipsoid in nautical miles
+  Argument 4: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 5: OUTPUT - Array of n x coordinates in nautical miles
+  Argument 6: OUTPUT - Array of n y coordinates in nautical miles
+  Argument 7: OUTPUT - Array of n z coordinates in nautical miles
+  Argument 8: INPUT  - Number of points
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeodeticToEcef(const double *lat, const double *lon, const double *height, int model,
+                              double *x, double *y, double *z, int n)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(ecef_from_geodetic, (e, lat, lon, height, x, y, z, n, accuracy_global))
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Geodetic coordinates of earth-centred points
+
+  The inverse of GeodeticToEcef(), with the same cost for every point.
+  Points on the polar axis are given longitude 0, and the centre of the
+  earth latitude 0. The output arrays must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n x coordinates in nautical miles
+  Argument 2: INPUT  - Array of n y coordinates in nautical miles
+  Argument 3: INPUT  - Array of n z coordinates in nautical miles
+  Argument 4: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 5: OUTPUT - Array of n geodetic latitudes in degrees
+  Argument 6: OUTPUT - Array of n longitudes in degrees, in the range [-180, 180]
+  Argument 7: OUTPUT - Array of n heights above the ellipsoid in nautical miles
+  Argument 8: INPUT  - Number of points
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL EcefToGeodetic(const double *x, const double *y, const double *z, int model,
+                              double *lat, double *lon, double *height, int n)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(ecef_to_geodetic, (e, x, y, z, lat, lon, height, n, accuracy_global))
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Geocentric latitude and radius of geodetic points
+
+  The geocentric latitude is the angle at the centre of the earth between
+  the equator and the point, the radius its distance from the centre.
+  Geocentric and geodetic longitudes are equal. For n points given as
+  separate arrays, at the accuracy tier set by AccuracySelect().
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n geodetic latitudes in degrees
+  Argument 2: INPUT  - Array of n heights above the ellipsoid in nautical miles
+  Argument 3: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 4: OUTPUT - Array of n geocentric latitudes in degrees
+  Argument 5: OUTPUT - Array of n radii in nautical miles
+  Argument 6: INPUT  - Number of points
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeodeticToGeocentric(const double *lat, const double *height, int model,
+                                    double *latc, double *radius, int n)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(ecef_to_geocentric, (e, lat, height, latc, radius, n, accuracy_global))
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Geodetic latitude and height of geocentric points
+
+  The inverse of GeodeticToGeocentric(), with the same cost for every
+  point.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n geocentric latitudes in degrees
+  Argument 2: INPUT  - Array of n radii in nautical miles
+  Argument 3: INPUT  - Earth model, AVCALC_EARTH_WGS84 or another AVCALC_EARTH_ value
+  Argument 4: OUTPUT - Array of n geodetic latitudes in degrees
+  Argument 5: OUTPUT - Array of n heights above the ellipsoid in nautical miles
+  Argument 6: INPUT  - Number of points
+
+  RETURN: 0 on success, -1 if the model is unknown
+--------------------------------------------------------------------------*/
+int AVCALCCALL GeocentricToGeodetic(const double *latc, const double *radius, int model,
+                                    double *lat, double *height, int n)
+{
+    const earth_model *e = earth_model_get(model);
+
+    if (e == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(ecef_from_geocentric, (e, latc, radius, lat, height, n, accuracy_global))
+    }
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Intersection of two radials
+
+  A radial from point p on course tc runs along the great circle with
+  pole n = p x t, t being the unit vector of the course at p:
+
+    t = cos(tc)*north + sin(tc)*east
+
+  Two great circles meet at +-x, x = n1 x n2. The intersection is the one
+  of them that lies ahead on both radials, x . t > 0 for each. If the
+  great circles coincide there is an infinity of intersections. If the
+  radial from one point has the crossing ahead while the other has it
+  behind, the intersection is ambiguous. Results other than unique give
+  NaN for lat3 and lon3. Coinciding points 1 and 2 give that point.
+--------------------------------------------------------------------------*/
+#define RADIAL_PARALLEL  1e-12      // |n1 x n2| of coinciding great circles
+#define RADIAL_ABEAM     1e-12      // |x . t| taken as 0, relative to |x|, for x at one of the points
+
+typedef struct {
+    double px, py, pz;      // point
+    double tx, ty, tz;      // course
+    double nx, ny, nz;      // pole
+} radial_frame;
+
+AVCALC_INLINE void radial_frame_init(double lat, double lon, double course, radial_frame *r, int tier)
+{
+    double sinLat, cosLat, sinLon, cosLon, sinCrs, cosCrs;
+
+    math_sincos(D2R * lat,    &sinLat, &cosLat, tier);
+    math_sincos(D2R * lon,    &sinLon, &cosLon, tier);
+    math_sincos(D2R * course, &sinCrs, &cosCrs, tier);
+
+    r->px = cosLat * cosLon;
+    r->py = cosLat * sinLon;
+    r->pz = sinLat;
+    r->tx = -cosCrs * sinLat * cosLon - sinCrs * sinLon;
+    r->ty = -cosCrs * sinLat * sinLon + sinCrs * cosLon;
+    r->tz =  cosCrs * cosLat;
+    r->nx = r->py * r->tz - r->pz * r->ty;
+    r->ny = r->pz * r->tx - r->px * r->tz;
+    r->nz = r->px * r->ty - r->py * r->tx;
+}
+
+AVCALC_INLINE void radial_intersection(const radial_frame *r1, const radial_frame *r2,
+                                       double *lat3, double *lon3, int *status, int tier)
+{
+    double x = r1->ny * r2->nz - r1->nz * r2->ny;
+    double y = r1->nz * r2->nx - r1->nx * r2->nz;
+    double z = r1->nx * r2->ny - r1->ny * r2->nx;
+    double norm  = sqrt(x * x + y * y + z * z);
+    double ahead1 = x * r1->tx + y * r1->ty + z * r1->tz;
+    double ahead2 = x * r2->tx + y * r2->ty + z * r2->tz;
+    double sign, behind, least, lat, lon, result;     // result as a double keeps the loops vectorizable
+
+    // Points 1 and 2 coincide: x is +-p and lies abeam both radials
+    ahead1 = (fabs(ahead1) < RADIAL_ABEAM * norm) ? 0.0 : ahead1;
+    ahead2 = (fabs(ahead2) < RADIAL_ABEAM * norm) ? 0.0 : ahead2;
+    sign   = (ahead1 + ahead2 < 0.0) ? -1.0 : 1.0;
+    behind = (x * r1->px + y * r1->py + z * r1->pz < 0.0) ? -1.0 : 1.0;
+    sign   = (fabs(ahead1) + fabs(ahead2) == 0.0) ? behind : sign;
+    x *= sign;
+    y *= sign;
+    z *= sign;
+    ahead1 *= sign;
+    ahead2 *= sign;
+
+    least  = (ahead1 < ahead2) ? ahead1 : ahead2;
+    result = (least >= 0.0) ? AVCALC_INTERSECT_UNIQUE : AVCALC_INTERSECT_AMBIGUOUS;
+    result = (norm < RADIAL_PARALLEL) ? AVCALC_INTERSECT_INFINITE : result;
+
+    lat = R2D * math_atan2(z, sqrt(x * x + y * y), tier);
+    lon = R2D * math_atan2(y, x, tier);
+    *lat3 = (result == AVCALC_INTERSECT_UNIQUE) ? lat : NAN;
+    *lon3 = (result == AVCALC_INTERSECT_UNIQUE) ? lon : NAN;
+    *status = (int)result;
+}
+
+AVCALC_INLINE void intersect_batch_body(const double *lat1, const double *lon1, const double *crs13,
+                                        const double *lat2, const double *lon2, const double *crs23,
+                                        double *restrict lat3, double *restrict lon3, int *restrict status, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          radial_frame r1;
+                          radial_frame r2;
+                          radial_frame_init(lat1[i], lon1[i], crs13[i], &r1, TIER);
+                          radial_frame_init(lat2[i], lon2[i], crs23[i], &r2, TIER);
+                          radial_intersection(&r1, &r2, &lat3[i], &lon3[i], &status[i], TIER);
+                      })
+}
+
+// Radial 1 shared by all elements, its frame found once
+AVCALC_INLINE void intersect_from_body(const radial_frame *frame, const double *lat2, const double *lon2, const double *crs23,
+                                       double *restrict lat3, double *restrict lon3, int *restrict status, int n, int tier)
+{
+    radial_frame r1 = *frame;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          radial_frame r2;
+                          radial_frame_init(lat2[i], lon2[i], crs23[i], &r2, TIER);
+                          radial_intersection(&r1, &r2, &lat3[i], &lon3[i], &status[i], TIER);
+                      })
+}
+
+BATCH_KERNEL(intersect_batch, (const double *lat1, const double *lon1, const double *crs13,
+                               const double *lat2, const double *lon2, const double *crs23,
+                               double *restrict lat3, double *restrict lon3, int *restrict status, int n, int tier),
+                              (lat1, lon1, crs13, lat2, lon2, crs23, lat3, lon3, status, n, tier))
+BATCH_KERNEL(intersect_from, (const radial_frame *frame, const double *lat2, const double *lon2, const double *crs23,
+                              double *restrict lat3, double *restrict lon3, int *restrict status, int n, int tier),
+                             (frame, lat2, lon2, crs23, lat3, lon3, status, n, tier))
+
+/*--------------------------------------------------------------------------
+  Intersection of two radials
+
+  The point 3 formed by the crs13 true course from point 1 and the crs23
+  true course from point 2.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing course from point 1 in degrees
+  Argument 4: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 5: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 6: INPUT  - Pointer to double containing course from point 2 in degrees
+  Argument 7: OUTPUT - Pointer to double receiving Latitude  of point 3 in degrees
+  Argument 8: OUTPUT - Pointer to double receiving Longitude of point 3 in degrees
+
+  RETURN: AVCALC_INTERSECT_UNIQUE, AVCALC_INTERSECT_INFINITE or
+          AVCALC_INTERSECT_AMBIGUOUS
+--------------------------------------------------------------------------*/
+int AVCALCCALL RadialIntersection(const double *lat1, const double *lon1, const double *crs13, const double *lat2, const double *lon2, const double *crs23, double *lat3, double *lon3)
+{
+    radial_frame r1, r2;
+    int status;
+
+    radial_frame_init(*lat1, *lon1, *crs13, &r1, AVCALC_ACCURACY_FULL);
+    radial_frame_init(*lat2, *lon2, *crs23, &r2, AVCALC_ACCURACY_FULL);
+    radial_intersection(&r1, &r2, lat3, lon3, &status, AVCALC_ACCURACY_FULL);
+    return status;
+}
+
+/*--------------------------------------------------------------------------
+  Intersection of many pairs of radials
+
+  Same results as RadialIntersection(), for n pairs of radials given as
+  separate arrays, at the accuracy tier set by AccuracySelect(). The
+  output arrays must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1:  INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2:  INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3:  INPUT  - Array of n courses from point 1 in degrees
+  Argument 4:  INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 5:  INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 6:  INPUT  - Array of n courses from point 2 in degrees
+  Argument 7:  OUTPUT - Array of n latitudes  of point 3 in degrees
+  Argument 8:  OUTPUT - Array of n longitudes of point 3 in degrees
+  Argument 9:  OUTPUT - Array of n AVCALC_INTERSECT_ status codes
+  Argument 10: INPUT  - Number of pairs
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RadialIntersectionBatch(const double *lat1, const double *lon1, const double *crs13, const double *lat2, const double *lon2, const double *crs23, double *lat3, double *lon3, int *status, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(intersect_batch, (lat1, lon1, crs13, lat2, lon2, crs23, lat3, lon3, status, n, accuracy_global))
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Intersection of one radial with many others
+
+  As RadialIntersectionBatch(), with the same radial 1 for all elements,
+  such as a leg of a reference route against the legs of many others.
+  The great circle of radial 1 is then found only once.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1:  INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2:  INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3:  INPUT  - Pointer to double containing course from point 1 in degrees
+  Argument 4:  INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 5:  INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 6:  INPUT  - Array of n courses from point 2 in degrees
+  Argument 7:  OUTPUT - Array of n latitudes  of point 3 in degrees
+  Argument 8:  OUTPUT - Array of n longitudes of point 3 in degrees
+  Argument 9:  OUTPUT - Array of n AVCALC_INTERSECT_ status codes
+  Argument 10: INPUT  - Number of radials from point 2
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RadialIntersectionBatchFrom(const double *lat1, const double *lon1, const double *crs13, const double *lat2, const double *lon2, const double *crs23, double *lat3, double *lon3, int *status, int n)
+{
+    radial_frame r1;
+
+    if (n > 0) {
+        radial_frame_init(*lat1, *lon1, *crs13, &r1, accuracy_global);
+        BATCH_RUN(intersect_from, (&r1, lat2, lon2, crs23, lat3, lon3, status, n, accuracy_global))
+    }
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Evaluate a math function over an array with the polynomial kernels
+
+  Gives access to the kernels that the batch functions are built on, for
+  use on their own and for measuring their accuracy and speed.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - One of the AVCALC_MATH_ constants
+  Argument 2: INPUT  - Array of n first arguments, in radians for sin/cos
+  Argument 3: INPUT  - Array of n second arguments for atan2 (x), pow (the
+                       exponent) and fmod (the divisor), otherwise unused
+                       and may be NULL
+  Argument 4: OUTPUT - Array of n results
+  Argument 5: INPUT  - Number of elements
+  Argument 6: INPUT  - One of the AVCALC_ACCURACY_ constants
+
+  RETURN: 0 on success, -1 if the function or accuracy is not valid
+--------------------------------------------------------------------------*/
+int AVCALCCALL MathBatch(int function, const double *x, const double *y, double *result, int n, int accuracy)
+{
+    int tier = math_tier(accuracy);
+
+    if (function < AVCALC_MATH_SIN || function > AVCALC_MATH_FMOD ||
+        tier < AVCALC_ACCURACY_FULL || tier > AVCALC_ACCURACY_DISPLAY) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(math_batch, (function, x, y, result, n, tier))
+    }
+    return 0;
+}
+
+
+/*--------------------------------------------------------------------------
+  Worker threads
+
+  parallel_run() calls task(context, t) for t = 0..tasks-1, spread over up
+  to 'threads' threads including the calling one. Tasks are handed out one
+  at a time from a shared counter, so uneven tasks balance themselves.
+--------------------------------------------------------------------------*/
+#define PARALLEL_MAX_THREADS 64
+
+typedef void (*parallel_task_fn)(void *context, int task);
+
+typedef struct {
+    parallel_task_fn task;
+    void            *context;
+    int              tasks;
+    volatile long    next;
+} parallel_job;
+
+static int parallel_next_task(parallel_job *job)
+{
+#if defined(_WIN32)
+    return (int)InterlockedIncrement(&job->next) - 1;
+#else
+    return (int)__atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI parallel_worker(LPVOID arg)
+#else
+static void *parallel_worker(void *arg)
+#endif
+{
+    parallel_job *job = (parallel_job *)arg;
+    int t;
+
+    while ((t = parallel_next_task(job)) < job->tasks) {
+        job->task(job->context, t);
+    }
+    return 0;
+}
+
+static void parallel_run(parallel_task_fn task, void *context, int tasks, int threads)
+{
+    parallel_job job = {task, context, tasks, 0};
+#if defined(_WIN32)
+    HANDLE workers[PARALLEL_MAX_THREADS];
+#else
+    pthread_t workers[PARALLEL_MAX_THREADS];
+#endif
+    int started = 0;
+
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+    if (threads > tasks)                threads = tasks;
+
+    // If a thread cannot be created its share is taken by the others
+    for (int i = 1; i < threads; i++) {
+#if defined(_WIN32)
+        workers[started] = CreateThread(NULL, 0, parallel_worker, &job, 0, NULL);
+        if (workers[started] != NULL) started++;
+#else
+        if (pthread_create(&workers[started], NULL, parallel_worker, &job) == 0) started++;
+#endif
+    }
+    parallel_worker(&job);
+
+    for (int i = 0; i < started; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(workers[i], INFINITE);
+        CloseHandle(workers[i]);
+#else
+        pthread_join(workers[i], NULL);
+#endif
+    }
+}
+
+
+/*--------------------------------------------------------------------------
+  Distance matrix
+
+  The unit vector of every point is computed once, after which the
+  distance of each pair needs no trigonometry: it follows from the chord
+  between the two vectors, d = 2*asin(chord/2). The output is filled in
+  tiles of MATRIX_TILE_ROWS x MATRIX_TILE_COLS, so the column vectors of a
+  tile stay in L1 cache while its rows are computed. The tiles are the
+  tasks handed to the worker threads.
+--------------------------------------------------------------------------*/
+#define MATRIX_TILE_ROWS 32
+#define MATRIX_TILE_COLS 512   // 3 x 4 kB of column vectors
+
+typedef struct {
+    const double *x1, *y1, *z1;   // Row points
+    const double *x2, *y2, *z2;   // Column points
+    int           n, m;
+    int           tile_cols;      // Number of tiles across a row
+    int           upper;          // Fill only the upper triangle (j >= i)
+    double       *dist;
+} matrix_job;
+
+static void matrix_tile(void *context, int task)
+{
+    const matrix_job *job = (const matrix_job *)context;
+    int i0 = (task / job->tile_cols) * MATRIX_TILE_ROWS;
+    int j0 = (task % job->tile_cols) * MATRIX_TILE_COLS;
+    int i1 = (i0 + MATRIX_TILE_ROWS < job->n) ? i0 + MATRIX_TILE_ROWS : job->n;
+    int j1 = (j0 + MATRIX_TILE_COLS < job->m) ? j0 + MATRIX_TILE_COLS : job->m;
+
+    for (int i = i0; i < i1; i++) {
+        int j = (job->upper && j0 < i) ? i : j0;
+
+        if (j < j1) {
+            kernels->distance_row(job->x1[i], job->y1[i], job->z1[i],
+                                  job->x2 + j, job->y2 + j, job->z2 + j,
+                                  job->dist + (size_t)i * job->m + j, j1 - j);
+        }
+    }
+}
+
+static int matrix_run(const double *lat1, const double *lon1, int n, const double *lat2, const double *lon2, int m,
+                      double *dist, int threads, int upper)
+{
+    double *vectors = (double *)malloc(sizeof(double) * 3 * ((size_t)n + (upper ? 0 : (size_t)m)));
+    double *x, *y, *z;
+    matrix_job job;
+
+    if (vectors == NULL) {
+        return -1; //Error condition
+    }
+
+    x = vectors;
+    y = x + n;
+    z = y + n;
+    for (int i = 0; i < n; i++) {
+        unit_vector_poly(lat1[i], lon1[i], &x[i], &y[i], &z[i]);
+    }
+    job.x1 = x;
+    job.y1 = y;
+    job.z1 = z;
+
+    if (!upper) {
+        x = z + n;
+        y = x + m;
+        z = y + m;
+        for (int j = 0; j < m; j++) {
+            unit_vector_poly(lat2[j], lon2[j], &x[j], &y[j], &z[j]);
+        }
+    }
+    job.x2 = x;
+    job.y2 = y;
+    job.z2 = z;
+
+    job.n = n;
+    job.m = m;
+    job.tile_cols = (m + MATRIX_TILE_COLS - 1) / MATRIX_TILE_COLS;
+    job.upper = upper;
+    job.dist = dist;
+
+    parallel_run(matrix_tile, &job, ((n + MATRIX_TILE_ROWS - 1) / MATRIX_TILE_ROWS) * job.tile_cols, threads);
+    free(vectors);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Distance matrix between two sets of points
+
+  Fills an n x m matrix, stored row by row, with the great circle distance
+  from each of n points to each of m points. Element [i*m + j] is the
+  distance from {lat1[i],lon1[i]} to {lat2[j],lon2[j]}, equal to
+  DistanceBatch() for the same pair to within 1e-9 nm.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of the row points in degrees
+  Argument 2: INPUT  - Array of n longitudes of the row points in degrees
+  Argument 3: INPUT  - Number of row points
+  Argument 4: INPUT  - Array of m latitudes  of the column points in degrees
+  Argument 5: INPUT  - Array of m longitudes of the column points in degrees
+  Argument 6: INPUT  - Number of column points
+  Argument 7: OUTPUT - Array of n*m distances in nautical miles
+  Argument 8: INPUT  - Number of threads to use, 1 or less for the calling
+                       thread only
+
+  RETURN: 0 on success, -1 if memory could not be allocated
+--------------------------------------------------------------------------*/
+int AVCALCCALL DistanceMatrix(const double *lat1, const double *lon1, int n, const double *lat2, const double *lon2, int m, double *dist, int threads)
+{
+    if (n <= 0 || m <= 0) {
+        return 0;
+    }
+    return matrix_run(lat1, lon1, n, lat2, lon2, m, dist, threads, 0);
+}
+
+/*--------------------------------------------------------------------------
+  Distance matrix of a set of points to itself
+
+  As DistanceMatrix() with the same n points for rows and columns. Since
+  the matrix is symmetric only the upper triangle, j >= i, is written;
+  the elements below the diagonal are left untouched.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  in degrees
+  Argument 2: INPUT  - Array of n longitudes in degrees
+  Argument 3: INPUT  - Number of points
+  Argument 4: OUTPUT - Array of n*n distances in nautical miles
+  Argument 5: INPUT  - Number of threads to use, 1 or less for the calling
+                       thread only
+
+  RETURN: 0 on success, -1 if memory could not be allocated
+--------------------------------------------------------------------------*/
+int AVCALCCALL DistanceMatrixSymmetric(const double *lat, const double *lon, int n, double *dist, int threads)
+{
+    if (n <= 0) {
+        return 0;
+    }
+    return matrix_run(lat, lon, n, NULL, NULL, n, dist, threads, 1);
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Closest point of approach
+
+  Each aircraft flies its great circle at constant groundspeed, as in the
+  direct formula:
+
+    p(t) = u*cos(w*t) + e*sin(w*t)
+
+  u being the unit vector of its position, e that of its track and w its
+  angular speed. The time of closest approach of two aircraft is first
+  estimated from their straight line relative motion at t = 0, then
+  refined by CONFLICT_NEWTON Newton steps on the squared chord between
+  them, |pa(t) - pb(t)|^2, kept within [0, lookahead]. For look-ahead
+  times over which the tracks curve little, as in conflict alerting, this
+  is the closest approach over the interval.
+
+  For all pairs of a set, the aircraft are bucketed into a spatial hash
+  of cubic cells over their unit vectors, the cell size being the chord
+  of the furthest two aircraft can close in the look-ahead time plus the
+  separation. Unit vectors need no care at the poles or the antimeridian.
+  Only pairs in neighbouring cells are tested. The aircraft, in cell
+  order, are split into blocks of CONFLICT_BLOCK as the tasks handed to
+  the worker threads, each collecting its own conflicts.
+--------------------------------------------------------------------------*/
+#define CONFLICT_NEWTON 2
+#define CONFLICT_BLOCK  256
+#define CONFLICT_CELLS  (1 << 20)       // most cells along an axis
+
+typedef struct {
+    double x, y, z;         // position
+    double ex, ey, ez;      // track
+    double w;               // angular speed, rad/s
+} conflict_track;
+
+typedef struct {
+    int    first, second;
+    double tcpa, dcpa;
+} conflict_pair;
+
+typedef struct {
+    conflict_pair *pairs;
+    int            count, capacity;
+} conflict_list;
+
+typedef struct {
+    uint64_t key;           // cell
+    int      aircraft;
+} conflict_entry;
+
+typedef struct {
+    uint64_t key;
+    int      start, count;  // run of the cell in the sorted entries, count 0 if free
+} conflict_cell;
+
+typedef struct {
+    const conflict_track *tracks;
+    const conflict_entry *entries;
+    const conflict_cell  *table;
+    uint64_t              mask;         // table size - 1
+    int                   n;
+    int64_t               cells;        // cells along an axis
+    double                size;         // cell size
+    double                reach;        // squared chord of the furthest pair that may conflict
+    double                lookahead;
+    double                separation;   // radians
+    conflict_list        *lists;        // conflicts found by each task
+    volatile int          failed;
+} conflict_job;
+
+static void conflict_track_init(double lat, double lon, double track, double speed, conflict_track *a)
+{
+    double sinLat = sin(D2R * lat), cosLat = cos(D2R * lat);
+    double sinLon = sin(D2R * lon), cosLon = cos(D2R * lon);
+    double sinTrk = sin(D2R * track), cosTrk = cos(D2R * track);
+
+    a->x  = cosLat * cosLon;
+    a->y  = cosLat * sinLon;
+    a->z  = sinLat;
+    a->ex = -cosTrk * sinLat * cosLon - sinTrk * sinLon;
+    a->ey = -cosTrk * sinLat * sinLon + sinTrk * cosLon;
+    a->ez =  cosTrk * cosLat;
+    a->w  = D2R * speed / (60 * 3600);
+}
+
+// Position and velocity at time t
+static void conflict_state(const conflict_track *a, double t, double p[3], double v[3])
+{
+    double s = sin(a->w * t), c = cos(a->w * t);
+
+    p[0] = a->x * c + a->ex * s;
+    p[1] = a->y * c + a->ey * s;
+    p[2] = a->z * c + a->ez * s;
+    v[0] = a->w * (a->ex * c - a->x * s);
+    v[1] = a->w * (a->ey * c - a->y * s);
+    v[2] = a->w * (a->ez * c - a->z * s);
+}
+
+// Angle at closest approach, in radians
+static double conflict_cpa(const conflict_track *a, const conflict_track *b, double lookahead, double *tcpa)
+{
+    double pa[3], va[3], pb[3], vb[3], dp[3], dv[3], f1, f2, vv, chord, t;
+
+    dp[0] = a->x - b->x;
+    dp[1] = a->y - b->y;
+    dp[2] = a->z - b->z;
+    dv[0] = a->w * a->ex - b->w * b->ex;
+    dv[1] = a->w * a->ey - b->w * b->ey;
+    dv[2] = a->w * a->ez - b->w * b->ez;
+    vv = dv[0] * dv[0] + dv[1] * dv[1] + dv[2] * dv[2];
+    t  = (vv > 0.0) ? -(dp[0] * dv[0] + dp[1] * dv[1] + dp[2] * dv[2]) / vv : 0.0;
+    t  = fmin(fmax(t, 0.0), lookahead);
+
+    for (int k = 0; k < CONFLICT_NEWTON; k++) {
+        conflict_state(a, t, pa, va);
+        conflict_state(b, t, pb, vb);
+        f1 = f2 = 0.0;
+        for (int c = 0; c < 3; c++) {
+            double d  = pa[c] - pb[c];
+            double dd = va[c] - vb[c];
+            double da = b->w * b->w * pb[c] - a->w * a->w * pa[c];
+
+            f1 += d * dd;
+            f2 += dd * dd + d * da;
+        }
+        t = (f2 > 0.0) ? t - f1 / f2 : t;
+        t = fmin(fmax(t, 0.0), lookahead);
+    }
+
+    conflict_state(a, t, pa, va);
+    conflict_state(b, t, pb, vb);
+    chord = sqrt((pa[0] - pb[0]) * (pa[0] - pb[0]) + (pa[1] - pb[1]) * (pa[1] - pb[1]) + (pa[2] - pb[2]) * (pa[2] - pb[2]));
+    *tcpa = t;
+    return 2 * asin(fmin(0.5 * chord, 1.0));
+}
+
+static int64_t conflict_axis(double x, const conflict_job *job)
+{
+    int64_t c = (int64_t)floor((x + 1.0) / job->size);
+
+    return (c < job->cells) ? c : job->cells - 1;
+}
+
+static uint64_t conflict_key(int64_t cx, int64_t cy, int64_t cz, int64_t cells)
+{
+    return (uint64_t)cx + (uint64_t)cells * ((uint64_t)cy + (uint64_t)cells * (uint64_t)cz);
+}
+
+static const conflict_cell *conflict_lookup(const conflict_job *job, uint64_t key)
+{
+    uint64_t slot = (key * 0x9E3779B97F4A7C15ULL) & job->mask;
+
+    while (job->table[slot].count > 0) {
+        if (job->table[slot].key == key) {
+            return &job->table[slot];
+        }
+        slot = (slot + 1) & job->mask;
+    }
+    return NULL;
+}
+
+static int conflict_add(conflict_list *list, int first, int second, double tcpa, double dcpa)
+{
+    if (list->count == list->capacity) {
+        int capacity = (list->capacity > 0) ? 2 * list->capacity : 64;
+        conflict_pair *pairs = (conflict_pair *)realloc(list->pairs, sizeof(conflict_pair) * (size_t)capacity);
+
+        if (pairs == NULL) {
+            return -1; //Error condition
+        }
+        list->pairs    = pairs;
+        list->capacity = capacity;
+    }
+    list->pairs[list->count].first  = first;
+    list->pairs[list->count].second = second;
+    list->pairs[list->count].tcpa   = tcpa;
+    list->pairs[list->count].dcpa   = dcpa;
+    list->count++;
+    return 0;
+}
+
+static void conflict_block(void *context, int task)
+{
+    conflict_job *job = (conflict_job *)context;
+    int k0 = task * CONFLICT_BLOCK;
+    int k1 = (k0 + CONFLICT_BLOCK < job->n) ? k0 + CONFLICT_BLOCK : job->n;
+
+    for (int k = k0; k < k1 && !job->failed; k++) {
+        int i = job->entries[k].aircraft;
+        const conflict_track *a = &job->tracks[i];
+        int64_t cx = conflict_axis(a->x, job);
+        int64_t cy = conflict_axis(a->y, job);
+        int64_t cz = conflict_axis(a->z, job);
+
+        for (int64_t z = cz - 1; z <= cz + 1; z++)
+        for (int64_t y = cy - 1; y <= cy + 1; y++)
+        for (int64_t x = cx - 1; x <= cx + 1; x++) {
+            const conflict_cell *cell;
+
+            if (x < 0 || y < 0 || z < 0 || x >= job->cells || y >= job->cells || z >= job->cells) {
+                continue;
+            }
+            cell = conflict_lookup(job, conflict_key(x, y, z, job->cells));
+            if (cell == NULL) {
+                continue;
+            }
+            for (int m = cell->start; m < cell->start + cell->count; m++) {
+                int j = job->entries[m].aircraft;
+                const conflict_track *b = &job->tracks[j];
+                double dx = a->x - b->x, dy = a->y - b->y, dz = a->z - b->z;
+                double tcpa, dcpa;
+
+                if (j <= i || dx * dx + dy * dy + dz * dz > job->reach) {
+                    continue;
+                }
+                dcpa = conflict_cpa(a, b, job->lookahead, &tcpa);
+                if (dcpa < job->separation && conflict_add(&job->lists[task], i, j, tcpa, 60 * R2D * dcpa) != 0) {
+                    job->failed = 1;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static int conflict_entry_compare(const void *p, const void *q)
+{
+    const conflict_entry *a = (const conflict_entry *)p, *b = (const conflict_entry *)q;
+
+    if (a->key != b->key) {
+        return (a->key < b->key) ? -1 : 1;
+    }
+    return a->aircraft - b->aircraft;
+}
+
+static int conflict_pair_compare(const void *p, const void *q)
+{
+    const conflict_pair *a = (const conflict_pair *)p, *b = (const conflict_pair *)q;
+
+    if (a->first != b->first) {
+        return a->first - b->first;
+    }
+    return a->second - b->second;
+}
+
+/*--------------------------------------------------------------------------
+  Closest point of approach of two aircraft
+
+  Time and distance of closest approach within the look-ahead time, each
+  aircraft flying its great circle at constant groundspeed from its
+  position on its track.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1:  INPUT  - Pointer to double containing Latitude  of aircraft 1 in degrees
+  Argument 2:  INPUT  - Pointer to double containing Longitude of aircraft 1 in degrees
+  Argument 3:  INPUT  - Pointer to double containing true track of aircraft 1 in degrees
+  Argument 4:  INPUT  - Pointer to double containing groundspeed of aircraft 1 in knots
+  Argument 5:  INPUT  - Pointer to double containing Latitude  of aircraft 2 in degrees
+  Argument 6:  INPUT  - Pointer to double containing Longitude of aircraft 2 in degrees
+  Argument 7:  INPUT  - Pointer to double containing true track of aircraft 2 in degrees
+  Argument 8:  INPUT  - Pointer to double containing groundspeed of aircraft 2 in knots
+  Argument 9:  INPUT  - Pointer to double containing look-ahead time in seconds
+  Argument 10: OUTPUT - Pointer to double receiving time of closest approach in seconds
+
+  RETURN: Double containing distance at closest approach in nautical miles
+--------------------------------------------------------------------------*/
+double AVCALCCALL ClosestApproach(const double *lat1, const double *lon1, const double *track1, const double *speed1,
+                                  const double *lat2, const double *lon2, const double *track2, const double *speed2,
+                                  const double *lookahead, double *tcpa)
+{
+    conflict_track a, b;
+
+    conflict_track_init(*lat1, *lon1, *track1, *speed1, &a);
+    conflict_track_init(*lat2, *lon2, *track2, *speed2, &b);
+    return 60 * R2D * conflict_cpa(&a, &b, fmax(*lookahead, 0.0), tcpa);
+}
+
+/*--------------------------------------------------------------------------
+  Conflicts among many aircraft
+
+  Every pair of the n aircraft whose closest approach within the look-ahead
+  time, as found by ClosestApproach(), is less than the separation. The
+  conflicts are written in order of the first aircraft, then the second,
+  the first always being the lower index.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1:  INPUT  - Array of n latitudes  in degrees
+  Argument 2:  INPUT  - Array of n longitudes in degrees
+  Argument 3:  INPUT  - Array of n true tracks in degrees
+  Argument 4:  INPUT  - Array of n groundspeeds in knots
+  Argument 5:  INPUT  - Number of aircraft
+  Argument 6:  INPUT  - Pointer to double containing look-ahead time in seconds
+  Argument 7:  INPUT  - Pointer to double containing separation in nautical miles
+  Argument 8:  OUTPUT - Array receiving the index of the first aircraft of each conflict
+  Argument 9:  OUTPUT - Array receiving the index of the second aircraft of each conflict
+  Argument 10: OUTPUT - Array receiving the time of closest approach of each conflict in seconds
+  Argument 11: OUTPUT - Array receiving the distance at closest approach of each conflict in nautical miles
+  Argument 12: INPUT  - Size of the output arrays, conflicts beyond it are counted but not written
+  Argument 13: INPUT  - Number of threads to use, 1 or less for the calling
+                        thread only
+
+  RETURN: Number of conflicts, -1 if memory could not be allocated
+--------------------------------------------------------------------------*/
+int AVCALCCALL ConflictDetect(const double *lat, const double *lon, const double *track, const double *speed, int n,
+                              const double *lookahead, const double *separation,
+                              int *first, int *second, double *tcpa, double *dcpa, int max_conflicts, int threads)
+{
+    conflict_job job;
+    conflict_track *tracks;
+    conflict_entry *entries;
+    conflict_cell *table;
+    conflict_pair *all;
+    double fastest = 0.0, reach;
+    uint64_t slots = 1;
+    int tasks = (n + CONFLICT_BLOCK - 1) / CONFLICT_BLOCK;
+    int total = 0, k;
+
+    if (n < 2) {
+        return 0;
+    }
+    while (slots < 2 * (uint64_t)n) {
+        slots *= 2;
+    }
+    tracks = (conflict_track *)malloc(sizeof(conflict_track) * (size_t)n + sizeof(conflict_entry) * (size_t)n +
+                                      sizeof(conflict_cell) * (size_t)slots);
+    job.lists = (conflict_list *)calloc((size_t)tasks, sizeof(conflict_list));
+    if (tracks == NULL || job.lists == NULL) {
+        free(tracks);
+        free(job.lists);
+        return -1; //Error condition
+    }
+    entries = (conflict_entry *)(tracks + n);
+    table   = (conflict_cell *)(entries + n);
+    memset(table, 0, sizeof(conflict_cell) * (size_t)slots);
+
+    for (int i = 0; i < n; i++) {
+        conflict_track_init(lat[i], lon[i], track[i], speed[i], &tracks[i]);
+        fastest = fmax(fastest, tracks[i].w);
+    }
+    job.tracks     = tracks;
+    job.entries    = entries;
+    job.table      = table;
+    job.mask       = slots - 1;
+    job.n          = n;
+    job.lookahead  = fmax(*lookahead, 0.0);
+    job.separation = D2R * *separation / 60;
+    job.failed     = 0;
+    reach          = fmin(job.separation + 2 * fastest * job.lookahead, M_PI);
+    job.size       = fmax(2 * sin(0.5 * reach), 2.0 / CONFLICT_CELLS);
+    job.cells      = (int64_t)floor(2.0 / job.size) + 1;
+    job.reach      = 4 * sin(0.5 * reach) * sin(0.5 * reach);
+
+    // Sort into cells, and hash the run of each cell
+    for (int i = 0; i < n; i++) {
+        entries[i].key = conflict_key(conflict_axis(tracks[i].x, &job), conflict_axis(tracks[i].y, &job),
+                                      conflict_axis(tracks[i].z, &job), job.cells);
+        entries[i].aircraft = i;
+    }
+    qsort(entries, (size_t)n, sizeof(conflict_entry), conflict_entry_compare);
+    for (int i = 0; i < n; i = k) {
+        uint64_t slot = (entries[i].key * 0x9E3779B97F4A7C15ULL) & job.mask;
+
+        for (k = i; k < n && entries[k].key == entries[i].key; k++) {
+        }
+        while (table[slot].count > 0) {
+            slot = (slot + 1) & job.mask;
+        }
+        table[slot].key   = entries[i].key;
+        table[slot].start = i;
+        table[slot].count = k - i;
+    }
+
+    parallel_run(conflict_block, &job, tasks, threads);
+
+    // Gather the conflicts of all tasks in order of the aircraft
+    for (int t = 0; t < tasks; t++) {
+        total += job.lists[t].count;
+    }
+    all = (conflict_pair *)malloc(sizeof(conflict_pair) * ((size_t)total + 1));
+    if (job.failed || all == NULL) {
+        total = -1; //Error condition
+    } else {
+        k = 0;
+        for (int t = 0; t < tasks; t++) {
+            memcpy(all + k, job.lists[t].pairs, sizeof(conflict_pair) * (size_t)job.lists[t].count);
+            k += job.lists[t].count;
+        }
+        qsort(all, (size_t)total, sizeof(conflict_pair), conflict_pair_compare);
+        for (int c = 0; c < total && c < max_conflicts; c++) {
+            first[c]  = all[c].first;
+            second[c] = all[c].second;
+            tcpa[c]   = all[c].tcpa;
+            dcpa[c]   = all[c].dcpa;
+        }
+    }
+
+    for (int t = 0; t < tasks; t++) {
+        free(job.lists[t].pairs);
+    }
+    free(all);
+    free(job.lists);
+    free(tracks);
+    return total;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Densification of a leg
+
+  The leg is written as p(a) = u1*cos(a) + w*sin(a), where u1 is the unit
+  vector of point 1, w the unit vector a quarter circle further along the
+  leg and a the angle travelled. u1, w and the length of the leg are found
+  once per leg, leaving a sine, a cosine and two atan2 per point, which
+  run in the polynomial kernels at the tier set by AccuracySelect().
+--------------------------------------------------------------------------*/
+typedef struct {
+    double x1, y1, z1;      // unit vector of point 1
+    double wx, wy, wz;      // unit vector 90 degrees along the leg from point 1
+    double nx, ny, nz;      // pole of the leg, u1 x w, 90 degrees left of it
+    double d;               // length of the leg in radians
+    int    degenerate;      // points coincide or are antipodal, w and n then 0
+} leg_frame;
+
+#define LEG_DEGENERATE 1e-10   // sine of the leg angle below which the leg has no great circle
+
+// Points whose cross product c = u1 x u2 is this short coincide or are antipodal, and the
+// great circle through them is not defined. Tested against a tolerance rather than exact
+// zeros, which rounding, and FMA contraction, do not reliably produce
+AVCALC_INLINE int leg_degenerate(double cx, double cy, double cz)
+{
+    return cx * cx + cy * cy + cz * cz < LEG_DEGENERATE * LEG_DEGENERATE;
+}
+
+static void leg_frame_init(const double *lat1, const double *lon1, const double *lat2, const double *lon2, leg_frame *leg)
+{
+    PreparedPoint p1, p2;
+    double sind, cx, cy, cz, wx, wy, wz, w;
+
+    PreparePoint(lat1, lon1, &p1);
+    PreparePoint(lat2, lon2, &p2);
+    leg->d  = prepared_angle(&p1, &p2, &sind);
+    leg->x1 = p1.x;
+    leg->y1 = p1.y;
+    leg->z1 = p1.z;
+
+    // w = (u1 x u2) x u1, normalised. Zero if the points coincide or are
+    // antipodal, which leaves every point at point 1
+    cx = p1.y * p2.z - p1.z * p2.y;
+    cy = p1.z * p2.x - p1.x * p2.z;
+    cz = p1.x * p2.y - p1.y * p2.x;
+    wx = cy * p1.z - cz * p1.y;
+    wy = cz * p1.x - cx * p1.z;
+    wz = cx * p1.y - cy * p1.x;
+    leg->degenerate = leg_degenerate(cx, cy, cz);
+    w  = sqrt(wx * wx + wy * wy + wz * wz);
+    w  = leg->degenerate ? 0.0 : 1.0 / w;
+    leg->wx = wx * w;
+    leg->wy = wy * w;
+    leg->wz = wz * w;
+    leg->nx = leg->y1 * leg->wz - leg->z1 * leg->wy;
+    leg->ny = leg->z1 * leg->wx - leg->x1 * leg->wz;
+    leg->nz = leg->x1 * leg->wy - leg->y1 * leg->wx;
+}
+
+AVCALC_INLINE void leg_point(const leg_frame *leg, double fraction, double *lat, double *lon, int tier)
+{
+    double a = fraction * leg->d;
+    double s, c, x, y, z;
+
+    math_sincos(a, &s, &c, tier);
+    x = leg->x1 * c + leg->wx * s;
+    y = leg->y1 * c + leg->wy * s;
+    z = leg->z1 * c + leg->wz * s;
+
+    *lat = R2D * math_atan2(z, sqrt(x * x + y * y), tier);
+    *lon = R2D * math_atan2(y, x, tier);
+}
+
+// Points at the given fractions
+AVCALC_INLINE void densify_fractions_body(const leg_frame *frame, const double *fractions, double *lat, double *lon, int n, int tier)
+{
+    leg_frame leg = *frame;     // A local copy cannot alias the outputs
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) leg_point(&leg, fractions[i], &lat[i], &lon[i], TIER);)
+}
+
+// Points at fractions 0, step, 2*step, ... with point 'last' at exactly 1
+AVCALC_INLINE void densify_uniform_body(const leg_frame *frame, double step, int last, double *lat, double *lon, int n, int tier)
+{
+    leg_frame leg = *frame;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) leg_point(&leg, (i == last) ? 1.0 : i * step, &lat[i], &lon[i], TIER);)
+}
+
+BATCH_KERNEL(densify_fractions, (const leg_frame *frame, const double *fractions, double *lat, double *lon, int n, int tier),
+                                (frame, fractions, lat, lon, n, tier))
+BATCH_KERNEL(densify_uniform, (const leg_frame *frame, double step, int last, double *lat, double *lon, int n, int tier),
+                              (frame, step, last, lat, lon, n, tier))
+
+/*--------------------------------------------------------------------------
+  Many intermediate points on one leg
+
+  Same points as IntermediatePoint(), for n fractions of the same leg. As
+  for IntermediatePoint() the leg is undefined if the points are antipodal.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: INPUT  - Array of n fractions of the distance from point 1 (0)
+                       to point 2 (1)
+  Argument 6: OUTPUT - Array of n latitudes  in degrees
+  Argument 7: OUTPUT - Array of n longitudes in degrees
+  Argument 8: INPUT  - Number of points
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL IntermediatePoints(const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *fractions, double *latresult, double *lonresult, int n)
+{
+    leg_frame leg;
+
+    if (n <= 0) {
+        return;
+    }
+    leg_frame_init(lat1, lon1, lat2, lon2, &leg);
+    BATCH_RUN(densify_fractions, (&leg, fractions, latresult, lonresult, n, accuracy_global))
+}
+
+/*--------------------------------------------------------------------------
+  Split a leg into equal steps
+
+  Writes steps+1 points, from point 1 to point 2 inclusive.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: INPUT  - Number of steps, at least 1
+  Argument 6: OUTPUT - Array of steps+1 latitudes  in degrees
+  Argument 7: OUTPUT - Array of steps+1 longitudes in degrees
+
+  RETURN: Number of points written, -1 if steps is less than 1
+--------------------------------------------------------------------------*/
+int AVCALCCALL IntermediatePointsSteps(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int steps, double *latresult, double *lonresult)
+{
+    leg_frame leg;
+
+    if (steps < 1 || steps == INT_MAX) {
+        return -1; //Error condition
+    }
+    leg_frame_init(lat1, lon1, lat2, lon2, &leg);
+    BATCH_RUN(densify_uniform, (&leg, 1.0 / steps, steps, latresult, lonresult, steps + 1, accuracy_global))
+    return steps + 1;
+}
+
+/*--------------------------------------------------------------------------
+  Split a leg into points a fixed distance apart
+
+  Points are placed at 0, spacing, 2*spacing, ... nautical miles from
+  point 1, followed by point 2 itself, so the last step may be shorter.
+  If the arrays are too small only the first max_points points are
+  written; the return value tells how large they need to be.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: INPUT  - Pointer to double containing the spacing in nautical miles
+  Argument 6: OUTPUT - Array of latitudes  in degrees
+  Argument 7: OUTPUT - Array of longitudes in degrees
+  Argument 8: INPUT  - Number of points the arrays can hold
+
+  RETURN: Number of points on the leg, -1 if the spacing is not positive
+          or gives more points than an int can count
+--------------------------------------------------------------------------*/
+int AVCALCCALL IntermediatePointsSpacing(const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *spacing, double *latresult, double *lonresult, int max_points)
+{
+    leg_frame leg;
+    double steps, step;
+    int points;
+
+    if (!(*spacing > 0.0)) {
+        return -1; //Error condition
+    }
+    leg_frame_init(lat1, lon1, lat2, lon2, &leg);
+    steps = ceil(60 * R2D * leg.d / *spacing);
+    if (steps >= INT_MAX) {
+        return -1; //Error condition
+    }
+    points = (int)steps + 1;
+    step   = (points > 1) ? *spacing / (60 * R2D * leg.d) : 0.0;
+
+    if (max_points > 0) {
+        int n = (points < max_points) ? points : max_points;
+        BATCH_RUN(densify_uniform, (&leg, step, points - 1, latresult, lonresult, n, accuracy_global))
+    }
+    return points;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Cross track error and along track distance
+
+  With the leg frame of the previous section, a position p is off the
+  great circle of the leg by the angle asin(n . p), n being the pole of
+  the leg, and abeam the point atan2(w . p, u1 . p) along it. Per position
+  this is the unit vector, three dot products, one asin and one atan2.
+--------------------------------------------------------------------------*/
+AVCALC_INLINE void cross_track_point(const leg_frame *leg, double lat, double lon, double *xtd, double *atd, int tier)
+{
+    double sinLat, cosLat, sinLon, cosLon, x, y, z;
+
+    math_sincos(D2R * lat, &sinLat, &cosLat, tier);
+    math_sincos(D2R * lon, &sinLon, &cosLon, tier);
+    x = cosLat * cosLon;
+    y = cosLat * sinLon;
+    z = sinLat;
+
+    *xtd = -60 * R2D * math_asin(leg->nx * x + leg->ny * y + leg->nz * z, tier);     // positive right of course
+    *atd =  60 * R2D * math_atan2(leg->wx * x + leg->wy * y + leg->wz * z,
+                                  leg->x1 * x + leg->y1 * y + leg->z1 * z, tier);
+}
+
+AVCALC_INLINE void cross_track_body(const leg_frame *frame, const double *lat, const double *lon,
+                                    double *restrict xtd, double *restrict atd, int n, int tier)
+{
+    leg_frame leg = *frame;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) cross_track_point(&leg, lat[i], lon[i], &xtd[i], &atd[i], TIER);)
+}
+
+BATCH_KERNEL(cross_track, (const leg_frame *frame, const double *lat, const double *lon,
+                           double *restrict xtd, double *restrict atd, int n, int tier),
+                          (frame, lat, lon, xtd, atd, n, tier))
+
+/*--------------------------------------------------------------------------
+  Cross track error and along track distance from a leg
+
+  For a position D and the great circle route from A to B, the cross
+  track error is the distance from D to the great circle, positive if D
+  is right of course. The along track distance is the distance from A
+  along the course towards B to the point abeam D, negative if that point
+  is behind A. The leg is undefined if A and B coincide or are antipodal.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point A in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point A in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point B in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point B in degrees
+  Argument 5: INPUT  - Pointer to double containing Latitude  of position D in degrees
+  Argument 6: INPUT  - Pointer to double containing Longitude of position D in degrees
+  Argument 7: OUTPUT - Pointer to double receiving cross track error in nautical miles
+  Argument 8: OUTPUT - Pointer to double receiving along track distance in nautical miles
+
+  RETURN: 0 on success, -1 if the leg is undefined
+--------------------------------------------------------------------------*/
+int AVCALCCALL CrossTrack(const double *latA, const double *lonA, const double *latB, const double *lonB, const double *lat, const double *lon, double *xtd, double *atd)
+{
+    leg_frame leg;
+
+    leg_frame_init(latA, lonA, latB, lonB, &leg);
+    if (leg.degenerate) {
+        return -1; //Error condition
+    }
+    cross_track_point(&leg, *lat, *lon, xtd, atd, AVCALC_ACCURACY_FULL);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Cross track error and along track distance of many positions
+
+  Same results as CrossTrack(), for n positions against the same leg, at
+  the accuracy tier set by AccuracySelect(). The pole of the leg is found
+  once per call. The output arrays must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point A in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point A in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point B in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point B in degrees
+  Argument 5: INPUT  - Array of n latitudes  of the positions in degrees
+  Argument 6: INPUT  - Array of n longitudes of the positions in degrees
+  Argument 7: OUTPUT - Array of n cross track errors in nautical miles
+  Argument 8: OUTPUT - Array of n along track distances in nautical miles
+  Argument 9: INPUT  - Number of positions
+
+  RETURN: 0 on success, -1 if the leg is undefined
+--------------------------------------------------------------------------*/
+int AVCALCCALL CrossTrackBatch(const double *latA, const double *lonA, const double *latB, const double *lonB, const double *lat, const double *lon, double *xtd, double *atd, int n)
+{
+    leg_frame leg;
+
+    leg_frame_init(latA, lonA, latB, lonB, &leg);
+    if (leg.degenerate) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        BATCH_RUN(cross_track, (&leg, lat, lon, xtd, atd, n, accuracy_global))
+    }
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Vertex of a leg
+
+  The great circle through points 1 and 2 has the pole n = u1 x u2. By
+  Clairaut's formula sin(tc)*cos(lat), which is nz/|n|, is the same at
+  every point of it, so the highest latitude it reaches is acos(|nz|/|n|)
+  at the vertex v, the direction of the z axis projected onto its plane:
+
+    v = (-nz*nx, -nz*ny, nx^2 + ny^2)
+
+  The vertex reported is the one in the hemisphere of the middle of the
+  leg, the southern vertex -v for a leg mostly south of the equator. It
+  lies on the leg if v . (n x u1) >= 0 and v . (u2 x n) >= 0, the sines of
+  the angles from point 1 and to point 2.
+--------------------------------------------------------------------------*/
+AVCALC_INLINE void leg_vertex(double lat1, double lon1, double lat2, double lon2,
+                              double *latv, double *lonv, int *reached, int tier)
+{
+    double sinLat1, cosLat1, sinLon1, cosLon1, sinLat2, cosLat2, sinLon2, cosLon2;
+    double x1, y1, z1, x2, y2, z2, nx, ny, nz, h2, north, vx, vy, vz, along, to_go, result;
+
+    math_sincos(D2R * lat1, &sinLat1, &cosLat1, tier);
+    math_sincos(D2R * lon1, &sinLon1, &cosLon1, tier);
+    math_sincos(D2R * lat2, &sinLat2, &cosLat2, tier);
+    math_sincos(D2R * lon2, &sinLon2, &cosLon2, tier);
+    x1 = cosLat1 * cosLon1;
+    y1 = cosLat1 * sinLon1;
+    z1 = sinLat1;
+    x2 = cosLat2 * cosLon2;
+    y2 = cosLat2 * sinLon2;
+    z2 = sinLat2;
+    nx = y1 * z2 - z1 * y2;
+    ny = z1 * x2 - x1 * z2;
+    nz = x1 * y2 - y1 * x2;
+    h2 = nx * nx + ny * ny;
+
+    north = (z1 + z2 < 0.0) ? -1.0 : 1.0;
+    vx = -north * nz * nx;
+    vy = -north * nz * ny;
+    vz =  north * h2;
+    along = vx * (ny * z1 - nz * y1) + vy * (nz * x1 - nx * z1) + vz * (nx * y1 - ny * x1);
+    to_go = vx * (y2 * nz - z2 * ny) + vy * (z2 * nx - x2 * nz) + vz * (x2 * ny - y2 * nx);
+
+    result = (along < to_go) ? along : to_go;         // as a double, to keep the loops vectorizable
+    result = (result >= 0.0) ? 1.0 : 0.0;
+    result = leg_degenerate(nx, ny, nz) ? -1.0 : result;   // Points coincide or are antipodal
+
+    *latv = (result < 0.0) ? NAN : north * R2D * math_atan2(sqrt(h2), fabs(nz), tier);
+    *lonv = (result < 0.0) ? NAN : R2D * math_atan2(vy, vx, tier);
+    *reached = (int)result;
+}
+
+AVCALC_INLINE void vertex_batch_body(const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                                     double *restrict latv, double *restrict lonv, int *restrict reached, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) leg_vertex(lat1[i], lon1[i], lat2[i], lon2[i], &latv[i], &lonv[i], &reached[i], TIER);)
+}
+
+BATCH_KERNEL(vertex_batch, (const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+                            double *restrict latv, double *restrict lonv, int *restrict reached, int n, int tier),
+                           (lat1, lon1, lat2, lon2, latv, lonv, reached, n, tier))
+
+/*--------------------------------------------------------------------------
+  Vertex of a leg
+
+  The highest latitude, in absolute value, of the great circle through
+  points 1 and 2, and the longitude where it is reached. Positive for a
+  leg mostly north of the equator, negative for one mostly south of it.
+  Unless the vertex lies on the leg, the latitude furthest from the
+  equator along the leg is that of one of its end points.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: OUTPUT - Pointer to double receiving Latitude  of the vertex in degrees
+  Argument 6: OUTPUT - Pointer to double receiving Longitude of the vertex in degrees
+
+  RETURN: 1 if the vertex lies on the leg, 0 if not, -1 if the points
+          coincide or are antipodal
+--------------------------------------------------------------------------*/
+int AVCALCCALL LegVertex(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *latv, double *lonv)
+{
+    int reached;
+
+    leg_vertex(*lat1, *lon1, *lat2, *lon2, latv, lonv, &reached, AVCALC_ACCURACY_FULL);
+    return reached;
+}
+
+/*--------------------------------------------------------------------------
+  Vertices of many legs
+
+  Same results as LegVertex(), for n legs given as separate arrays, at the
+  accuracy tier set by AccuracySelect(). The output arrays must not
+  overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 4: INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 5: OUTPUT - Array of n latitudes  of the vertices in degrees
+  Argument 6: OUTPUT - Array of n longitudes of the vertices in degrees
+  Argument 7: OUTPUT - Array of n results as returned by LegVertex()
+  Argument 8: INPUT  - Number of legs
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL LegVertexBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *latv, double *lonv, int *reached, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(vertex_batch, (lat1, lon1, lat2, lon2, latv, lonv, reached, n, accuracy_global))
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Crossing parallels
+
+  With the leg frame of the densification section, the latitude along the
+  great circle is sin(lat) = z1*cos(a) + wz*sin(a) = k*cos(a - a0), where
+  k = sqrt(z1^2 + wz^2) is the sine of the vertex latitude and a0 the
+  angle from point 1 to the northern vertex. Taking v = z1*u1 + wz*w, the
+  vertex scaled by k, and t = n x v, the course there, the parallel with
+  sin(lat) = s is crossed heading north at v*s - t*r and heading south at
+  v*s + t*r, with r = sqrt(k^2 - s^2), both scaled by k^2. No crossing if
+  r is imaginary. A crossing lies on the leg if p . w and p . g are not
+  negative, the sines of the angle from point 1 and of the angle to point
+  2, g being u2 x n = u1*sin(d) - w*cos(d).
+
+  These orbit constants are found once per leg, leaving for each latitude
+  a square root and two atan2, which run in the polynomial kernels at the
+  tier set by AccuracySelect(). The sines of the latitudes are found once
+  per call.
+--------------------------------------------------------------------------*/
+typedef struct {
+    double vx, vy, vz;      // northern vertex, scaled by k
+    double tx, ty, tz;      // n x v, the course at the vertex
+    double wx, wy, wz;      // p . w is the sine of the angle from point 1
+    double gx, gy, gz;      // p . g is the sine of the angle to point 2
+    double k2;              // k^2, -1 if the leg crosses no parallel
+} leg_orbit;
+
+static void leg_orbit_init(const leg_frame *leg, leg_orbit *orbit)
+{
+    double sind = sin(leg->d);
+    double cosd = cos(leg->d);
+    double k2 = leg->z1 * leg->z1 + leg->wz * leg->wz;
+
+    orbit->vx = leg->z1 * leg->x1 + leg->wz * leg->wx;
+    orbit->vy = leg->z1 * leg->y1 + leg->wz * leg->wy;
+    orbit->vz = leg->z1 * leg->z1 + leg->wz * leg->wz;
+    orbit->tx = leg->ny * orbit->vz - leg->nz * orbit->vy;
+    orbit->ty = leg->nz * orbit->vx - leg->nx * orbit->vz;
+    orbit->tz = leg->nx * orbit->vy - leg->ny * orbit->vx;
+    orbit->wx = leg->wx;
+    orbit->wy = leg->wy;
+    orbit->wz = leg->wz;
+    orbit->gx = leg->x1 * sind - leg->wx * cosd;
+    orbit->gy = leg->y1 * sind - leg->wy * cosd;
+    orbit->gz = leg->z1 * sind - leg->wz * cosd;
+
+    // An undefined leg, w = 0, or one along the equator
+    orbit->k2 = (k2 > 0.0) ? k2 : -1.0;
+}
+
+AVCALC_INLINE void orbit_crossing(const leg_orbit *o, double s, double *lon_north, double *lon_south, int tier)
+{
+    double disc = o->k2 - s * s;
+    double r = sqrt((disc > 0.0) ? disc : 0.0);
+    double nx = o->vx * s - o->tx * r;
+    double ny = o->vy * s - o->ty * r;
+    double nz = o->vz * s - o->tz * r;
+    double sx = o->vx * s + o->tx * r;
+    double sy = o->vy * s + o->ty * r;
+    double sz = o->vz * s + o->tz * r;
+    double from, to, north, south;
+
+    from  = nx * o->wx + ny * o->wy + nz * o->wz;
+    to    = nx * o->gx + ny * o->gy + nz * o->gz;
+    north = (from < to) ? from : to;
+    north = (disc < north) ? disc : north;
+    from  = sx * o->wx + sy * o->wy + sz * o->wz;
+    to    = sx * o->gx + sy * o->gy + sz * o->gz;
+    south = (from < to) ? from : to;
+    south = (disc < south) ? disc : south;
+
+    *lon_north = (north >= 0.0) ? R2D * math_atan2(ny, nx, tier) : NAN;
+    *lon_south = (south >= 0.0) ? R2D * math_atan2(sy, sx, tier) : NAN;
+}
+
+AVCALC_INLINE void crossing_body(const leg_orbit *orbit, const double *sinlat,
+                                 double *restrict lon_north, double *restrict lon_south, int n, int tier)
+{
+    leg_orbit o = *orbit;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) orbit_crossing(&o, sinlat[i], &lon_north[i], &lon_south[i], TIER);)
+}
+
+BATCH_KERNEL(crossing, (const leg_orbit *orbit, const double *sinlat,
+                        double *restrict lon_north, double *restrict lon_south, int n, int tier),
+                       (orbit, sinlat, lon_north, lon_south, n, tier))
+
+/*--------------------------------------------------------------------------
+  Crossing of a parallel by a leg
+
+  The longitudes where the leg from point 1 to point 2 crosses the given
+  parallel, heading north and heading south. A great circle crosses each
+  parallel below its vertex latitude twice, but either crossing may lie
+  outside the leg. A leg touching the parallel at its vertex crosses it
+  both ways at the same longitude. A leg along the equator crosses no
+  parallel.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of point 1 in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of point 1 in degrees
+  Argument 3: INPUT  - Pointer to double containing Latitude  of point 2 in degrees
+  Argument 4: INPUT  - Pointer to double containing Longitude of point 2 in degrees
+  Argument 5: INPUT  - Pointer to double containing Latitude of the parallel in degrees
+  Argument 6: OUTPUT - Pointer to double receiving Longitude of the crossing heading north
+                       in degrees, NaN if the leg does not cross that way
+  Argument 7: OUTPUT - Pointer to double receiving Longitude of the crossing heading south
+                       in degrees, NaN if the leg does not cross that way
+
+  RETURN: Number of crossings, 0 to 2, -1 if the points coincide or are
+          antipodal
+--------------------------------------------------------------------------*/
+int AVCALCCALL CrossParallel(const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *lat, double *lon_north, double *lon_south)
+{
+    leg_frame leg;
+    leg_orbit orbit;
+
+    leg_frame_init(lat1, lon1, lat2, lon2, &leg);
+    if (leg.degenerate) {
+        *lon_north = NAN;
+        *lon_south = NAN;
+        return -1; //Error condition
+    }
+    leg_orbit_init(&leg, &orbit);
+    orbit_crossing(&orbit, sin(D2R * *lat), lon_north, lon_south, AVCALC_ACCURACY_FULL);
+    return !isnan(*lon_north) + !isnan(*lon_south);
+}
+
+/*--------------------------------------------------------------------------
+  Crossings of many parallels by many legs
+
+  Same results as CrossParallel(), for each of n legs against each of m
+  parallels, at the accuracy tier set by AccuracySelect(). The results
+  fill n x m matrices stored row by row, element [i*m + j] being the
+  crossing of parallel j by leg i. Legs whose points coincide or are
+  antipodal give NaN throughout their row.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n latitudes  of point 1 in degrees
+  Argument 2: INPUT  - Array of n longitudes of point 1 in degrees
+  Argument 3: INPUT  - Array of n latitudes  of point 2 in degrees
+  Argument 4: INPUT  - Array of n longitudes of point 2 in degrees
+  Argument 5: INPUT  - Number of legs
+  Argument 6: INPUT  - Array of m latitudes of the parallels in degrees
+  Argument 7: INPUT  - Number of parallels
+  Argument 8: OUTPUT - Array of n*m longitudes of the crossings heading north in degrees
+  Argument 9: OUTPUT - Array of n*m longitudes of the crossings heading south in degrees
+
+  RETURN: 0 on success, -1 if memory could not be allocated
+--------------------------------------------------------------------------*/
+int AVCALCCALL CrossParallelBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int n,
+                                  const double *lat, int m, double *lon_north, double *lon_south)
+{
+    double *sinlat;
+
+    if (n <= 0 || m <= 0) {
+        return 0;
+    }
+    sinlat = (double *)malloc(sizeof(double) * (size_t)m);
+    if (sinlat == NULL) {
+        return -1; //Error condition
+    }
+    for (int j = 0; j < m; j++) {
+        sinlat[j] = math_sin(D2R * lat[j], accuracy_global);
+    }
+    for (int i = 0; i < n; i++) {
+        leg_frame leg;
+        leg_orbit orbit;
+
+        leg_frame_init(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &leg);
+        if (leg.degenerate) {
+            for (int j = 0; j < m; j++) {
+                lon_north[(size_t)i * m + j] = NAN;
+                lon_south[(size_t)i * m + j] = NAN;
+            }
+            continue;
+        }
+        leg_orbit_init(&leg, &orbit);
+        BATCH_RUN(crossing, (&orbit, sinlat, lon_north + (size_t)i * m, lon_south + (size_t)i * m, m, accuracy_global))
+    }
+    free(sinlat);
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Routes
+
+  A route keeps, next to its waypoints, the frame of every leg as used
+  for densification (leg i runs from waypoint i to i+1), the initial
+  course of the leg, and the distance along the route to every waypoint
+  as a running sum of the leg lengths. The position at a distance along
+  the route is then a binary search of the running sums for the leg and
+  one point of that leg. Inserting or deleting a waypoint recomputes the
+  one or two legs next to it and the sums from there on.
+
+  The arrays share one block, which is replaced by one twice as large
+  when a waypoint is inserted into a full route.
+--------------------------------------------------------------------------*/
+struct Route {
+    int        n;           // waypoints
+    int        capacity;    // waypoints the block has room for
+    double    *lat, *lon;   // waypoints in degrees
+    double    *along;       // distance from waypoint 0 to each waypoint, nm
+    double    *course;      // initial course of each leg in degrees, 0 to 360
+    leg_frame *leg;         // frame of each leg
+};
+
+// Points the arrays of a route into a block for capacity waypoints
+static void route_layout(Route *route, void *block, int capacity)
+{
+    route->capacity = capacity;
+    route->leg    = (leg_frame *)block;
+    route->lat    = (double *)(route->leg + capacity);
+    route->lon    = route->lat + capacity;
+    route->along  = route->lon + capacity;
+    route->course = route->along + capacity;
+}
+
+static void *route_block(int capacity)
+{
+    return malloc((sizeof(leg_frame) + sizeof(double) * 4) * (size_t)capacity);
+}
+
+// Course in degrees of the great circle with direction {tx,ty,tz} at {x,y,z}
+AVCALC_INLINE double route_course(double x, double y, double z, double tx, double ty, double tz, int tier)
+{
+    double crs = R2D * math_atan2(x * ty - y * tx, tz * (x * x + y * y) - z * (tx * x + ty * y), tier);
+
+    return (crs < 0.0) ? crs + 360.0 : crs;
+}
+
+static void route_leg_init(Route *route, int i)
+{
+    leg_frame *leg = &route->leg[i];
+
+    leg_frame_init(&route->lat[i], &route->lon[i], &route->lat[i + 1], &route->lon[i + 1], leg);
+    route->course[i] = route_course(leg->x1, leg->y1, leg->z1, leg->wx, leg->wy, leg->wz, AVCALC_ACCURACY_FULL);
+}
+
+// Running sums from waypoint start on
+static void route_sums(Route *route, int start)
+{
+    if (start < 1) {
+        route->along[0] = 0.0;
+        start = 1;
+    }
+    for (int i = start; i < route->n; i++) {
+        route->along[i] = route->along[i - 1] + 60 * R2D * route->leg[i - 1].d;
+    }
+}
+
+// Leg holding the distance s along the route, starting the search from a hint
+static int route_find_leg(const Route *route, double s, int hint)
+{
+    int lo = 0, hi = route->n - 2;
+
+    if (hint >= 0 && hint <= hi && route->along[hint] <= s && (hint == hi || s < route->along[hint + 1])) {
+        return hint;
+    }
+    // Last leg starting at or before s
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+
+        if (route->along[mid] <= s) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// Point and course at distance s along the route, on leg i
+static void route_point(const Route *route, int i, double s, double *lat, double *lon, double *course, int tier)
+{
+    const leg_frame *leg = &route->leg[i];
+    double a = (s - route->along[i]) * (1.0 / (60 * R2D));
+    double sa, ca, x, y, z;
+
+    a = (a < leg->d) ? a : leg->d;
+    a = (a > 0.0) ? a : 0.0;
+    math_sincos(a, &sa, &ca, tier);
+    x = leg->x1 * ca + leg->wx * sa;
+    y = leg->y1 * ca + leg->wy * sa;
+    z = leg->z1 * ca + leg->wz * sa;
+
+    *lat = R2D * math_atan2(z, sqrt(x * x + y * y), tier);
+    *lon = R2D * math_atan2(y, x, tier);
+    if (course != NULL) {
+        // Direction of travel, the derivative of the point along the leg
+        *course = route_course(x, y, z, leg->wx * ca - leg->x1 * sa,
+                                        leg->wy * ca - leg->y1 * sa,
+                                        leg->wz * ca - leg->z1 * sa, tier);
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Prepare a route of waypoints
+
+  The legs are great circles. A leg between antipodal waypoints has no
+  defined great circle and every point of it is taken as its first
+  waypoint.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Array of n waypoint latitudes  in degrees
+  Argument 2: INPUT - Array of n waypoint longitudes in degrees
+  Argument 3: INPUT - Number of waypoints, may be 0
+
+  RETURN: The route, to be released with RouteFree(), or NULL if n is
+          negative or memory could not be allocated
+--------------------------------------------------------------------------*/
+Route* AVCALCCALL RouteCreate(const double *lat, const double *lon, int n)
+{
+    Route *route;
+    int capacity = (n > 8) ? n : 8;
+
+    if (n < 0) {
+        return NULL; //Error condition
+    }
+    route = (Route *)malloc(sizeof(Route));
+    if (route == NULL) {
+        return NULL; //Error condition
+    }
+    route_layout(route, route_block(capacity), capacity);
+    if (route->leg == NULL) {
+        free(route);
+        return NULL; //Error condition
+    }
+    route->n = n;
+    for (int i = 0; i < n; i++) {
+        route->lat[i] = lat[i];
+        route->lon[i] = lon[i];
+    }
+    for (int i = 0; i < n - 1; i++) {
+        route_leg_init(route, i);
+    }
+    route_sums(route, 0);
+    return route;
+}
+
+/*--------------------------------------------------------------------------
+  Release a route prepared by RouteCreate()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The route, may be NULL
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RouteFree(Route *route)
+{
+    if (route != NULL) {
+        free(route->leg);
+        free(route);
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Number of waypoints of a route
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The route
+
+  RETURN: Number of waypoints, -1 if the route is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteSize(const Route *route)
+{
+    if (route == NULL) {
+        return -1; //Error condition
+    }
+    return route->n;
+}
+
+/*--------------------------------------------------------------------------
+  Length of a route
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The route
+
+  RETURN: Double containing the length in nautical miles, 0 for fewer than
+          2 waypoints, -1 if the route is NULL
+--------------------------------------------------------------------------*/
+double AVCALCCALL RouteLength(const Route *route)
+{
+    if (route == NULL) {
+        return -1; //Error condition
+    }
+    return (route->n > 0) ? route->along[route->n - 1] : 0.0;
+}
+
+/*--------------------------------------------------------------------------
+  A waypoint of a route and its distance along the route
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The route
+  Argument 2: INPUT  - Index of the waypoint, from 0
+  Argument 3: OUTPUT - Pointer to double receiving Latitude  in degrees
+  Argument 4: OUTPUT - Pointer to double receiving Longitude in degrees
+  Argument 5: OUTPUT - Pointer to double receiving the distance from the
+                       first waypoint in nautical miles
+
+  RETURN: 0 on success, -1 if the route is NULL or there is no such waypoint
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteWaypoint(const Route *route, int k, double *lat, double *lon, double *along)
+{
+    if (route == NULL || k < 0 || k >= route->n) {
+        return -1; //Error condition
+    }
+    *lat   = route->lat[k];
+    *lon   = route->lon[k];
+    *along = route->along[k];
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Length and initial course of a leg of a route
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The route
+  Argument 2: INPUT  - Index of the leg, from waypoint k to k+1
+  Argument 3: OUTPUT - Pointer to double receiving the length in nautical miles
+  Argument 4: OUTPUT - Pointer to double receiving the initial course in
+                       degrees, 0 to 360
+
+  RETURN: 0 on success, -1 if the route is NULL or there is no such leg
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteLeg(const Route *route, int k, double *dist, double *course)
+{
+    if (route == NULL || k < 0 || k >= route->n - 1) {
+        return -1; //Error condition
+    }
+    *dist   = route->along[k + 1] - route->along[k];
+    *course = route->course[k];
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Position at a distance along a route
+
+  At the distance of a waypoint the position is taken on the leg that
+  starts there, the last of them after a repeated waypoint, or on the
+  last leg for the last waypoint.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The route
+  Argument 2: INPUT  - Pointer to double containing the distance from the
+                       first waypoint in nautical miles
+  Argument 3: OUTPUT - Pointer to double receiving Latitude  in degrees
+  Argument 4: OUTPUT - Pointer to double receiving Longitude in degrees
+  Argument 5: OUTPUT - Pointer to double receiving the course at the
+                       position in degrees, 0 to 360. May be NULL
+
+  RETURN: Index of the leg of the position, or -1 if the route is NULL,
+          has fewer than 2 waypoints or the distance is outside 0 to the
+          length of the route
+--------------------------------------------------------------------------*/
+int AVCALCCALL RoutePositionAt(const Route *route, const double *dist, double *lat, double *lon, double *course)
+{
+    int i;
+
+    if (route == NULL || route->n < 2 || !(*dist >= 0.0 && *dist <= route->along[route->n - 1])) {
+        return -1; //Error condition
+    }
+    i = route_find_leg(route, *dist, -1);
+    route_point(route, i, *dist, lat, lon, course, AVCALC_ACCURACY_FULL);
+    return i;
+}
+
+/*--------------------------------------------------------------------------
+  Positions at n distances along a route
+
+  RoutePositionAt() for each distance, at the accuracy set by
+  AccuracySelect(). Each search starts from the leg found for the
+  distance before, so distances in increasing order mostly skip the
+  binary search. Positions of distances outside the route are NaN, with
+  leg -1.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The route
+  Argument 2: INPUT  - Array of n distances from the first waypoint in nautical miles
+  Argument 3: OUTPUT - Array of n latitudes  in degrees
+  Argument 4: OUTPUT - Array of n longitudes in degrees
+  Argument 5: OUTPUT - Array of n courses in degrees, 0 to 360. May be NULL
+  Argument 6: OUTPUT - Array of n leg indices. May be NULL
+  Argument 7: INPUT  - Number of distances
+
+  RETURN: Number of distances outside the route, -1 if the route is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL RoutePositionAtBatch(const Route *route, const double *dist, double *lat, double *lon, double *course, int *leg, int n)
+{
+    int hint = -1, outside = 0;
+
+    if (route == NULL) {
+        return -1; //Error condition
+    }
+    for (int j = 0; j < n; j++) {
+        if (route->n < 2 || !(dist[j] >= 0.0 && dist[j] <= route->along[route->n - 1])) {
+            lat[j] = lon[j] = NAN;
+            if (course != NULL) course[j] = NAN;
+            if (leg != NULL)    leg[j] = -1;
+            outside++;
+            continue;
+        }
+        hint = route_find_leg(route, dist[j], hint);
+        route_point(route, hint, dist[j], &lat[j], &lon[j], (course != NULL) ? &course[j] : NULL, accuracy_global);
+        if (leg != NULL) leg[j] = hint;
+    }
+    return outside;
+}
+
+/*--------------------------------------------------------------------------
+  Insert a waypoint into a route
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The route
+  Argument 2: INPUT - Index the new waypoint gets, 0 to insert before the
+                      first and the number of waypoints to append
+  Argument 3: INPUT - Pointer to double containing Latitude  in degrees
+  Argument 4: INPUT - Pointer to double containing Longitude in degrees
+
+  RETURN: 0 on success, -1 if the route is NULL, the index is out of
+          range or memory could not be allocated
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteInsert(Route *route, int k, const double *lat, const double *lon)
+{
+    int n;
+
+    if (route == NULL || k < 0 || k > route->n) {
+        return -1; //Error condition
+    }
+    n = route->n;
+    if (n == route->capacity) {
+        Route grown = *route;
+
+        if (n > INT_MAX / 2) {
+            return -1; //Error condition
+        }
+        route_layout(&grown, route_block(2 * n), 2 * n);
+        if (grown.leg == NULL) {
+            return -1; //Error condition
+        }
+        memcpy(grown.lat,    route->lat,    sizeof(double) * (size_t)n);
+        memcpy(grown.lon,    route->lon,    sizeof(double) * (size_t)n);
+        memcpy(grown.along,  route->along,  sizeof(double) * (size_t)n);
+        memcpy(grown.course, route->course, sizeof(double) * (size_t)n);
+        memcpy(grown.leg,    route->leg,    sizeof(leg_frame) * (size_t)n);
+        free(route->leg);
+        *route = grown;
+    }
+
+    memmove(&route->lat[k + 1], &route->lat[k], sizeof(double) * (size_t)(n - k));
+    memmove(&route->lon[k + 1], &route->lon[k], sizeof(double) * (size_t)(n - k));
+    route->lat[k] = *lat;
+    route->lon[k] = *lon;
+    route->n = ++n;
+
+    // Legs k.. move up one, then the legs ending and starting at k are new
+    if (k < n - 2) {
+        memmove(&route->leg[k + 1],    &route->leg[k],    sizeof(leg_frame) * (size_t)(n - 2 - k));
+        memmove(&route->course[k + 1], &route->course[k], sizeof(double) * (size_t)(n - 2 - k));
+    }
+    if (k > 0) {
+        route_leg_init(route, k - 1);
+    }
+    if (k < n - 1) {
+        route_leg_init(route, k);
+    }
+    route_sums(route, k);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Delete a waypoint from a route
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The route
+  Argument 2: INPUT - Index of the waypoint
+
+  RETURN: 0 on success, -1 if the route is NULL or there is no such waypoint
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteDelete(Route *route, int k)
+{
+    int n;
+
+    if (route == NULL || k < 0 || k >= route->n) {
+        return -1; //Error condition
+    }
+    n = --route->n;
+    memmove(&route->lat[k], &route->lat[k + 1], sizeof(double) * (size_t)(n - k));
+    memmove(&route->lon[k], &route->lon[k + 1], sizeof(double) * (size_t)(n - k));
+
+    // Legs k+1.. move down one, then the leg joining k-1 and the old k+1 is new
+    if (k < n - 1) {
+        memmove(&route->leg[k],    &route->leg[k + 1],    sizeof(leg_frame) * (size_t)(n - 1 - k));
+        memmove(&route->course[k], &route->course[k + 1], sizeof(double) * (size_t)(n - 1 - k));
+    }
+    if (k > 0 && k < n) {
+        route_leg_init(route, k - 1);
+    }
+    route_sums(route, k);
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Nearest leg of a route
+
+  A route of n waypoints has n-1 legs. Each leg is bounded by a spherical
+  cap around its midpoint with half the leg length as radius, and the caps
+  of neighbouring legs are merged pairwise into a binary tree stored as an
+  array (node 1 is the root, node k has children 2k and 2k+1, the leaves
+  follow the inner nodes). A search starts from the leg matched last time,
+  which usually bounds the answer tightly, and then walks the tree, skipping
+  every cap that is further away than the best leg found so far. The test
+  needs no trigonometry: a position p is further than b from every point
+  of a cap with centre c and radius r if p . c < cos(r + b), the chord
+  form of the angle between p and c exceeding r + b.
+--------------------------------------------------------------------------*/
+typedef struct {
+    double x, y, z;         // unit vector of the centre
+    double r;               // radius in radians
+    double cosr, sinr;
+} route_cap;
+
+struct RouteMatcher {
+    int        legs;
+    int        leaves;      // legs rounded up to a power of two
+    leg_frame *leg;         // legs
+    route_cap *cap;         // 2*leaves caps; caps of missing legs copy the last leg
+};
+
+static double vector_angle(double x1, double y1, double z1, double x2, double y2, double z2)
+{
+    double cx = y1 * z2 - z1 * y2;
+    double cy = z1 * x2 - x1 * z2;
+    double cz = x1 * y2 - y1 * x2;
+
+    return atan2(sqrt(cx * cx + cy * cy + cz * cz), x1 * x2 + y1 * y2 + z1 * z2);
+}
+
+static void route_cap_set(route_cap *cap, double x, double y, double z, double r)
+{
+    double norm = sqrt(x * x + y * y + z * z);
+
+    cap->x = x / norm;
+    cap->y = y / norm;
+    cap->z = z / norm;
+    cap->r = (r < M_PI) ? r : M_PI;
+    cap->cosr = cos(cap->r);
+    cap->sinr = sin(cap->r);
+}
+
+// The cap around the midpoint of a leg, or the start point if the leg is undefined
+static void route_cap_leg(route_cap *cap, const leg_frame *leg)
+{
+    double h = 0.5 * leg->d;
+
+    if (leg->degenerate) {
+        route_cap_set(cap, leg->x1, leg->y1, leg->z1, 0.0);
+    } else {
+        route_cap_set(cap, leg->x1 * cos(h) + leg->wx * sin(h),
+                           leg->y1 * cos(h) + leg->wy * sin(h),
+                           leg->z1 * cos(h) + leg->wz * sin(h), h);
+    }
+}
+
+// A cap holding both a and b, centred between them
+static void route_cap_merge(route_cap *cap, const route_cap *a, const route_cap *b)
+{
+    double x = a->x + b->x;
+    double y = a->y + b->y;
+    double z = a->z + b->z;
+    double ra, rb;
+
+    if (x * x + y * y + z * z < 1e-20) {
+        route_cap_set(cap, a->x, a->y, a->z, M_PI);     // Opposite caps, take the whole sphere
+        return;
+    }
+    route_cap_set(cap, x, y, z, 0.0);
+    ra = vector_angle(cap->x, cap->y, cap->z, a->x, a->y, a->z) + a->r;
+    rb = vector_angle(cap->x, cap->y, cap->z, b->x, b->y, b->z) + b->r;
+    route_cap_set(cap, cap->x, cap->y, cap->z, (ra > rb) ? ra : rb);
+}
+
+/* Angle from position p to the nearest point of a leg, with the cross
+   track error and along track distance of p in radians */
+static double route_leg_distance(const leg_frame *leg, double x, double y, double z, double *xtd, double *atd)
+{
+    double along, to1, to2;
+
+    *xtd = -asin(leg->nx * x + leg->ny * y + leg->nz * z);
+    *atd = along = atan2(leg->wx * x + leg->wy * y + leg->wz * z,
+                         leg->x1 * x + leg->y1 * y + leg->z1 * z);
+
+    if (leg->degenerate) {
+        return vector_angle(leg->x1, leg->y1, leg->z1, x, y, z);
+    }
+    if (along >= 0.0 && along <= leg->d) {
+        return fabs(*xtd);      // Abeam a point of the leg
+    }
+    to1 = vector_angle(leg->x1, leg->y1, leg->z1, x, y, z);
+    to2 = vector_angle(leg->x1 * cos(leg->d) + leg->wx * sin(leg->d),
+                       leg->y1 * cos(leg->d) + leg->wy * sin(leg->d),
+                       leg->z1 * cos(leg->d) + leg->wz * sin(leg->d), x, y, z);
+    return (to1 < to2) ? to1 : to2;
+}
+
+/*--------------------------------------------------------------------------
+  Prepare a route for nearest leg searches
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Array of n waypoint latitudes  in degrees
+  Argument 2: INPUT - Array of n waypoint longitudes in degrees
+  Argument 3: INPUT - Number of waypoints, at least 2
+
+  RETURN: The prepared route, to be released with RouteMatcherFree(), or
+          NULL if there are fewer than 2 waypoints or memory could not be
+          allocated
+--------------------------------------------------------------------------*/
+RouteMatcher* AVCALCCALL RouteMatcherCreate(const double *lat, const double *lon, int n)
+{
+    RouteMatcher *route;
+    int legs = n - 1;
+    int leaves = 1;
+
+    if (n < 2) {
+        return NULL; //Error condition
+    }
+    while (leaves < legs) {
+        leaves *= 2;
+    }
+
+    route = (RouteMatcher *)malloc(sizeof(RouteMatcher));
+    if (route == NULL) {
+        return NULL; //Error condition
+    }
+    route->legs   = legs;
+    route->leaves = leaves;
+    route->leg    = (leg_frame *)malloc(sizeof(leg_frame) * (size_t)legs);
+    route->cap    = (route_cap *)malloc(sizeof(route_cap) * 2 * (size_t)leaves);
+    if (route->leg == NULL || route->cap == NULL) {
+        RouteMatcherFree(route);
+        return NULL; //Error condition
+    }
+
+    for (int i = 0; i < legs; i++) {
+        leg_frame_init(&lat[i], &lon[i], &lat[i + 1], &lon[i + 1], &route->leg[i]);
+        route_cap_leg(&route->cap[leaves + i], &route->leg[i]);
+    }
+    for (int i = legs; i < leaves; i++) {
+        route->cap[leaves + i] = route->cap[leaves + legs - 1];
+    }
+    for (int k = leaves - 1; k >= 1; k--) {
+        route_cap_merge(&route->cap[k], &route->cap[2 * k], &route->cap[2 * k + 1]);
+    }
+    return route;
+}
+
+/*--------------------------------------------------------------------------
+  Release a route prepared by RouteMatcherCreate()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The route, may be NULL
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL RouteMatcherFree(RouteMatcher *route)
+{
+    if (route != NULL) {
+        free(route->leg);
+        free(route->cap);
+        free(route);
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Nearest leg of a route to a position
+
+  The nearest leg is the one with the shortest distance from the position
+  to any point of the leg. Cross track error and along track distance are
+  given against that leg as by CrossTrack(), so the along track distance
+  is outside 0 to the leg length when the nearest point is a waypoint.
+  The hint is the leg matched for the previous position of the same
+  flight; starting from it the search usually touches only the caps on
+  the way down to that leg.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT        - The route
+  Argument 2: INPUT        - Pointer to double containing Latitude  in degrees
+  Argument 3: INPUT        - Pointer to double containing Longitude in degrees
+  Argument 4: INPUT/OUTPUT - Pointer to int with the leg matched last, or
+                             -1 if none. Receives the leg matched now.
+                             May be NULL
+  Argument 5: OUTPUT       - Pointer to double receiving cross track error in nautical miles
+  Argument 6: OUTPUT       - Pointer to double receiving along track distance in nautical miles
+
+  RETURN: Index of the nearest leg, leg i running from waypoint i to i+1,
+          or -1 if the route is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteMatchNearest(const RouteMatcher *route, const double *lat, const double *lon, int *hint, double *xtd, double *atd)
+{
+    double radLat = D2R * *lat;
+    double radLon = D2R * *lon;
+    double x, y, z, best = M_PI + 1.0, cosb = -1.0, sinb = 0.0;
+    double leg_xtd, leg_atd, leg_dist, best_xtd = 0.0, best_atd = 0.0;
+    int stack[64], top = 0, best_leg = -1, start = -1;
+
+    if (route == NULL) {
+        return -1; //Error condition
+    }
+    x = cos(radLat) * cos(radLon);
+    y = cos(radLat) * sin(radLon);
+    z = sin(radLat);
+
+    if (hint != NULL && *hint >= 0 && *hint < route->legs) {
+        start = *hint;
+        best  = route_leg_distance(&route->leg[start], x, y, z, &best_xtd, &best_atd);
+        best_leg = start;
+        cosb  = cos(best);
+        sinb  = sin(best);
+    }
+
+    stack[top++] = 1;
+    while (top > 0) {
+        int k = stack[--top];
+        const route_cap *cap = &route->cap[k];
+
+        // Skip the cap if every point in it is further than the best leg
+        if (cap->r + best < M_PI &&
+            x * cap->x + y * cap->y + z * cap->z < cap->cosr * cosb - cap->sinr * sinb) {
+            continue;
+        }
+        if (k < route->leaves) {
+            const route_cap *left = &route->cap[2 * k], *right = &route->cap[2 * k + 1];
+
+            // Visit the nearer child first, so it tightens the bound for the other
+            if (x * left->x + y * left->y + z * left->z - left->r >= x * right->x + y * right->y + z * right->z - right->r) {
+                stack[top++] = 2 * k + 1;
+                stack[top++] = 2 * k;
+            } else {
+                stack[top++] = 2 * k;
+                stack[top++] = 2 * k + 1;
+            }
+            continue;
+        }
+
+        k -= route->leaves;
+        if (k >= route->legs || k == start) {
+            continue;
+        }
+        leg_dist = route_leg_distance(&route->leg[k], x, y, z, &leg_xtd, &leg_atd);
+        if (leg_dist < best) {
+            best     = leg_dist;
+            best_leg = k;
+            best_xtd = leg_xtd;
+            best_atd = leg_atd;
+            cosb = cos(best);
+            sinb = sin(best);
+        }
+    }
+
+    if (hint != NULL) {
+        *hint = best_leg;
+    }
+    *xtd = 60 * R2D * best_xtd;
+    *atd = 60 * R2D * best_atd;
+    return best_leg;
+}
+
+/*--------------------------------------------------------------------------
+  Nearest legs of a route to a track of positions
+
+  RouteMatchNearest() for n positions of one flight in time order, each
+  position starting from the leg matched for the one before.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT        - The route
+  Argument 2: INPUT        - Array of n latitudes  in degrees
+  Argument 3: INPUT        - Array of n longitudes in degrees
+  Argument 4: INPUT/OUTPUT - Pointer to int with the leg matched last, or
+                             -1 if none. Receives the leg matched for the
+                             last position. May be NULL
+  Argument 5: OUTPUT       - Array of n leg indices
+  Argument 6: OUTPUT       - Array of n cross track errors in nautical miles
+  Argument 7: OUTPUT       - Array of n along track distances in nautical miles
+  Argument 8: INPUT        - Number of positions
+
+  RETURN: 0 on success, -1 if the route is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL RouteMatchBatch(const RouteMatcher *route, const double *lat, const double *lon, int *hint, int *leg, double *xtd, double *atd, int n)
+{
+    int last = (hint != NULL) ? *hint : -1;
+
+    if (route == NULL) {
+        return -1; //Error condition
+    }
+    for (int i = 0; i < n; i++) {
+        leg[i] = RouteMatchNearest(route, &lat[i], &lon[i], &last, &xtd[i], &atd[i]);
+    }
+    if (hint != NULL) {
+        *hint = last;
+    }
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Point in spherical polygon
+
+  The edges of a polygon are great circle arcs between its vertices. A
+  bounding cap holds every edge, and the inside of the polygon is the part
+  of the sphere, cut by the edges, that lies in the cap. This is the
+  smaller part for any polygon within a hemisphere, whatever the order of
+  its vertices, and needs no special care for the antimeridian or a pole.
+
+  A position outside the cap is outside the polygon. Otherwise the arc
+  from a reference point r outside the cap to the position p is tested
+  against every edge ab. With s(v) the side of a vector v relative to a
+  plane, taking 0 as positive, the arcs cross if
+
+    s(p . (a x b)) != s(r . (a x b)),
+    s(a . (r x p)) != s(b . (r x p)) and s(b . (r x p)) == s(r . (a x b))
+
+  and the position is inside if they cross an odd number of times. Taking
+  0 as positive is the same as moving a vertex on the arc slightly off it,
+  so an arc through a vertex crosses exactly one of its two edges. Points
+  go through in blocks: their unit vectors first, then those inside the
+  cap are gathered and every edge is tested against the whole block.
+--------------------------------------------------------------------------*/
+#define POLYGON_BLOCK 256
+
+struct SphericalPolygon {
+    int     edges;
+    double *ax, *ay, *az;       // first vertex of each edge
+    double *bx, *by, *bz;       // second vertex of each edge
+    double *nx, *ny, *nz;       // a x b
+    double *side;               // s(r . (a x b)), as -1 or 1
+    double  cx, cy, cz;         // centre of the bounding cap
+    double  cosr;               // cosine of its radius
+    double  rx, ry, rz;         // the reference point
+};
+
+AVCALC_INLINE void polygon_vectors_body(const double *lat, const double *lon,
+                                        double *restrict x, double *restrict y, double *restrict z, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double sinLat;
+                          double cosLat;
+                          double sinLon;
+                          double cosLon;
+                          math_sincos(D2R * lat[i], &sinLat, &cosLat, TIER);
+                          math_sincos(D2R * lon[i], &sinLon, &cosLon, TIER);
+                          x[i] = cosLat * cosLon;
+                          y[i] = cosLat * sinLon;
+                          z[i] = sinLat;
+                      })
+}
+
+// Flips parity[j] for every edge crossed by the arc from r to p[j]; q[j] = r x p[j]
+AVCALC_INLINE void polygon_edges_body(const SphericalPolygon *poly,
+                                      const double *px, const double *py, const double *pz,
+                                      const double *qx, const double *qy, const double *qz,
+                                      double *restrict parity, int n)
+{
+    for (int e = 0; e < poly->edges; e++) {
+        double ax = poly->ax[e], ay = poly->ay[e], az = poly->az[e];
+        double bx = poly->bx[e], by = poly->by[e], bz = poly->bz[e];
+        double nx = poly->nx[e], ny = poly->ny[e], nz = poly->nz[e];
+        double side = poly->side[e];
+
+        for (int j = 0; j < n; j++) {
+            double sp = ((px[j] * nx + py[j] * ny + pz[j] * nz) >= 0.0) ? 1.0 : -1.0;
+            double sa = ((qx[j] * ax + qy[j] * ay + qz[j] * az) >= 0.0) ? 1.0 : -1.0;
+            double sb = ((qx[j] * bx + qy[j] * by + qz[j] * bz) >= 0.0) ? 1.0 : -1.0;
+            double cross = (sp != side) ? 1.0 : 0.0;
+
+            cross = (sa != sb) ? cross : 0.0;
+            cross = (sb == side) ? cross : 0.0;
+            parity[j] = (cross != 0.0) ? -parity[j] : parity[j];
+        }
+    }
+}
+
+BATCH_KERNEL(polygon_vectors, (const double *lat, const double *lon,
+                               double *restrict x, double *restrict y, double *restrict z, int n, int tier),
+                              (lat, lon, x, y, z, n, tier))
+BATCH_KERNEL(polygon_edges, (const SphericalPolygon *poly,
+                             const double *px, const double *py, const double *pz,
+                             const double *qx, const double *qy, const double *qz,
+                             double *restrict parity, int n),
+                            (poly, px, py, pz, qx, qy, qz, parity, n))
+
+/*--------------------------------------------------------------------------
+  Prepare a polygon for point in polygon tests
+
+  The vertices may be given in either order. A last vertex equal to the
+  first is ignored, as the polygon is closed anyway. The polygon must lie
+  within a hemisphere, and no edge may join antipodal points.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Array of n vertex latitudes  in degrees
+  Argument 2: INPUT - Array of n vertex longitudes in degrees
+  Argument 3: INPUT - Number of vertices, at least 3
+
+  RETURN: The prepared polygon, to be released with SphericalPolygonFree(),
+          or NULL if the polygon is not valid or memory could not be
+          allocated
+--------------------------------------------------------------------------*/
+SphericalPolygon* AVCALCCALL SphericalPolygonCreate(const double *lat, const double *lon, int n)
+{
+    SphericalPolygon *poly;
+    PreparedPoint p;
+    double sx = 0.0, sy = 0.0, sz = 0.0, norm, cosr = 1.0, ex, ey, ez, side;
+
+    if (n >= 2 && lat[n - 1] == lat[0] && lon[n - 1] == lon[0]) {
+        n--;
+    }
+    if (n < 3) {
+        return NULL; //Error condition
+    }
+
+    poly = (SphericalPolygon *)malloc(sizeof(SphericalPolygon));
+    if (poly == NULL) {
+        return NULL; //Error condition
+    }
+    poly->edges = n;
+    poly->ax = (double *)malloc(sizeof(double) * 10 * (size_t)n);
+    if (poly->ax == NULL) {
+        free(poly);
+        return NULL; //Error condition
+    }
+    poly->ay   = poly->ax + n;
+    poly->az   = poly->ay + n;
+    poly->bx   = poly->az + n;
+    poly->by   = poly->bx + n;
+    poly->bz   = poly->by + n;
+    poly->nx   = poly->bz + n;
+    poly->ny   = poly->nx + n;
+    poly->nz   = poly->ny + n;
+    poly->side = poly->nz + n;
+
+    for (int i = 0; i < n; i++) {
+        PreparePoint(&lat[i], &lon[i], &p);
+        poly->ax[i] = p.x;
+        poly->ay[i] = p.y;
+        poly->az[i] = p.z;
+        sx += p.x;
+        sy += p.y;
+        sz += p.z;
+    }
+    for (int i = 0; i < n; i++) {
+        int k = (i + 1) % n;
+
+        poly->bx[i] = poly->ax[k];
+        poly->by[i] = poly->ay[k];
+        poly->bz[i] = poly->az[k];
+        poly->nx[i] = poly->ay[i] * poly->bz[i] - poly->az[i] * poly->by[i];
+        poly->ny[i] = poly->az[i] * poly->bx[i] - poly->ax[i] * poly->bz[i];
+        poly->nz[i] = poly->ax[i] * poly->by[i] - poly->ay[i] * poly->bx[i];
+    }
+
+    // Centre of the cap at the mean of the vertices
+    norm = sqrt(sx * sx + sy * sy + sz * sz);
+    if (norm < 1e-9) {
+        SphericalPolygonFree(poly);
+        return NULL; //Error condition
+    }
+    poly->cx = sx / norm;
+    poly->cy = sy / norm;
+    poly->cz = sz / norm;
+
+    // Radius of the cap: along an edge the cosine of the angle from the
+    // centre is (c.a)*cos(t) + (c.w)*sin(t), least at the ends or where
+    // t = atan2(c.w, c.a) + pi
+    for (int i = 0; i < n; i++) {
+        leg_frame edge;
+        double ca, cw, k, t, least;
+        int next = (i + 1) % n;
+
+        leg_frame_init(&lat[i], &lon[i], &lat[next], &lon[next], &edge);
+        if (edge.degenerate && edge.d > 0.5 * M_PI) {
+            SphericalPolygonFree(poly);     // Antipodal vertices
+            return NULL; //Error condition
+        }
+        ca = poly->cx * edge.x1 + poly->cy * edge.y1 + poly->cz * edge.z1;
+        cw = poly->cx * edge.wx + poly->cy * edge.wy + poly->cz * edge.wz;
+        k  = sqrt(ca * ca + cw * cw);
+        t  = atan2(cw, ca) + M_PI;
+        t  = t - 2 * M_PI * floor(t / (2 * M_PI));
+        least = (t <= edge.d) ? -k : fmin(ca, ca * cos(edge.d) + cw * sin(edge.d));
+        cosr  = fmin(cosr, least);
+    }
+    if (cosr < -0.999) {
+        SphericalPolygonFree(poly);         // Does not fit in a cap clear of the reference point
+        return NULL; //Error condition
+    }
+    poly->cosr = cosr - 1e-9;               // Margin for rounding
+
+    // Reference point 0.02 rad from the point opposite the centre, to keep
+    // the arc to the centre itself defined
+    ex = (fabs(poly->cx) < 0.5) ? 0.0 : -poly->cz;
+    ey = (fabs(poly->cx) < 0.5) ? poly->cz : 0.0;
+    ez = (fabs(poly->cx) < 0.5) ? -poly->cy : poly->cx;
+    norm = sqrt(ex * ex + ey * ey + ez * ez);
+    poly->rx = -poly->cx * cos(0.02) + ex / norm * sin(0.02);
+    poly->ry = -poly->cy * cos(0.02) + ey / norm * sin(0.02);
+    poly->rz = -poly->cz * cos(0.02) + ez / norm * sin(0.02);
+
+    for (int i = 0; i < n; i++) {
+        side = poly->rx * poly->nx[i] + poly->ry * poly->ny[i] + poly->rz * poly->nz[i];
+        poly->side[i] = (side >= 0.0) ? 1.0 : -1.0;
+    }
+    return poly;
+}
+
+/*--------------------------------------------------------------------------
+  Release a polygon prepared by SphericalPolygonCreate()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The polygon, may be NULL
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL SphericalPolygonFree(SphericalPolygon *poly)
+{
+    if (poly != NULL) {
+        free(poly->ax);
+        free(poly);
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Test if positions are inside a polygon
+
+  Positions on an edge may be found on either side.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The polygon
+  Argument 2: INPUT  - Array of n latitudes  in degrees
+  Argument 3: INPUT  - Array of n longitudes in degrees
+  Argument 4: OUTPUT - Array of n results, 1 if inside and 0 if outside
+  Argument 5: INPUT  - Number of positions
+
+  RETURN: Number of positions inside, -1 if the polygon is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL SphericalPolygonContainsBatch(const SphericalPolygon *poly, const double *lat, const double *lon, int *inside, int n)
+{
+    double x[POLYGON_BLOCK], y[POLYGON_BLOCK], z[POLYGON_BLOCK];
+    double px[POLYGON_BLOCK], py[POLYGON_BLOCK], pz[POLYGON_BLOCK];
+    double qx[POLYGON_BLOCK], qy[POLYGON_BLOCK], qz[POLYGON_BLOCK];
+    double parity[POLYGON_BLOCK];
+    int index[POLYGON_BLOCK];
+    int count = 0;
+
+    if (poly == NULL) {
+        return -1; //Error condition
+    }
+    for (int start = 0; start < n; start += POLYGON_BLOCK) {
+        int m = (n - start < POLYGON_BLOCK) ? n - start : POLYGON_BLOCK;
+        int k = 0;
+
+        BATCH_RUN(polygon_vectors, (&lat[start], &lon[start], x, y, z, m, accuracy_global))
+
+        // Gather the positions inside the cap
+        for (int i = 0; i < m; i++) {
+            inside[start + i] = 0;
+            if (x[i] * poly->cx + y[i] * poly->cy + z[i] * poly->cz >= poly->cosr) {
+                index[k] = start + i;
+                px[k] = x[i];
+                py[k] = y[i];
+                pz[k] = z[i];
+                qx[k] = poly->ry * z[i] - poly->rz * y[i];
+                qy[k] = poly->rz * x[i] - poly->rx * z[i];
+                qz[k] = poly->rx * y[i] - poly->ry * x[i];
+                parity[k] = 1.0;
+                k++;
+            }
+        }
+        if (k == 0) {
+            continue;
+        }
+
+        BATCH_RUN(polygon_edges, (poly, px, py, pz, qx, qy, qz, parity, k))
+        for (int j = 0; j < k; j++) {
+            if (parity[j] < 0.0) {
+                inside[index[j]] = 1;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/*--------------------------------------------------------------------------
+  Test if a position is inside a polygon
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The polygon
+  Argument 2: INPUT - Pointer to double containing Latitude  in degrees
+  Argument 3: INPUT - Pointer to double containing Longitude in degrees
+
+  RETURN: 1 if inside, 0 if outside, -1 if the polygon is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL SphericalPolygonContains(const SphericalPolygon *poly, const double *lat, const double *lon)
+{
+    int inside;
+
+    if (SphericalPolygonContainsBatch(poly, lat, lon, &inside, 1) < 0) {
+        return -1; //Error condition
+    }
+    return inside;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Nearest points
+
+  A point index is a k-d tree over the unit vectors of its points, so
+  the poles and the antimeridian are no different from any other place.
+  The points are reordered so that every node is a range [lo, hi) of
+  them: a range of more than INDEX_LEAF points is split at its middle
+  position mid by the coordinate (x, y or z, the widest in the range)
+  stored in dim[mid], with the points of [lo, mid) not above and those of
+  [mid, hi) not below the value split[mid]. The chord between two
+  unit vectors grows with their angle, and is at least the difference of
+  one coordinate, so a range on the far side of a split is skipped if
+  that difference alone exceeds the chord to the k-th point found so far,
+  or to the search radius.
+
+  The points found are kept in a max heap in the caller's output arrays,
+  with the squared chord as key and the point index to break ties. The
+  distances returned are then taken from Distance(), the same formula a
+  scan over all points would use.
+
+  All arrays of an index are in one block, which is written to a file
+  as is by PointIndexSave() together with a header. The file is meant to
+  be read back on the same platform.
+--------------------------------------------------------------------------*/
+#define INDEX_LEAF     8
+#define INDEX_VERSION  1
+#define INDEX_BLOCK    64
+
+static const char index_magic[8] = {'A', 'V', 'C', 'I', 'N', 'D', 'E', 'X'};
+
+struct PointIndex {
+    int            n;
+    double        *x, *y, *z;   // unit vectors, in tree order
+    double        *lat, *lon;   // degrees, in tree order
+    double        *split;       // coordinate value of ranges split at this position
+    int           *index;       // position of each point in the arrays given to PointIndexCreate()
+    unsigned char *dim;         // coordinate split on, for ranges split at this point
+};
+
+typedef struct {
+    uint32_t version;
+    int32_t  n;
+} index_header;
+
+typedef struct {
+    const PointIndex *index;
+    const double     *lat, *lon;
+    int               n, k;
+    double            radius;   // negative for nearest queries
+    int              *found, *count;
+    double           *dist;
+} index_job;
+
+static size_t index_size(int n)
+{
+    return (sizeof(double) * 6 + sizeof(int) + 1) * (size_t)n;
+}
+
+// Points the arrays of an index into its block
+static void index_layout(PointIndex *index, void *block, int n)
+{
+    index->n     = n;
+    index->x     = (double *)block;
+    index->y     = index->x + n;
+    index->z     = index->y + n;
+    index->lat   = index->z + n;
+    index->lon   = index->lat + n;
+    index->split = index->lon + n;
+    index->index = (int *)(index->split + n);
+    index->dim   = (unsigned char *)(index->index + n);
+}
+
+// Reorders order[lo..hi) so the point at nth has the coordinate it would have sorted
+static void index_select(int *order, const double *v, int dim, int lo, int hi, int nth)
+{
+    while (hi - lo > 1) {
+        double pivot = v[3 * order[lo + (hi - lo) / 2] + dim];
+        int i = lo, j = hi - 1;
+
+        while (i <= j) {
+            while (v[3 * order[i] + dim] < pivot) i++;
+            while (v[3 * order[j] + dim] > pivot) j--;
+            if (i <= j) {
+                int t = order[i];
+                order[i++] = order[j];
+                order[j--] = t;
+            }
+        }
+        if (nth <= j) {
+            hi = j + 1;
+        } else if (nth >= i) {
+            lo = i;
+        } else {
+            return;     // Between the two parts, equal to the pivot
+        }
+    }
+}
+
+static void index_build(PointIndex *index, int *order, const double *v, int lo, int hi)
+{
+    double low[3] = {2.0, 2.0, 2.0}, high[3] = {-2.0, -2.0, -2.0};
+    int mid = lo + (hi - lo) / 2, dim = 0;
+
+    if (hi - lo <= INDEX_LEAF) {
+        return;
+    }
+    for (int i = lo; i < hi; i++) {
+        for (int d = 0; d < 3; d++) {
+            low[d]  = (v[3 * order[i] + d] < low[d])  ? v[3 * order[i] + d] : low[d];
+            high[d] = (v[3 * order[i] + d] > high[d]) ? v[3 * order[i] + d] : high[d];
+        }
+    }
+    for (int d = 1; d < 3; d++) {
+        dim = (high[d] - low[d] > high[dim] - low[dim]) ? d : dim;
+    }
+    index_select(order, v, dim, lo, hi, mid);
+    index->dim[mid]   = (unsigned char)dim;
+    index->split[mid] = v[3 * order[mid] + dim];
+    index_build(index, order, v, lo, mid);
+    index_build(index, order, v, mid, hi);
+}
+
+// True if heap entry a is further than b
+static int index_further(double da, int ia, double db, int ib)
+{
+    return da > db || (da == db && ia > ib);
+}
+
+static void index_sift_down(double *d2, int *found, int m, int i)
+{
+    for (;;) {
+        int c = 2 * i + 1;
+
+        if (c >= m) {
+            return;
+        }
+        if (c + 1 < m && index_further(d2[c + 1], found[c + 1], d2[c], found[c])) {
+            c++;
+        }
+        if (!index_further(d2[c], found[c], d2[i], found[i])) {
+            return;
+        }
+        double td = d2[i]; d2[i] = d2[c]; d2[c] = td;
+        int ti = found[i]; found[i] = found[c]; found[c] = ti;
+        i = c;
+    }
+}
+
+static void index_push(double *d2, int *found, int *m, int k, double d, int point)
+{
+    int i = *m;
+
+    if (i == k) {
+        if (!index_further(d2[0], found[0], d, point)) {
+            return;
+        }
+        d2[0] = d;
+        found[0] = point;
+        index_sift_down(d2, found, k, 0);
+        return;
+    }
+    d2[i] = d;
+    found[i] = point;
+    (*m)++;
+    while (i > 0 && index_further(d2[i], found[i], d2[(i - 1) / 2], found[(i - 1) / 2])) {
+        int p = (i - 1) / 2;
+        double td = d2[i]; d2[i] = d2[p]; d2[p] = td;
+        int ti = found[i]; found[i] = found[p]; found[p] = ti;
+        i = p;
+    }
+}
+
+/* Searches the index for the k points nearest to the position, or if
+   radius is not negative the k nearest of those within radius (nm), of
+   which *count receives the number. found[] and dist[] receive the
+   points nearest first. Returns the number of points written. */
+static int index_search(const PointIndex *index, double lat, double lon, int k, double radius,
+                        int *found, double *dist, int *count)
+{
+    struct { int lo, hi; double bound; } stack[128];
+    double x, y, z, q[3], limit = 8.0;
+    int top = 0, m = 0, within = 0;
+
+    if (k < 0) {
+        k = 0;
+    }
+    unit_vector_poly(lat, lon, &x, &y, &z);
+    q[0] = x;
+    q[1] = y;
+    q[2] = z;
+    if (radius >= 0.0) {
+        double chord = 2.0 * sin(0.5 * fmin(radius / (60 * R2D), M_PI));
+
+        limit = chord * chord * (1.0 + 1e-9) + 1e-24;     // Margin for rounding, Distance() decides
+    }
+
+    stack[top].lo = 0;
+    stack[top].hi = index->n;
+    stack[top].bound = 0.0;
+    top++;
+    while (top > 0) {
+        int lo, hi;
+        double bound;
+
+        top--;
+        lo = stack[top].lo;
+        hi = stack[top].hi;
+        bound = stack[top].bound;
+
+        // Skip the range if it is beyond the radius, or for nearest
+        // points beyond the k-th point found so far
+        if (bound > limit || (radius < 0.0 && m == k && (k == 0 || bound > dist[0]))) {
+            continue;
+        }
+        if (hi - lo > INDEX_LEAF) {
+            int mid = lo + (hi - lo) / 2, dim = index->dim[mid];
+            double diff = q[dim] - index->split[mid];
+            double far = (diff * diff > bound) ? diff * diff : bound;
+
+            // Push the far side first, so the near side is searched first
+            stack[top].lo = (diff < 0.0) ? mid : lo;
+            stack[top].hi = (diff < 0.0) ? hi : mid;
+            stack[top].bound = far;
+            top++;
+            stack[top].lo = (diff < 0.0) ? lo : mid;
+            stack[top].hi = (diff < 0.0) ? mid : hi;
+            stack[top].bound = bound;
+            top++;
+            continue;
+        }
+        for (int i = lo; i < hi; i++) {
+            double dx = x - index->x[i];
+            double dy = y - index->y[i];
+            double dz = z - index->z[i];
+            double d = dx * dx + dy * dy + dz * dz;
+
+            if (d > limit) {
+                continue;
+            }
+            if (radius >= 0.0 && Distance(&lat, &lon, &index->lat[i], &index->lon[i]) > radius) {
+                continue;
+            }
+            within++;
+            if (k > 0) {
+                index_push(dist, found, &m, k, d, i);
+            }
+        }
+    }
+
+    // Sort the heap, nearest first, and replace chords by distances
+    for (int i = m - 1; i > 0; i--) {
+        double td = dist[0]; dist[0] = dist[i]; dist[i] = td;
+        int ti = found[0]; found[0] = found[i]; found[i] = ti;
+        index_sift_down(dist, found, i, 0);
+    }
+    for (int i = 0; i < m; i++) {
+        dist[i]  = Distance(&lat, &lon, &index->lat[found[i]], &index->lon[found[i]]);
+        found[i] = index->index[found[i]];
+    }
+    if (count != NULL) {
+        *count = within;
+    }
+    return m;
+}
+
+static void index_queries(void *context, int task)
+{
+    index_job *job = (index_job *)context;
+    int start = task * INDEX_BLOCK;
+    int end = (start + INDEX_BLOCK < job->n) ? start + INDEX_BLOCK : job->n;
+
+    for (int i = start; i < end; i++) {
+        int *found = job->found + (size_t)i * job->k;
+        double *dist = job->dist + (size_t)i * job->k;
+        int m = index_search(job->index, job->lat[i], job->lon[i], job->k, job->radius,
+                             found, dist, (job->count != NULL) ? &job->count[i] : NULL);
+
+        // Rows not filled when there are fewer points than asked for
+        for (int j = m; j < job->k; j++) {
+            found[j] = -1;
+            dist[j]  = -1.0;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Build an index of points for nearest point searches
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Array of n latitudes  in degrees
+  Argument 2: INPUT - Array of n longitudes in degrees
+  Argument 3: INPUT - Number of points, at least 1
+
+  RETURN: The index, to be released with PointIndexFree(), or NULL if
+          there are no points or memory could not be allocated
+--------------------------------------------------------------------------*/
+PointIndex* AVCALCCALL PointIndexCreate(const double *lat, const double *lon, int n)
+{
+    PointIndex *index;
+    double *v;
+    int *order;
+
+    if (n < 1) {
+        return NULL; //Error condition
+    }
+    index = (PointIndex *)malloc(sizeof(PointIndex));
+    v     = (double *)malloc(sizeof(double) * 3 * (size_t)n + sizeof(int) * (size_t)n);
+    if (index == NULL || v == NULL) {
+        free(index);
+        free(v);
+        return NULL; //Error condition
+    }
+    index_layout(index, malloc(index_size(n)), n);
+    if (index->x == NULL) {
+        free(index);
+        free(v);
+        return NULL; //Error condition
+    }
+
+    order = (int *)(v + 3 * (size_t)n);
+    for (int i = 0; i < n; i++) {
+        unit_vector_poly(lat[i], lon[i], &v[3 * i], &v[3 * i + 1], &v[3 * i + 2]);
+        order[i] = i;
+    }
+    memset(index->dim, 0, (size_t)n);
+    memset(index->split, 0, sizeof(double) * (size_t)n);
+    index_build(index, order, v, 0, n);
+
+    for (int i = 0; i < n; i++) {
+        index->x[i]     = v[3 * order[i]];
+        index->y[i]     = v[3 * order[i] + 1];
+        index->z[i]     = v[3 * order[i] + 2];
+        index->lat[i]   = lat[order[i]];
+        index->lon[i]   = lon[order[i]];
+        index->index[i] = order[i];
+    }
+    free(v);
+    return index;
+}
+
+/*--------------------------------------------------------------------------
+  Release an index built by PointIndexCreate() or read by PointIndexLoad()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The index, may be NULL
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL PointIndexFree(PointIndex *index)
+{
+    if (index != NULL) {
+        free(index->x);
+        free(index);
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Write an index to a file
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The index
+  Argument 2: INPUT - Path of the file, replaced if it exists
+
+  RETURN: 0 on success, -1 if the index is NULL or the file could not be
+          written
+--------------------------------------------------------------------------*/
+int AVCALCCALL PointIndexSave(const PointIndex *index, const char *path)
+{
+    index_header header;
+    FILE *file;
+    int ok;
+
+    if (index == NULL) {
+        return -1; //Error condition
+    }
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1; //Error condition
+    }
+    header.version = INDEX_VERSION;
+    header.n = index->n;
+    ok = fwrite(index_magic, sizeof(index_magic), 1, file) == 1 &&
+         fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(index->x, index_size(index->n), 1, file) == 1;
+    if (fclose(file) != 0 || !ok) {
+        return -1; //Error condition
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Read an index written by PointIndexSave()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Path of the file
+
+  RETURN: The index, to be released with PointIndexFree(), or NULL if the
+          file could not be read or is not a valid index
+--------------------------------------------------------------------------*/
+PointIndex* AVCALCCALL PointIndexLoad(const char *path)
+{
+    char magic[sizeof(index_magic)];
+    index_header header;
+    PointIndex *index;
+    FILE *file = fopen(path, "rb");
+    int ok;
+
+    if (file == NULL) {
+        return NULL; //Error condition
+    }
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, index_magic, sizeof(magic)) != 0 ||
+        fread(&header, sizeof(header), 1, file) != 1 || header.version != INDEX_VERSION || header.n < 1) {
+        fclose(file);
+        return NULL; //Error condition
+    }
+    index = (PointIndex *)malloc(sizeof(PointIndex));
+    if (index == NULL) {
+        fclose(file);
+        return NULL; //Error condition
+    }
+    index_layout(index, malloc(index_size(header.n)), header.n);
+    ok = index->x != NULL && fread(index->x, index_size(index->n), 1, file) == 1 && fgetc(file) == EOF;
+    fclose(file);
+
+    // A damaged file must not lead the searches out of the arrays
+    for (int i = 0; ok && i < index->n; i++) {
+        ok = index->dim[i] < 3 && index->index[i] >= 0 && index->index[i] < index->n;
+    }
+    if (!ok) {
+        PointIndexFree(index);
+        return NULL; //Error condition
+    }
+    return index;
+}
+
+/*--------------------------------------------------------------------------
+  Number of points in an index
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The index
+
+  RETURN: Number of points, -1 if the index is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL PointIndexSize(const PointIndex *index)
+{
+    if (index == NULL) {
+        return -1; //Error condition
+    }
+    return index->n;
+}
+
+/*--------------------------------------------------------------------------
+  Nearest points to a position
+
+  Points at the same distance are taken in the order they were given to
+  PointIndexCreate().
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The index
+  Argument 2: INPUT  - Pointer to double containing Latitude  in degrees
+  Argument 3: INPUT  - Pointer to double containing Longitude in degrees
+  Argument 4: INPUT  - Number of points k to find
+  Argument 5: OUTPUT - Array of k point indices, nearest first, as
+                       positions in the arrays given to PointIndexCreate()
+  Argument 6: OUTPUT - Array of k distances in nautical miles
+
+  RETURN: Number of points found, k or the size of the index if smaller,
+          -1 if the index is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL PointIndexNearest(const PointIndex *index, const double *lat, const double *lon, int k, int *found, double *dist)
+{
+    if (index == NULL) {
+        return -1; //Error condition
+    }
+    return index_search(index, *lat, *lon, k, -1.0, found, dist, NULL);
+}
+
+/*--------------------------------------------------------------------------
+  Points within a distance of a position
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The index
+  Argument 2: INPUT  - Pointer to double containing Latitude  in degrees
+  Argument 3: INPUT  - Pointer to double containing Longitude in degrees
+  Argument 4: INPUT  - Pointer to double containing the radius in nautical miles
+  Argument 5: OUTPUT - Array of max_found point indices, nearest first
+  Argument 6: OUTPUT - Array of max_found distances in nautical miles
+  Argument 7: INPUT  - Size of the output arrays
+
+  RETURN: Number of points within the radius, of which the nearest
+          max_found are written, -1 if the index is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL PointIndexWithin(const PointIndex *index, const double *lat, const double *lon, const double *radius,
+                                int *found, double *dist, int max_found)
+{
+    int count;
+
+    if (index == NULL) {
+        return -1; //Error condition
+    }
+    index_search(index, *lat, *lon, max_found, (*radius > 0.0) ? *radius : 0.0, found, dist, &count);
+    return count;
+}
+
+/*--------------------------------------------------------------------------
+  Nearest points to n positions
+
+  PointIndexNearest() for each position. Row i of the outputs holds the
+  k points of position i; when the index has fewer than k points the
+  rest of the row is set to index -1 and distance -1.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The index
+  Argument 2: INPUT  - Array of n latitudes  in degrees
+  Argument 3: INPUT  - Array of n longitudes in degrees
+  Argument 4: INPUT  - Number of positions
+  Argument 5: INPUT  - Number of points k to find per position
+  Argument 6: OUTPUT - Array of n*k point indices
+  Argument 7: OUTPUT - Array of n*k distances in nautical miles
+  Argument 8: INPUT  - Number of threads to use, 1 for the calling thread only
+
+  RETURN: 0 on success, -1 if the index is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL PointIndexNearestBatch(const PointIndex *index, const double *lat, const double *lon, int n, int k,
+                                      int *found, double *dist, int threads)
+{
+    index_job job = {index, lat, lon, n, k, -1.0, found, NULL, dist};
+
+    if (index == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0 && k > 0) {
+        parallel_run(index_queries, &job, (n + INDEX_BLOCK - 1) / INDEX_BLOCK, threads);
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Points within a distance of n positions
+
+  PointIndexWithin() for each position. Row i of the outputs holds up to
+  max_found points of position i, nearest first, and the rest of the row
+  is set to index -1 and distance -1.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The index
+  Argument 2: INPUT  - Array of n latitudes  in degrees
+  Argument 3: INPUT  - Array of n longitudes in degrees
+  Argument 4: INPUT  - Number of positions
+  Argument 5: INPUT  - Pointer to double containing the radius in nautical miles
+  Argument 6: OUTPUT - Array of n counts of points within the radius
+  Argument 7: OUTPUT - Array of n*max_found point indices
+  Argument 8: OUTPUT - Array of n*max_found distances in nautical miles
+  Argument 9: INPUT  - Number of points max_found kept per position
+  Argument 10: INPUT - Number of threads to use, 1 for the calling thread only
+
+  RETURN: 0 on success, -1 if the index is NULL
+--------------------------------------------------------------------------*/
+int AVCALCCALL PointIndexWithinBatch(const PointIndex *index, const double *lat, const double *lon, int n, const double *radius,
+                                     int *count, int *found, double *dist, int max_found, int threads)
+{
+    index_job job = {index, lat, lon, n, (max_found > 0) ? max_found : 0, (*radius > 0.0) ? *radius : 0.0, found, count, dist};
+
+    if (index == NULL) {
+        return -1; //Error condition
+    }
+    if (n > 0) {
+        parallel_run(index_queries, &job, (n + INDEX_BLOCK - 1) / INDEX_BLOCK, threads);
+    }
+    return 0;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Local flat earth frame
+
+  Near a reference point (lat0,lon0) the earth may be taken as flat, with
+  North and East axes at the reference point:
+
+    north = R1*dlat
+    east  = R2*cos(lat0)*dlon
+
+  R1 and R2 being the meridional radius of curvature and the radius of
+  curvature in the prime vertical at lat0,
+
+    R1 = a*(1-e^2)/(1-e^2*sin(lat0)^2)^(3/2)
+    R2 = a/sqrt(1-e^2*sin(lat0)^2)
+
+  with R1 = R2 = R on the sphere used elsewhere in this library. Both
+  scale factors, per degree, are found once per frame, so converting a
+  point either way and its distance from the reference point are a few
+  multiplications. The bearing is one atan2, which runs in the polynomial
+  kernels at the tier set by AccuracySelect().
+
+  The formulary puts the fractional error at (d/R)^2. That holds on the
+  equator; elsewhere the meridians converge within the frame and add a
+  first order term, so the error of the distance (as a fraction) and of
+  the bearing (in radians) of a point d from the reference point stays
+  below (d/R)^2 + |tan(lat0)|*d/R, R being R1. At 50 nm from a reference
+  point at 45 degrees this is about 1.5 %.
+--------------------------------------------------------------------------*/
+AVCALC_INLINE double local_wrap(double dlon)
+{
+    dlon = dlon + 180.0;
+    return dlon - 360.0 * floor(dlon * (1.0 / 360.0)) - 180.0;
+}
+
+AVCALC_INLINE void local_to_ne_body(const LocalFrame *frame, const double *lat, const double *lon,
+                                    double *restrict north, double *restrict east, int n)
+{
+    LocalFrame f = *frame;
+
+    for (int i = 0; i < n; i++) {
+        north[i] = (lat[i] - f.lat0) * f.north_per_deg;
+        east[i]  = local_wrap(lon[i] - f.lon0) * f.east_per_deg;
+    }
+}
+
+AVCALC_INLINE void local_from_ne_body(const LocalFrame *frame, const double *north, const double *east,
+                                      double *restrict lat, double *restrict lon, int n)
+{
+    LocalFrame f = *frame;
+
+    for (int i = 0; i < n; i++) {
+        lat[i] = f.lat0 + north[i] * f.deg_per_north;
+        lon[i] = local_wrap(f.lon0 + east[i] * f.deg_per_east);
+    }
+}
+
+AVCALC_INLINE void local_range_body(const LocalFrame *frame, const double *lat, const double *lon,
+                                    double *restrict dist, double *restrict bearing, int n, int tier)
+{
+    LocalFrame f = *frame;
+
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) {
+                          double north = (lat[i] - f.lat0) * f.north_per_deg;
+                          double east  = local_wrap(lon[i] - f.lon0) * f.east_per_deg;
+                          dist[i]    = sqrt(north * north + east * east);
+                          bearing[i] = R2D * math_atan2(east, north, TIER);
+                      })
+}
+
+BATCH_KERNEL(local_to_ne, (const LocalFrame *frame, const double *lat, const double *lon,
+                           double *restrict north, double *restrict east, int n),
+                          (frame, lat, lon, north, east, n))
+BATCH_KERNEL(local_from_ne, (const LocalFrame *frame, const double *north, const double *east,
+                             double *restrict lat, double *restrict lon, int n),
+                            (frame, north, east, lat, lon, n))
+BATCH_KERNEL(local_range, (const LocalFrame *frame, const double *lat, const double *lon,
+                           double *restrict dist, double *restrict bearing, int n, int tier),
+                          (frame, lat, lon, dist, bearing, n, tier))
+
+/*--------------------------------------------------------------------------
+  Set up a local flat earth frame
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing Latitude  of the reference point in degrees
+  Argument 2: INPUT  - Pointer to double containing Longitude of the reference point in degrees
+  Argument 3: INPUT  - AVCALC_EARTH_SPHERE for the sphere of 60 nm per degree
+                       used elsewhere in this library, or an ellipsoid such
+                       as AVCALC_EARTH_WGS84
+  Argument 4: OUTPUT - Pointer to the frame
+
+  RETURN: 0 on success, -1 if the model is unknown or the reference point
+          is a pole
+--------------------------------------------------------------------------*/
+int AVCALCCALL LocalFrameInit(const double *lat0, const double *lon0, int model, LocalFrame *frame)
+{
+    double sinLat = sin(D2R * *lat0);
+    double cosLat = cos(D2R * *lat0);
+    const earth_model *e = earth_model_get(model);
+    double r1, r2;
+
+    if (model == AVCALC_EARTH_SPHERE) {
+        r1 = r2 = 60 * R2D;
+    } else if (e != NULL) {
+        double w = 1 - e->e2 * sinLat * sinLat;
+
+        r2 = e->a / sqrt(w);
+        r1 = r2 * (1 - e->e2) / w;
+    } else {
+        return -1; //Error condition
+    }
+    if (cosLat < EPS) {
+        return -1; //Error condition
+    }
+
+    frame->lat0          = *lat0;
+    frame->lon0          = local_wrap(*lon0);
+    frame->north_per_deg = D2R * r1;
+    frame->east_per_deg  = D2R * r2 * cosLat;
+    frame->deg_per_north = 1 / frame->north_per_deg;
+    frame->deg_per_east  = 1 / frame->east_per_deg;
+    frame->radius        = r1;
+    frame->tanlat        = fabs(sinLat / cosLat);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Error bound of a local flat earth frame
+
+  The fractional error of distances, and the error of bearings in
+  radians, of points up to the given distance from the reference point.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to the frame
+  Argument 2: INPUT - Pointer to double containing distance in nautical miles
+
+  RETURN: Double containing (d/R)^2 + |tan(lat0)|*d/R
+--------------------------------------------------------------------------*/
+double AVCALCCALL LocalFrameErrorBound(const LocalFrame *frame, const double *dist)
+{
+    double d = *dist / frame->radius;
+
+    return d * d + frame->tanlat * d;
+}
+
+/*--------------------------------------------------------------------------
+  Positions to north and east in a local frame
+
+  The output arrays must not overlap the input arrays. Longitudes are
+  taken the shorter way round from the reference point.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to the frame
+  Argument 2: INPUT  - Array of n latitudes  in degrees
+  Argument 3: INPUT  - Array of n longitudes in degrees
+  Argument 4: OUTPUT - Array of n distances north of the reference point in nautical miles
+  Argument 5: OUTPUT - Array of n distances east  of the reference point in nautical miles
+  Argument 6: INPUT  - Number of positions
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL LocalFrameToNE(const LocalFrame *frame, const double *lat, const double *lon, double *north, double *east, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(local_to_ne, (frame, lat, lon, north, east, n))
+    }
+}
+
+/*--------------------------------------------------------------------------
+  North and east in a local frame to positions
+
+  The inverse of LocalFrameToNE(). The output arrays must not overlap the
+  input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to the frame
+  Argument 2: INPUT  - Array of n distances north of the reference point in nautical miles
+  Argument 3: INPUT  - Array of n distances east  of the reference point in nautical miles
+  Argument 4: OUTPUT - Array of n latitudes  in degrees
+  Argument 5: OUTPUT - Array of n longitudes in degrees, in the range [-180, 180)
+  Argument 6: INPUT  - Number of positions
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL LocalFrameFromNE(const LocalFrame *frame, const double *north, const double *east, double *lat, double *lon, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(local_from_ne, (frame, north, east, lat, lon, n))
+    }
+}
+
+/*--------------------------------------------------------------------------
+  Distance and bearing from the reference point of a local frame
+
+  The output arrays must not overlap the input arrays.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to the frame
+  Argument 2: INPUT  - Array of n latitudes  in degrees
+  Argument 3: INPUT  - Array of n longitudes in degrees
+  Argument 4: OUTPUT - Array of n distances in nautical miles
+  Argument 5: OUTPUT - Array of n bearings in degrees, in the range (-180, 180]
+  Argument 6: INPUT  - Number of positions
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL LocalFrameRange(const LocalFrame *frame, const double *lat, const double *lon, double *dist, double *bearing, int n)
+{
+    if (n > 0) {
+        BATCH_RUN(local_range, (frame, lat, lon, dist, bearing, n, accuracy_global))
+    }
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Section with calculations pertaining to the ICAO standard atmoshpere
+--------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------
+  Bands of the standard atmosphere
+
+  The atmosphere from -5 km to 80 km geopotential altitude is a stack of
+  bands, each with a constant temperature gradient (lapse rate). Within a
+  band starting at altitude hb, with temperature Tb and pressure pb
+
+    T = Tb + L*(h - hb)
+    p = pb*(T/Tb)^(-g0/(R*L))           where L != 0
+    p = pb*exp(-g0*(h - hb)/(R*Tb))     where L == 0 (isothermal)
+    rho = p/(R*T)
+
+  with g0 = 9.80665 m/s^2 and R = 287.05287 J/(kg K). The base pressures
+  are those formulas carried up from 101325 Pa at sea level, so pressure
+  is continuous across the bands. The troposphere band, with its base at
+  sea level, also covers the 5 km below it. Altitudes are in feet, and
+  the band of an altitude is the number of band bases at or below it.
+--------------------------------------------------------------------------*/
+#define ISA_G0      9.80665         // m/s^2
+#define ISA_R       287.05287       // J/(kg K), specific gas constant of air
+#define ISA_KELVIN  273.15
+#define ISA_PRESSURE 101325.0      // Pa at sea level
+#define ISA_DENSITY (ISA_PRESSURE / (ISA_R * 288.15))  // kg/m3 at sea level
+#define ISA_SOUND   38.967854       // speed of sound in kt per sqrt(K), sqrt(1.4*R)*3600/1852
+#define ISA_SOUND_SL 661.478604273801   // kt at sea level, ISA_SOUND*sqrt(288.15)
+#define ISA_BOTTOM  (-5000 / 0.3048)   // ft
+#define ISA_TOP     (80000 / 0.3048)   // ft
+#define ISA_BANDS   7
+
+typedef struct {
+    double base;            // altitude of the base, ft
+    double lapse;           // temperature gradient, K per ft
+    double scale;           // lapse/Tb, per ft
+    double temperature;     // at the base, K
+    double pressure;        // at the base, Pa
+    double inverse;         // sea-level over base pressure
+    double exponent;        // of T/Tb in the pressure, -g0/(R*L), 0 where isothermal
+    double decay;           // of the isothermal pressure, -g0/(R*Tb) per ft, 0 elsewhere
+} isa_band;
+
+// Band from its base in km, lapse rate in K/km, and base temperature and pressure
+#define ISA_BAND(km, lapse, T, p)                                                                   \
+    { (km) * 1000 / 0.3048, (lapse) * 0.3048 / 1000, (lapse) * 0.3048 / 1000 / (T), (T), (p),       \
+      ISA_PRESSURE / (p),                                                                           \
+      ((lapse) != 0) ? -ISA_G0 / (ISA_R * (lapse) / 1000) : 0.0,                                    \
+      ((lapse) != 0) ? 0.0 : -ISA_G0 * 0.3048 / (ISA_R * (T)) }
+
+static const isa_band isa_bands[ISA_BANDS] = {
+    ISA_BAND( 0, -6.5, 288.15, 101325.0),       // troposphere, from -5 km
+    ISA_BAND(11,  0.0, 216.65, 22632.04010),    // tropopause
+    ISA_BAND(20,  1.0, 216.65, 5474.877424),    // lower stratosphere
+    ISA_BAND(32,  2.8, 228.65, 868.0157766),    // upper stratosphere
+    ISA_BAND(47,  0.0, 270.65, 110.9057734),    // stratopause
+    ISA_BAND(51, -2.8, 270.65, 66.93852812),    // lower mesosphere
+    ISA_BAND(71, -2.0, 214.65, 3.956392160),    // upper mesosphere, to 80 km
+};
+
+// The band of an altitude in feet, by counting comparisons rather than branching.
+// Written out rather than looped, so batch loops stay vectorizable
+AVCALC_INLINE int isa_band_index(double h)
+{
+    return (h >= isa_bands[1].base) + (h >= isa_bands[2].base) + (h >= isa_bands[3].base)
+         + (h >= isa_bands[4].base) + (h >= isa_bands[5].base) + (h >= isa_bands[6].base);
+}
+
+AVCALC_INLINE const isa_band *isa_band_of(double h)
+{
+    return &isa_bands[isa_band_index(h)];
+}
+
+// Temperature in K at altitude h in the band
+AVCALC_INLINE double isa_temperature(const isa_band *band, double h)
+{
+    return band->temperature + band->lapse * (h - band->base);
+}
+
+// Pressure in Pa at altitude h in the band. T/Tb is taken as 1 + (L/Tb)*(h - hb), which
+// leaves the division off the path to pow
+AVCALC_INLINE double isa_pressure(const isa_band *band, double h)
+{
+    return (band->lapse != 0.0) ? band->pressure * pow(1.0 + band->scale * (h - band->base), band->exponent)
+                                : band->pressure * exp(band->decay * (h - band->base));
+}
+
+// Altitude inside the modelled range; NaN is let through to give NaN
+AVCALC_INLINE int isa_out_of_range(double h)
+{
+    return h < ISA_BOTTOM || h > ISA_TOP;
+}
+
+/*--------------------------------------------------------------------------
+  The atmosphere by table lookup
+
+  With a step selected by AtmosphereTableSelect(), pressure and density
+  come from ln(p) tabulated at nodes at most a step apart and
+  interpolated linearly. Each band has its own nodes, from its base to
+  the next, so every band base is a node, and temperature, which is
+  linear in each band, is still computed exactly.
+
+  Within a band with lapse rate L, ln(p) = ln(pb) + E*ln(T/Tb) has second
+  derivative -E*(L/T)^2, and linear interpolation between nodes d apart
+  is off by at most d^2/8 times its largest magnitude, at the coldest
+  end of the band. In an isothermal band ln(p) is linear and the
+  interpolation exact. The relative error of pressure, and of density
+  which divides it by the exact temperature, is then at most expm1 of
+  the largest bound over the bands, plus an allowance for rounding.
+--------------------------------------------------------------------------*/
+#define ISA_TABLE_ROUNDING  1e-13   // relative, for ln(p) at the nodes, the interpolation and exp
+#define ISA_TABLE_INTERVALS (1 << 20)   // per band at most, far above those of the 1 ft step
+
+typedef struct {
+    double  start[ISA_BANDS];       // ft, first node of each band
+    double  inverse[ISA_BANDS];     // intervals per ft in each band
+    int     first[ISA_BANDS];       // index in logp of the first node of each band
+    int     intervals[ISA_BANDS];   // between the nodes of each band
+    double *logp;                   // ln(p) at the nodes, p in Pa
+} isa_table;
+
+static double isa_table_step = 0.0;         // ft, 0 for the exact functions
+static isa_table *volatile isa_table_built = NULL;
+
+// The altitudes of band k inside the model
+static void isa_band_extent(int k, double *bottom, double *top)
+{
+    *bottom = (k == 0) ? ISA_BOTTOM : isa_bands[k].base;
+    *top    = (k == ISA_BANDS - 1) ? ISA_TOP : isa_bands[k + 1].base;
+}
+
+// The fewest intervals of band k no longer than step. Kept within 1 to ISA_TABLE_INTERVALS,
+// so no step leaves a band without an interval or overflows the conversion to int
+static int isa_table_intervals(int k, double step)
+{
+    double bottom, top, m;
+
+    isa_band_extent(k, &bottom, &top);
+    m = ceil((top - bottom) / step);
+    return (m >= 1.0) ? ((m <= ISA_TABLE_INTERVALS) ? (int)m : ISA_TABLE_INTERVALS) : 1;
+}
+
+// The largest relative error of pressure interpolated in a table of the step
+static double isa_table_error(double step)
+{
+    double worst = 0.0;
+
+    for (int k = 0; k < ISA_BANDS; k++) {
+        const isa_band *band = &isa_bands[k];
+        double bottom, top, d, coldest;
+
+        isa_band_extent(k, &bottom, &top);
+        d       = (top - bottom) / isa_table_intervals(k, step);
+        coldest = fmin(isa_temperature(band, bottom), isa_temperature(band, top));
+        worst   = fmax(worst, d * d / 8 * fabs(band->exponent) * (band->lapse / coldest) * (band->lapse / coldest));
+    }
+    return expm1(worst) + ISA_TABLE_ROUNDING;
+}
+
+// Table and nodes in one block, released with free()
+static isa_table *isa_table_build(double step)
+{
+    isa_table *table;
+    int nodes = 0;
+
+    for (int k = 0; k < ISA_BANDS; k++) {
+        nodes += isa_table_intervals(k, step) + 1;
+    }
+    table = (isa_table *)malloc(sizeof(isa_table) + sizeof(double) * (size_t)nodes);
+    if (table == NULL) {
+        return NULL;
+    }
+    table->logp = (double *)(table + 1);
+
+    nodes = 0;
+    for (int k = 0; k < ISA_BANDS; k++) {
+        const isa_band *band = &isa_bands[k];
+        int m = isa_table_intervals(k, step);
+        double bottom, top;
+
+        isa_band_extent(k, &bottom, &top);
+        table->start[k]     = bottom;
+        table->inverse[k]   = m / (top - bottom);
+        table->first[k]     = nodes;
+        table->intervals[k] = m;
+        for (int j = 0; j <= m; j++) {
+            double dh = bottom + (top - bottom) * j / m - band->base;
+
+            table->logp[nodes++] = log(band->pressure) + band->exponent * log1p(band->scale * dh) + band->decay * dh;
+        }
+    }
+    return table;
+}
+
+// The table of the selected step, built on first use. Of threads racing to build it,
+// the first to publish its table wins and the others free theirs
+static const isa_table *isa_table_get(void)
+{
+    isa_table *table, *expected = NULL;
+
+#if defined(_WIN32)
+    table = isa_table_built;
+#else
+    table = __atomic_load_n(&isa_table_built, __ATOMIC_ACQUIRE);
+#endif
+    if (table != NULL) {
+        return table;
+    }
+    table = isa_table_build(isa_table_step);
+    if (table == NULL) {
+        return NULL;
+    }
+#if defined(_WIN32)
+    expected = (isa_table *)InterlockedCompareExchangePointer((PVOID volatile *)&isa_table_built, table, NULL);
+#else
+    __atomic_compare_exchange_n(&isa_table_built, &expected, table, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+    if (expected != NULL) {
+        free(table);
+        return expected;
+    }
+    return table;
+}
+
+// ln(p) at altitude h in band k, between the two nodes around it
+AVCALC_INLINE double isa_table_log_pressure(const isa_table *table, int k, double h)
+{
+    double x = (h - table->start[k]) * table->inverse[k];
+    int j = (int)x;
+    const double *f;
+
+    j = (j < table->intervals[k]) ? j : table->intervals[k] - 1;   // the top of the band ends its last interval
+    f = &table->logp[table->first[k] + j];
+    return f[0] + (x - j) * (f[1] - f[0]);
+}
+
+// Pressure in Pa at altitude h in band k, from the table when a step is selected.
+// Should the table not be built for lack of memory, the exact pressure
+AVCALC_INLINE double isa_pressure_selected(int k, double h)
+{
+    const isa_table *table = (isa_table_step > 0.0) ? isa_table_get() : NULL;
+
+    return (table != NULL) ? exp(isa_table_log_pressure(table, k, h)) : isa_pressure(&isa_bands[k], h);
+}
+
+/*--------------------------------------------------------------------------
+  Select table lookup for pressure and density
+
+  With a step, Pressure_at_altitude() and Density_at_altitude()
+  interpolate ln(p) in a table with nodes at most that far apart. The
+  table is built by the first call that needs it.
+  AVCALC_ATMOSPHERE_TABLE_STEP gives a table of about 22 KB, which stays
+  in L1 cache. A step of 0 returns to the exact functions, which are the
+  default. Standard_temperature() is exact either way. Not to be called
+  while other threads evaluate the atmosphere.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to double containing the step in feet, at
+                      least 1 and finite, or 0 for no table
+
+  RETURN: Double containing the largest relative error of pressure and
+          density, 0 without a table, -1 if the step is not valid
+--------------------------------------------------------------------------*/
+double AVCALCCALL AtmosphereTableSelect(const double *step)
+{
+    if (!isfinite(*step) || (*step != 0.0 && !(*step >= 1.0))) {
+        return -1; //Error condition
+    }
+    if (*step != isa_table_step) {
+        free((void *)isa_table_built);
+        isa_table_built = NULL;
+        isa_table_step  = *step;
+    }
+    return (*step > 0.0) ? isa_table_error(*step) : 0.0;
+}
+
+/*--------------------------------------------------------------------------
+  The standard temperature at altitude
+
+  Given the geopotential altitude in feet, the function returns
+  temperature in °C
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to double containing altitude in feet
+
+  RETURN: Double containing temperature in °C, NAN outside -5 km to 80 km
+--------------------------------------------------------------------------*/
+double AVCALCCALL Standard_temperature(const double *pressure_alt){
+    const double h = *pressure_alt; // feet
+
+    if (isa_out_of_range(h)) {
+        return NAN; // Out of modeled range [-5 km, 80 km]
+    }
+    return isa_temperature(isa_band_of(h), h) - ISA_KELVIN;
+}
+
+
+
+/*--------------------------------------------------------------------------
+  Pitot pressure and Mach number
+
+  The pitot tube reads the total pressure, static plus impact pressure
+  qc. Below Mach 1 the flow slows isentropically and
+
+    (qc + p)/p = (1 + 0.2*M^2)^3.5
+
+  Above it a normal shock stands ahead of the tube, and Rayleigh's
+  supersonic pitot equation gives
+
+    (qc + p)/p = M^2/(C^2*(1 - 1/(7*M^2))^2.5),  C = 0.8812849
+
+  Both powers are a square root times a polynomial. The supersonic
+  equation has no closed inverse; the Mach number is found by iterating
+  it as M = C*sqrt((qc + p)/p*(1 - 1/(7*M^2))^2.5), starting from the
+  subsonic solution. The iteration contracts, fastest at high Mach. CAS is
+  the speed giving the same qc at sea level, so it is the Mach number
+  of qc over the sea-level pressure, times the sea-level speed of sound.
+--------------------------------------------------------------------------*/
+#define PITOT_RAYLEIGH  0.8812848543473311  // C, sqrt(7^2.5/(1.2^3.5*6^2.5))
+#define PITOT_SONIC     1.8929291587378538  // (qc + p)/p at Mach 1, 1.2^3.5
+#define PITOT_ITERATIONS 100
+
+// Total over static pressure at Mach number
+AVCALC_INLINE double pitot_ratio(double mach)
+{
+    double m2 = mach * mach, a = 1.0 + 0.2 * m2, b = 1.0 - 1.0 / (7.0 * m2);
+
+    return (mach <= 1.0) ? a * a * a * sqrt(a) : m2 / (PITOT_RAYLEIGH * PITOT_RAYLEIGH * b * b * sqrt(b));
+}
+
+// Mach number at total over static pressure
+static double pitot_mach(double ratio)
+{
+    double mach = sqrt(5.0 * (pow(ratio, 2.0 / 7) - 1.0)), b, next;
+
+    if (ratio <= PITOT_SONIC) {
+        return mach;
+    }
+    for (int i = 0; i < PITOT_ITERATIONS; i++) {
+        b    = 1.0 - 1.0 / (7.0 * mach * mach);
+        next = PITOT_RAYLEIGH * sqrt(ratio * b * b * sqrt(b));
+        if (fabs(next - mach) <= 1e-15 * mach) {
+            return next;
+        }
+        mach = next;
+    }
+    return mach;
+}
+
+// Speed or temperature outside what the functions take, or NaN, which the
+// polynomial log of the batch functions would not carry through
+AVCALC_INLINE int airspeed_invalid(double speed, double oat)
+{
+    return !(speed >= 0.0) || !(oat > -ISA_KELVIN);
+}
+
+/*--------------------------------------------------------------------------
+  True airspeed from calibrated airspeed
+
+  Compressible flow: the impact pressure of CAS at sea level, over the
+  standard pressure at the pressure altitude, gives the Mach number,
+  subsonic or supersonic, and the OAT its speed of sound.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to double containing CAS in knots
+  Argument 2: INPUT - Pointer to double containing pressure altitude in
+                      feet
+  Argument 3: INPUT - Pointer to double containing outside air temperature
+                      in °C
+
+  RETURN: Double containing TAS in knots, -1 for a negative CAS, an OAT
+          below absolute zero, either NaN, or an altitude outside -5 km
+          to 80 km
+--------------------------------------------------------------------------*/
+double AVCALCCALL TAS_2(const double *CAS, const double *pressure_alt, const double *oat){
+    double impact, mach;
+
+    if (isa_out_of_range(*pressure_alt) || airspeed_invalid(*CAS, *oat)) {
+        return -1; //Error condition
+    }
+    impact = ISA_PRESSURE * (pitot_ratio(*CAS / ISA_SOUND_SL) - 1.0);
+    mach   = pitot_mach(impact / isa_pressure(isa_band_of(*pressure_alt), *pressure_alt) + 1.0);
+    return mach * ISA_SOUND * sqrt(ISA_KELVIN + *oat);
+}
+
+/*--------------------------------------------------------------------------
+  Calibrated airspeed from true airspeed
+
+  The inverse of TAS_2(): the Mach number of TAS at the OAT gives the
+  impact pressure at the pressure altitude, and that over the sea-level
+  pressure gives CAS.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to double containing TAS in knots
+  Argument 2: INPUT - Pointer to double containing pressure altitude in
+                      feet
+  Argument 3: INPUT - Pointer to double containing outside air temperature
+                      in °C
+
+  RETURN: Double containing CAS in knots, -1 for a negative TAS, an OAT
+          below absolute zero, either NaN, or an altitude outside -5 km
+          to 80 km
+--------------------------------------------------------------------------*/
+double AVCALCCALL CAS_2(const double *TAS, const double *pressure_alt, const double *oat){
+    double impact;
+
+    if (isa_out_of_range(*pressure_alt) || airspeed_invalid(*TAS, *oat)) {
+        return -1; //Error condition
+    }
+    impact = isa_pressure(isa_band_of(*pressure_alt), *pressure_alt)
+           * (pitot_ratio(*TAS / (ISA_SOUND * sqrt(ISA_KELVIN + *oat))) - 1.0);
+    return ISA_SOUND_SL * pitot_mach(impact / ISA_PRESSURE + 1.0);
+}
+
+double AVCALCCALL Speed_of_sound(const double *oat){
+    return ISA_SOUND * sqrt(ISA_KELVIN + *oat); //Speed of sound in knots
+}
+
+/*--------------------------------------------------------------------------
+  The standard pressure at altitude
+
+  Exact, or interpolated in a table selected by AtmosphereTableSelect()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to double containing altitude in feet
+
+  RETURN: Double containing pressure in Pa, -1 outside -5 km to 80 km
+--------------------------------------------------------------------------*/
+double AVCALCCALL Pressure_at_altitude(const double *h){
+    if (isa_out_of_range(*h)) {
+        return -1; //Error condition
+    }
+    return isa_pressure_selected(isa_band_index(*h), *h);
+}
+
+/*--------------------------------------------------------------------------
+  The standard density at altitude
+
+  Exact, or interpolated in a table selected by AtmosphereTableSelect()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to double containing altitude in feet
+  Argument 2: INPUT - Pointer to double containing outside air temperature
+                      in °C, not used: the density is that of the
+                      standard atmosphere
+
+  RETURN: Double containing density in kg/m3, -1 outside -5 km to 80 km
+--------------------------------------------------------------------------*/
+double AVCALCCALL Density_at_altitude(const double *h, const double *oat){
+    int k;
+
+    if (isa_out_of_range(*h)) {
+        return -1; //Error condition
+    }
+    k = isa_band_index(*h);
+    return isa_pressure_selected(k, *h) / (ISA_R * isa_temperature(&isa_bands[k], *h));
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  The state of the atmosphere at many altitudes
+
+  Temperature, pressure, density, speed of sound and density ratio come
+  from one band lookup and one transcendental per altitude. Both kinds of
+  band are written as one expression,
+
+    p = pb*exp(exponent*log(1 + (L/Tb)*(h - hb)) + decay*(h - hb))
+
+  where an isothermal band has exponent and L zero and any other band has
+  decay zero, so every lane of a batch loop runs the same code. The band
+  is selected field by field with compares and blends, not gathered by
+  index, and log and exp are the polynomial kernels of the active
+  accuracy tier.
+--------------------------------------------------------------------------*/
+// Band k in place of band where h is at or above its base
+AVCALC_INLINE void isa_band_step(double h, int k, isa_band *band)
+{
+    int above = (h >= isa_bands[k].base);
+
+    band->base        = above ? isa_bands[k].base        : band->base;
+    band->lapse       = above ? isa_bands[k].lapse       : band->lapse;
+    band->scale       = above ? isa_bands[k].scale       : band->scale;
+    band->temperature = above ? isa_bands[k].temperature : band->temperature;
+    band->pressure    = above ? isa_bands[k].pressure    : band->pressure;
+    band->inverse     = above ? isa_bands[k].inverse     : band->inverse;
+    band->exponent    = above ? isa_bands[k].exponent    : band->exponent;
+    band->decay       = above ? isa_bands[k].decay       : band->decay;
+}
+
+// The band of h, selected field by field rather than gathered, so batch loops
+// vectorize on every kernel. Written out rather than looped for the same reason
+AVCALC_INLINE void isa_band_select(double h, isa_band *band)
+{
+    *band = isa_bands[0];
+    isa_band_step(h, 1, band);
+    isa_band_step(h, 2, band);
+    isa_band_step(h, 3, band);
+    isa_band_step(h, 4, band);
+    isa_band_step(h, 5, band);
+    isa_band_step(h, 6, band);
+}
+
+AVCALC_INLINE void atmosphere_point(double h, double deviation, double *temperature, double *pressure,
+                                    double *density, double *sound, double *sigma, int tier)
+{
+    isa_band band;
+    double dh, T, p, rho, fail;
+
+    isa_band_select(h, &band);
+    dh   = h - band.base;
+    T    = band.temperature + band.lapse * dh + deviation;
+    p    = band.pressure * math_exp(band.exponent * math_log(1.0 + band.scale * dh, tier) + band.decay * dh, tier);
+    rho  = p / (ISA_R * T);
+    fail = isa_out_of_range(h) ? NAN : 0.0;
+
+    *temperature = T - ISA_KELVIN + fail;
+    *pressure    = p + fail;
+    *density     = rho + fail;
+    *sound       = ISA_SOUND * sqrt(T) + fail;
+    *sigma       = rho * (1.0 / ISA_DENSITY) + fail;
+}
+
+AVCALC_INLINE void atmosphere_state_body(const double *h, const double *deviation,
+                                         double *restrict temperature, double *restrict pressure, double *restrict density,
+                                         double *restrict sound, double *restrict sigma, int n, int tier)
+{
+    TIER_SWITCH(tier, if (deviation != NULL) {
+                          for (int i = 0; i < n; i++) {
+                              atmosphere_point(h[i], deviation[i], &temperature[i], &pressure[i], &density[i], &sound[i], &sigma[i], TIER);
+                          }
+                      } else {
+                          for (int i = 0; i < n; i++) {
+                              atmosphere_point(h[i], 0.0, &temperature[i], &pressure[i], &density[i], &sound[i], &sigma[i], TIER);
+                          }
+                      })
+}
+
+BATCH_KERNEL(atmosphere_state, (const double *h, const double *deviation,
+                                double *restrict temperature, double *restrict pressure, double *restrict density,
+                                double *restrict sound, double *restrict sigma, int n, int tier),
+                               (h, deviation, temperature, pressure, density, sound, sigma, n, tier))
+
+/*--------------------------------------------------------------------------
+  Temperature, pressure, density, speed of sound and density ratio
+
+  For n pressure altitudes, with an optional deviation from the standard
+  temperature at each. The pressure is that of the standard atmosphere at
+  the pressure altitude, and the other quantities follow from it and the
+  actual temperature. The results are written to the arrays of state,
+  each of n elements, at the accuracy tier set by AccuracySelect().
+  Altitudes outside -5 km to 80 km, or NaN, give NaN in every array.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n pressure altitudes in feet
+  Argument 2: INPUT  - Array of n deviations from the standard temperature
+                       in °C, or NULL for the standard atmosphere
+  Argument 3: OUTPUT - Pointer to the state, receiving temperature in °C,
+                       pressure in Pa, density in kg/m3, speed of sound in
+                       knots and density over that at sea level
+  Argument 4: INPUT  - Number of altitudes
+
+  RETURN: The number of altitudes outside the model
+--------------------------------------------------------------------------*/
+int AVCALCCALL AtmosphereStateBatch(const double *pressure_alt, const double *isa_dev, AtmosphereState *state, int n)
+{
+    int outside = 0;
+
+    if (n <= 0) {
+        return 0;
+    }
+    BATCH_RUN(atmosphere_state, (pressure_alt, isa_dev, state->temperature, state->pressure, state->density,
+                                 state->speed_of_sound, state->sigma, n, accuracy_global))
+    for (int i = 0; i < n; i++) {
+        outside += isnan(state->pressure[i]);
+    }
+    return outside;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Airspeeds of many samples
+
+  Per sample, the static pressure ratio, p/p0 or p0/p from a sea-level
+  over base pressure kept in the band table, takes one log and one exp,
+  with the band selected as for the atmosphere state, and the impact
+  pressure a square root. The two powers of the pitot equation that
+  remain, of the pressure ratio and of the total pressure, merge into
+  the one 2/7 power of the total over static pressure, one log and one
+  exp more. These are the polynomial kernels of the active accuracy
+  tier. The loop takes every sample as subsonic; a pass after it solves
+  the few that are not with TAS_2() or CAS_2() and counts those that
+  are not valid.
+--------------------------------------------------------------------------*/
+// ln(p/pb) at altitude h in the band
+AVCALC_INLINE double isa_log_pressure_ratio(const isa_band *band, double h, int tier)
+{
+    double dh = h - band->base;
+
+    return band->exponent * math_log(1.0 + band->scale * dh, tier) + band->decay * dh;
+}
+
+// Subsonic Mach number at total over static pressure
+AVCALC_INLINE double pitot_mach_subsonic(double ratio, int tier)
+{
+    return sqrt(5.0 * (math_exp((2.0 / 7) * math_log(ratio, tier), tier) - 1.0));
+}
+
+AVCALC_INLINE double tas_point(double cas, double h, double oat, int tier)
+{
+    isa_band band;
+    double impact, fail;
+
+    isa_band_select(h, &band);
+    impact = (pitot_ratio(cas * (1.0 / ISA_SOUND_SL)) - 1.0)
+           * band.inverse * math_exp(-isa_log_pressure_ratio(&band, h, tier), tier);   // qc/p
+    fail   = (isa_out_of_range(h) || airspeed_invalid(cas, oat)) ? NAN : 0.0;
+    return pitot_mach_subsonic(impact + 1.0, tier) * ISA_SOUND * sqrt(ISA_KELVIN + oat) + fail;
+}
+
+AVCALC_INLINE double cas_point(double tas, double h, double oat, int tier)
+{
+    isa_band band;
+    double impact, fail;
+
+    isa_band_select(h, &band);
+    impact = (pitot_ratio(tas / (ISA_SOUND * sqrt(ISA_KELVIN + oat))) - 1.0)
+           * band.pressure * (1.0 / ISA_PRESSURE) * math_exp(isa_log_pressure_ratio(&band, h, tier), tier);   // qc/p0
+    fail   = (isa_out_of_range(h) || airspeed_invalid(tas, oat)) ? NAN : 0.0;
+    return ISA_SOUND_SL * pitot_mach_subsonic(impact + 1.0, tier) + fail;
+}
+
+AVCALC_INLINE void tas_batch_body(const double *cas, const double *h, const double *oat, double *restrict tas, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) tas[i] = tas_point(cas[i], h[i], oat[i], TIER);)
+}
+
+AVCALC_INLINE void cas_batch_body(const double *tas, const double *h, const double *oat, double *restrict cas, int n, int tier)
+{
+    TIER_SWITCH(tier, for (int i = 0; i < n; i++) cas[i] = cas_point(tas[i], h[i], oat[i], TIER);)
+}
+
+BATCH_KERNEL(tas_batch, (const double *cas, const double *h, const double *oat, double *restrict tas, int n, int tier),
+                        (cas, h, oat, tas, n, tier))
+BATCH_KERNEL(cas_batch, (const double *tas, const double *h, const double *oat, double *restrict cas, int n, int tier),
+                        (tas, h, oat, cas, n, tier))
+
+/*--------------------------------------------------------------------------
+  True airspeeds from calibrated airspeeds
+
+  For n samples, the same as TAS_2() at the accuracy tier set by
+  AccuracySelect(). Samples that TAS_2() rejects give NaN.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n CAS in knots
+  Argument 2: INPUT  - Array of n pressure altitudes in feet
+  Argument 3: INPUT  - Array of n outside air temperatures in °C
+  Argument 4: OUTPUT - Array of n TAS in knots
+  Argument 5: INPUT  - Number of samples
+
+  RETURN: The number of samples not valid
+--------------------------------------------------------------------------*/
+int AVCALCCALL TrueAirspeedBatch(const double *cas, const double *pressure_alt, const double *oat, double *tas, int n)
+{
+    int invalid = 0;
+
+    if (n <= 0) {
+        return 0;
+    }
+    BATCH_RUN(tas_batch, (cas, pressure_alt, oat, tas, n, accuracy_global))
+    for (int i = 0; i < n; i++) {
+        if (isnan(tas[i])) {
+            invalid++;
+        } else if (tas[i] * tas[i] > ISA_SOUND * ISA_SOUND * (ISA_KELVIN + oat[i])) {   // above Mach 1
+            tas[i] = TAS_2(&cas[i], &pressure_alt[i], &oat[i]);
+        }
+    }
+    return invalid;
+}
+
+/*--------------------------------------------------------------------------
+  Calibrated airspeeds from true airspeeds
+
+  For n samples, the same as CAS_2() at the accuracy tier set by
+  AccuracySelect(). Samples that CAS_2() rejects give NaN.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Array of n TAS in knots
+  Argument 2: INPUT  - Array of n pressure altitudes in feet
+  Argument 3: INPUT  - Array of n outside air temperatures in °C
+  Argument 4: OUTPUT - Array of n CAS in knots
+  Argument 5: INPUT  - Number of samples
+
+  RETURN: The number of samples not valid
+--------------------------------------------------------------------------*/
+int AVCALCCALL CalibratedAirspeedBatch(const double *tas, const double *pressure_alt, const double *oat, double *cas, int n)
+{
+    int invalid = 0;
+
+    if (n <= 0) {
+        return 0;
+    }
+    BATCH_RUN(cas_batch, (tas, pressure_alt, oat, cas, n, accuracy_global))
+    for (int i = 0; i < n; i++) {
+        if (isnan(cas[i])) {
+            invalid++;
+        } else if (cas[i] > ISA_SOUND_SL) {                 // above Mach 1 at sea level
+            cas[i] = CAS_2(&tas[i], &pressure_alt[i], &oat[i]);
+        }
+    }
+    return invalid;
+}
+
+
+
+
+/*--------------------------------------------------------------------------
+  Conversions between CAS, EAS, TAS and Mach number
+
+  AirData holds what the conversions need of one pressure altitude and
+  OAT: the static pressure ratio delta = p/p0, the density ratio sigma,
+  the speed of sound a and a0*sqrt(delta). With T the OAT in K,
+  sigma = delta*T0/T and a = 38.967854*sqrt(T), so a*sqrt(sigma) is
+  a0*sqrt(delta), the EAS of Mach 1. Every conversion goes through the
+  Mach number:
+
+    TAS = M*a          EAS = M*a0*sqrt(delta)
+    CAS = a0*Mach((qc/p)*delta + 1),  qc/p = pitot ratio of M - 1
+
+  so between TAS, EAS and Mach a conversion is a multiplication, and
+  each side that is CAS adds one pitot equation.
+--------------------------------------------------------------------------*/
+#define AIRSPEED_VALID(kind) ((kind) >= AVCALC_SPEED_CAS && (kind) <= AVCALC_SPEED_MACH)
+
+// Mach numbers per knot of EAS, TAS or Mach number; CAS has none
+AVCALC_INLINE double airspeed_per_mach(const AirData *air, int kind)
+{
+    return (kind == AVCALC_SPEED_EAS) ? air->eas_per_mach :
+           (kind == AVCALC_SPEED_TAS) ? air->sound        : 1.0;
+}
+
+/*--------------------------------------------------------------------------
+  Prepare the air at a pressure altitude and OAT for speed conversions
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to double containing pressure altitude in
+                       feet
+  Argument 2: INPUT  - Pointer to double containing outside air
+                       temperature in °C
+  Argument 3: OUTPUT - Pointer to the air data
+
+  RETURN: 0 on success, -1 for an OAT at or below absolute zero, or an
+          altitude outside -5 km to 80 km
+--------------------------------------------------------------------------*/
+int AVCALCCALL AirDataInit(const double *pressure_alt, const double *oat, AirData *air)
+{
+    double T = ISA_KELVIN + *oat;
+
+    if (isa_out_of_range(*pressure_alt) || isnan(*pressure_alt) || airspeed_invalid(0.0, *oat)) {
+        return -1; //Error condition
+    }
+    air->pressure_alt = *pressure_alt;
+    air->oat          = *oat;
+    air->pressure     = isa_pressure(isa_band_of(*pressure_alt), *pressure_alt);
+    air->delta        = air->pressure / ISA_PRESSURE;
+    air->sigma        = air->delta * 288.15 / T;
+    air->sound        = ISA_SOUND * sqrt(T);
+    air->eas_per_mach = ISA_SOUND_SL * sqrt(air->delta);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+  Convert a speed in the air at one pressure altitude and OAT
+
+  Subsonic and supersonic, as TAS_2() and CAS_2().
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Pointer to the air data, from AirDataInit()
+  Argument 2: INPUT - Kind of the speed given, one of AVCALC_SPEED_
+  Argument 3: INPUT - Kind of the speed wanted, one of AVCALC_SPEED_
+  Argument 4: INPUT - Pointer to double containing the speed, knots or
+                      Mach number
+
+  RETURN: Double containing the speed converted, -1 for a kind not known
+          or a negative or NaN speed
+--------------------------------------------------------------------------*/
+double AVCALCCALL AirspeedConvert(const AirData *air, int from, int to, const double *speed)
+{
+    double mach;
+
+    if (!AIRSPEED_VALID(from) || !AIRSPEED_VALID(to) || !(*speed >= 0.0)) {
+        return -1; //Error condition
+    }
+    if (from == to) {
+        return *speed;
+    }
+    mach = (from == AVCALC_SPEED_CAS) ? pitot_mach((pitot_ratio(*speed / ISA_SOUND_SL) - 1.0) / air->delta + 1.0)
+                                      : *speed / airspeed_per_mach(air, from);
+    return (to == AVCALC_SPEED_CAS) ? ISA_SOUND_SL * pitot_mach((pitot_ratio(mach) - 1.0) * air->delta + 1.0)
+                                    : mach * airspeed_per_mach(air, to);
+}
+
+AVCALC_INLINE double airspeed_fail(double speed)
+{
+    return (speed >= 0.0) ? 0.0 : NAN;
+}
+
+// Loops of each pair of kinds, with the speeds taken as subsonic where CAS is one of them
+AVCALC_INLINE void airspeed_batch_body(const AirData *air, int from, int to, const double *speed,
+                                       double *restrict result, int n, int tier)
+{
+    double scale = airspeed_per_mach(air, to) / airspeed_per_mach(air, from);
+    double per   = airspeed_per_mach(air, from);
+    double out   = airspeed_per_mach(air, to);
+    double delta = air->delta;
+
+    TIER_SWITCH(tier, if (from == to) {
+                          for (int i = 0; i < n; i++) result[i] = speed[i] + airspeed_fail(speed[i]);
+                      } else if (from == AVCALC_SPEED_CAS) {
+                          for (int i = 0; i < n; i++) {
+                              result[i] = pitot_mach_subsonic((pitot_ratio(speed[i] * (1.0 / ISA_SOUND_SL)) - 1.0) / delta + 1.0, TIER) * out
+                                        + airspeed_fail(speed[i]);
+                          }
+                      } else if (to == AVCALC_SPEED_CAS) {
+                          for (int i = 0; i < n; i++) {
+                              result[i] = ISA_SOUND_SL * pitot_mach_subsonic((pitot_ratio(speed[i] / per) - 1.0) * delta + 1.0, TIER)
+                                        + airspeed_fail(speed[i]);
+                          }
+                      } else {
+                          for (int i = 0; i < n; i++) result[i] = speed[i] * scale + airspeed_fail(speed[i]);
+                      })
+}
+
+BATCH_KERNEL(airspeed_batch, (const AirData *air, int from, int to, const double *speed,
+                              double *restrict result, int n, int tier),
+                             (air, from, to, speed, result, n, tier))
+
+/*--------------------------------------------------------------------------
+  Convert many speeds in the air at one pressure altitude and OAT
+
+  The same as AirspeedConvert() at the accuracy tier set by
+  AccuracySelect(). Conversions between EAS, TAS and Mach number are a
+  multiplication. Where CAS is one of the kinds, the loop takes every
+  speed as subsonic and a pass after it converts the few that are not
+  with AirspeedConvert(). Negative or NaN speeds give NaN.
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - Pointer to the air data, from AirDataInit()
+  Argument 2: INPUT  - Kind of the speeds given, one of AVCALC_SPEED_
+  Argument 3: INPUT  - Kind of the speeds wanted, one of AVCALC_SPEED_
+  Argument 4: INPUT  - Array of n speeds, knots or Mach numbers
+  Argument 5: OUTPUT - Array of n speeds converted
+  Argument 6: INPUT  - Number of speeds
+
+  RETURN: The number of speeds not valid, or -1 for a kind not known
+--------------------------------------------------------------------------*/
+int AVCALCCALL AirspeedConvertBatch(const AirData *air, int from, int to, const double *speed, double *result, int n)
+{
+    int invalid = 0;
+    double sonic = 1.0;
+
+    if (!AIRSPEED_VALID(from) || !AIRSPEED_VALID(to)) {
+        return -1; //Error condition
+    }
+    if (n <= 0) {
+        return 0;
+    }
+    BATCH_RUN(airspeed_batch, (air, from, to, speed, result, n, accuracy_global))
+
+    // Above Mach 1 in the result where CAS is given, above the sea-level speed of sound where it is wanted
+    sonic = (to == AVCALC_SPEED_CAS) ? ISA_SOUND_SL : airspeed_per_mach(air, to);
+    for (int i = 0; i < n; i++) {
+        if (isnan(result[i])) {
+            invalid++;
+        } else if (from != to && (from == AVCALC_SPEED_CAS || to == AVCALC_SPEED_CAS) && result[i] > sonic) {
+            result[i] = AirspeedConvert(air, from, to, &speed[i]);
+        }
+    }
+    return invalid;
+}
+
+/*--------------------------------------------------------------------------
+  A cache of air data
+
+  Direct mapped: the exact bits of the pressure altitude and OAT select
+  a slot, which holds the air data last prepared for a pair mapping to
+  it. A pair found in its slot costs a hash and two comparisons; any
+  other pair is prepared with AirDataInit() and replaces the slot.
+--------------------------------------------------------------------------*/
+typedef struct {
+    uint64_t altitude, temperature;   // bits of the key
+    int      used;
+    AirData  air;
+} air_slot;
+
+struct AirDataCache {
+    int       mask;     // slots - 1, slots a power of two
+    air_slot *slot;
+};
+
+static int air_slot_of(const AirDataCache *cache, uint64_t altitude, uint64_t temperature)
+{
+    uint64_t h = altitude * 0x9E3779B97F4A7C15ull ^ temperature * 0xC2B2AE3D27D4EB4Full;
+
+    return (int)(((h ^ (h >> 29)) >> 32) & (uint64_t)cache->mask);
+}
+
+/*--------------------------------------------------------------------------
+  Create a cache of air data
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - Number of pairs of pressure altitude and OAT kept,
+                      rounded up to a power of two
+
+  RETURN: The cache, to be released with AirDataCacheFree(), or NULL if
+          capacity is not positive or memory runs out
+--------------------------------------------------------------------------*/
+AirDataCache* AVCALCCALL AirDataCacheCreate(int capacity)
+{
+    AirDataCache *cache;
+    int slots = 1;
+
+    if (capacity <= 0 || capacity > (1 << 24)) {
+        return NULL;
+    }
+    while (slots < capacity) {
+        slots *= 2;
+    }
+    cache = (AirDataCache *)malloc(sizeof(AirDataCache) + sizeof(air_slot) * (size_t)slots);
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->mask = slots - 1;
+    cache->slot = (air_slot *)(cache + 1);
+    for (int i = 0; i < slots; i++) {
+        cache->slot[i].used = 0;
+    }
+    return cache;
+}
+
+/*--------------------------------------------------------------------------
+  Release a cache created by AirDataCacheCreate()
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The cache, may be NULL
+
+  RETURN: None
+--------------------------------------------------------------------------*/
+void AVCALCCALL AirDataCacheFree(AirDataCache *cache)
+{
+    free(cache);
+}
+
+/*--------------------------------------------------------------------------
+  The air data of a pressure altitude and OAT, from the cache
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT - The cache
+  Argument 2: INPUT - Pointer to double containing pressure altitude in
+                      feet
+  Argument 3: INPUT - Pointer to double containing outside air
+                      temperature in °C
+
+  RETURN: The air data, valid until the next call with the cache, or
+          NULL where AirDataInit() fails
+--------------------------------------------------------------------------*/
+const AirData* AVCALCCALL AirDataCacheGet(AirDataCache *cache, const double *pressure_alt, const double *oat)
+{
+    uint64_t altitude = math_asuint(*pressure_alt), temperature = math_asuint(*oat);
+    air_slot *slot = &cache->slot[air_slot_of(cache, altitude, temperature)];
+
+    if (slot->used && slot->altitude == altitude && slot->temperature == temperature) {
+        return &slot->air;
+    }
+    if (AirDataInit(pressure_alt, oat, &slot->air) != 0) {
+        return NULL;
+    }
+    slot->used        = 1;
+    slot->altitude    = altitude;
+    slot->temperature = temperature;
+    return &slot->air;
+}
+
+/*--------------------------------------------------------------------------
+  Convert many speeds grouped by flight level
+
+  Samples in runs of the same pressure altitude and OAT, such as those
+  of a flight sorted by level, share the air data of the run, from the
+  cache. Each run is converted by AirspeedConvertBatch().
+----------------------------------------------------------------------------
+  Implementation
+  Argument 1: INPUT  - The cache
+  Argument 2: INPUT  - Array of n pressure altitudes in feet
+  Argument 3: INPUT  - Array of n outside air temperatures in °C
+  Argument 4: INPUT  - Kind of the speeds given, one of AVCALC_SPEED_
+  Argument 5: INPUT  - Kind of the speeds wanted, one of AVCALC_SPEED_
+  Argument 6: INPUT  - Array of n speeds, knots or Mach numbers
+  Argument 7: OUTPUT - Array of n speeds converted, NaN for samples not
+                       valid
+  Argument 8: INPUT  - Number of samples
+
+  RETURN: The number of samples not valid, or -1 for a kind not known
+--------------------------------------------------------------------------*/
+int AVCALCCALL AirspeedConvertLevels(AirDataCache *cache, const double *pressure_alt, const double *oat, int from, int to,
+                                     const double *speed, double *result, int n)
+{
+    int invalid = 0, end;
+
+    if (!AIRSPEED_VALID(from) || !AIRSPEED_VALID(to)) {
+        return -1; //Error condition
+    }
+    for (int i = 0; i < n; i = end) {
+        const AirData *air = AirDataCacheGet(cache, &pressure_alt[i], &oat[i]);
+
+        for (end = i + 1; end < n && pressure_alt[end] == pressure_alt[i] && oat[end] == oat[i]; end++) {
+        }
+        if (air != NULL) {
+            invalid += AirspeedConvertBatch(air, from, to, &speed[i], &result[i], end - i);
+        } else {
+            for (int j = i; j < end; j++) {
+                result[j] = NAN;
+            }
+            invalid += end - i;
+        }
+    }
+    return invalid;
+}
@@ -38,9 +38,166 @@ extern "C"
 #define rho_0 1.2250 //sea level standard density kg/m3
 #define P_0 101325   //sea level standard pressure (Pa)
 
+/* A point with its trigonometry computed once, see PreparePoint() */
+typedef struct {
+    double lat, lon;          // degrees
+    double sinlat, coslat;
+    double sinlon, coslon;
+    double x, y, z;           // unit vector, earth centred, earth fixed
+    double psi;               // isometric latitude log(tan(pi/4 + lat/2)), for rhumb lines
+} PreparedPoint;
+
 AVCALCAPI double AVCALCCALL Distance(const double* lat1, const double* lon1, const double* lat2, const double* lon2);
 AVCALCAPI double AVCALCCALL CourseInitial (double *lat1, double *lon1, double *lat2, double *lon2);
 AVCALCAPI void AVCALCCALL IntermediatePoint (const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *fraction, double *latresult, double *lonresult);
+AVCALCAPI void AVCALCCALL Inverse(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course_initial, double *course_final);
+AVCALCAPI void AVCALCCALL Direct(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult);
+AVCALCAPI void AVCALCCALL RhumbInverse(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course);
+AVCALCAPI void AVCALCCALL RhumbDirect(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult);
+
+AVCALCAPI void AVCALCCALL PreparePoint(const double *lat, const double *lon, PreparedPoint *point);
+AVCALCAPI void AVCALCCALL PreparePoints(const double *lat, const double *lon, PreparedPoint *points, int n);
+AVCALCAPI double AVCALCCALL DistancePrepared(const PreparedPoint *p1, const PreparedPoint *p2);
+AVCALCAPI double AVCALCCALL CourseInitialPrepared(const PreparedPoint *p1, const PreparedPoint *p2);
+AVCALCAPI void AVCALCCALL IntermediatePointPrepared(const PreparedPoint *p1, const PreparedPoint *p2, const double *fraction, double *latresult, double *lonresult);
+AVCALCAPI void AVCALCCALL RhumbInversePrepared(const PreparedPoint *p1, const PreparedPoint *p2, double *dist, double *course);
+
+AVCALCAPI void AVCALCCALL IntermediatePoints(const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *fractions, double *latresult, double *lonresult, int n);
+AVCALCAPI int AVCALCCALL IntermediatePointsSteps(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int steps, double *latresult, double *lonresult);
+AVCALCAPI int AVCALCCALL IntermediatePointsSpacing(const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *spacing, double *latresult, double *lonresult, int max_points);
+AVCALCAPI int AVCALCCALL CrossTrack(const double *latA, const double *lonA, const double *latB, const double *lonB, const double *lat, const double *lon, double *xtd, double *atd);
+AVCALCAPI int AVCALCCALL CrossTrackBatch(const double *latA, const double *lonA, const double *latB, const double *lonB, const double *lat, const double *lon, double *xtd, double *atd, int n);
+AVCALCAPI int AVCALCCALL LegVertex(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *latv, double *lonv);
+AVCALCAPI void AVCALCCALL LegVertexBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *latv, double *lonv, int *reached, int n);
+AVCALCAPI int AVCALCCALL CrossParallel(const double *lat1, const double *lon1, const double *lat2, const double *lon2, const double *lat, double *lon_north, double *lon_south);
+AVCALCAPI int AVCALCCALL CrossParallelBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int n, const double *lat, int m, double *lon_north, double *lon_south);
+
+/* A route with its legs and distances along it, see RouteCreate() */
+typedef struct Route Route;
+
+AVCALCAPI Route* AVCALCCALL RouteCreate(const double *lat, const double *lon, int n);
+AVCALCAPI void AVCALCCALL RouteFree(Route *route);
+AVCALCAPI int AVCALCCALL RouteSize(const Route *route);
+AVCALCAPI double AVCALCCALL RouteLength(const Route *route);
+AVCALCAPI int AVCALCCALL RouteWaypoint(const Route *route, int k, double *lat, double *lon, double *along);
+AVCALCAPI int AVCALCCALL RouteLeg(const Route *route, int k, double *dist, double *course);
+AVCALCAPI int AVCALCCALL RoutePositionAt(const Route *route, const double *dist, double *lat, double *lon, double *course);
+AVCALCAPI int AVCALCCALL RoutePositionAtBatch(const Route *route, const double *dist, double *lat, double *lon, double *course, int *leg, int n);
+AVCALCAPI int AVCALCCALL RouteInsert(Route *route, int k, const double *lat, const double *lon);
+AVCALCAPI int AVCALCCALL RouteDelete(Route *route, int k);
+
+/* A route prepared for nearest leg searches, see RouteMatcherCreate() */
+typedef struct RouteMatcher RouteMatcher;
+
+AVCALCAPI RouteMatcher* AVCALCCALL RouteMatcherCreate(const double *lat, const double *lon, int n);
+AVCALCAPI void AVCALCCALL RouteMatcherFree(RouteMatcher *route);
+AVCALCAPI int AVCALCCALL RouteMatchNearest(const RouteMatcher *route, const double *lat, const double *lon, int *hint, double *xtd, double *atd);
+AVCALCAPI int AVCALCCALL RouteMatchBatch(const RouteMatcher *route, const double *lat, const double *lon, int *hint, int *leg, double *xtd, double *atd, int n);
+
+/* A polygon prepared for point in polygon tests, see SphericalPolygonCreate() */
+typedef struct SphericalPolygon SphericalPolygon;
+
+AVCALCAPI SphericalPolygon* AVCALCCALL SphericalPolygonCreate(const double *lat, const double *lon, int n);
+AVCALCAPI void AVCALCCALL SphericalPolygonFree(SphericalPolygon *poly);
+AVCALCAPI int AVCALCCALL SphericalPolygonContains(const SphericalPolygon *poly, const double *lat, const double *lon);
+AVCALCAPI int AVCALCCALL SphericalPolygonContainsBatch(const SphericalPolygon *poly, const double *lat, const double *lon, int *inside, int n);
+
+/* Points prepared for nearest point searches, see PointIndexCreate() */
+typedef struct PointIndex PointIndex;
+
+AVCALCAPI PointIndex* AVCALCCALL PointIndexCreate(const double *lat, const double *lon, int n);
+AVCALCAPI void AVCALCCALL PointIndexFree(PointIndex *index);
+AVCALCAPI int AVCALCCALL PointIndexSave(const PointIndex *index, const char *path);
+AVCALCAPI PointIndex* AVCALCCALL PointIndexLoad(const char *path);
+AVCALCAPI int AVCALCCALL PointIndexSize(const PointIndex *index);
+AVCALCAPI int AVCALCCALL PointIndexNearest(const PointIndex *index, const double *lat, const double *lon, int k, int *found, double *dist);
+AVCALCAPI int AVCALCCALL PointIndexWithin(const PointIndex *index, const double *lat, const double *lon, const double *radius, int *found, double *dist, int max_found);
+AVCALCAPI int AVCALCCALL PointIndexNearestBatch(const PointIndex *index, const double *lat, const double *lon, int n, int k, int *found, double *dist, int threads);
+AVCALCAPI int AVCALCCALL PointIndexWithinBatch(const PointIndex *index, const double *lat, const double *lon, int n, const double *radius, int *count, int *found, double *dist, int max_found, int threads);
+
+/* Earth models of LocalFrameInit(), the Geodesic functions and the coordinate conversions */
+#define AVCALC_EARTH_SPHERE    0   // 60 nm per degree of great circle, as the rest of the library
+#define AVCALC_EARTH_WGS84     1
+#define AVCALC_EARTH_GRS80     2   // NAD83
+#define AVCALC_EARTH_WGS66     3
+#define AVCALC_EARTH_GRS67     4   // IAU68
+#define AVCALC_EARTH_WGS72     5
+#define AVCALC_EARTH_KRASOVSKY 6
+#define AVCALC_EARTH_CLARKE66  7   // NAD27
+
+/* A north, east frame around a reference point, see LocalFrameInit() */
+typedef struct {
+    double lat0, lon0;        // reference point, degrees
+    double north_per_deg;     // nm per degree of latitude,  R1*pi/180
+    double east_per_deg;      // nm per degree of longitude, R2*cos(lat0)*pi/180
+    double deg_per_north;     // 1/north_per_deg
+    double deg_per_east;      // 1/east_per_deg
+    double radius;            // R1, nm
+    double tanlat;            // |tan(lat0)|
+} LocalFrame;
+
+AVCALCAPI int AVCALCCALL LocalFrameInit(const double *lat0, const double *lon0, int model, LocalFrame *frame);
+AVCALCAPI double AVCALCCALL LocalFrameErrorBound(const LocalFrame *frame, const double *dist);
+AVCALCAPI void AVCALCCALL LocalFrameToNE(const LocalFrame *frame, const double *lat, const double *lon, double *north, double *east, int n);
+AVCALCAPI void AVCALCCALL LocalFrameFromNE(const LocalFrame *frame, const double *north, const double *east, double *lat, double *lon, int n);
+AVCALCAPI void AVCALCCALL LocalFrameRange(const LocalFrame *frame, const double *lat, const double *lon, double *dist, double *bearing, int n);
+
+/* Kernels used by the batch functions, see BatchKernelSelect() */
+#define AVCALC_KERNEL_AUTO   0
+#define AVCALC_KERNEL_SCALAR 1
+#define AVCALC_KERNEL_AVX2   2
+#define AVCALC_KERNEL_AVX512 3
+
+AVCALCAPI int AVCALCCALL BatchKernelSelect(int kernel);
+AVCALCAPI int AVCALCCALL BatchKernelActive(void);
+AVCALCAPI void AVCALCCALL DistanceBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n);
+AVCALCAPI void AVCALCCALL InverseBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course_initial, double *course_final, int n);
+AVCALCAPI void AVCALCCALL DirectBatch(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult, int n);
+AVCALCAPI void AVCALCCALL DirectBatchFrom(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult, int n);
+AVCALCAPI void AVCALCCALL RhumbInverseBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, double *course, int n);
+AVCALCAPI void AVCALCCALL RhumbDirectBatch(const double *lat1, const double *lon1, const double *course, const double *dist, double *latresult, double *lonresult, int n);
+AVCALCAPI int AVCALCCALL GeodesicInverse(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int model, double *dist, double *course_initial, double *course_final);
+AVCALCAPI int AVCALCCALL GeodesicInverseBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, int model, double *dist, double *course_initial, double *course_final, int n);
+AVCALCAPI int AVCALCCALL GeodesicDirect(const double *lat1, const double *lon1, const double *course, const double *dist, int model, double *latresult, double *lonresult, double *course_final);
+AVCALCAPI int AVCALCCALL GeodesicDirectBatch(const double *lat1, const double *lon1, const double *course, const double *dist, int model, double *latresult, double *lonresult, double *course_final, int n);
+AVCALCAPI int AVCALCCALL GeodeticToEcef(const double *lat, const double *lon, const double *height, int model, double *x, double *y, double *z, int n);
+AVCALCAPI int AVCALCCALL EcefToGeodetic(const double *x, const double *y, const double *z, int model, double *lat, double *lon, double *height, int n);
+AVCALCAPI int AVCALCCALL GeodeticToGeocentric(const double *lat, const double *height, int model, double *latc, double *radius, int n);
+AVCALCAPI int AVCALCCALL GeocentricToGeodetic(const double *latc, const double *radius, int model, double *lat, double *height, int n);
+
+/* Results of RadialIntersection() */
+#define AVCALC_INTERSECT_UNIQUE    0
+#define AVCALC_INTERSECT_INFINITE  1  // The radials lie on the same great circle
+#define AVCALC_INTERSECT_AMBIGUOUS 2  // The radials diverge
+
+AVCALCAPI int AVCALCCALL RadialIntersection(const double *lat1, const double *lon1, const double *crs13, const double *lat2, const double *lon2, const double *crs23, double *lat3, double *lon3);
+AVCALCAPI void AVCALCCALL RadialIntersectionBatch(const double *lat1, const double *lon1, const double *crs13, const double *lat2, const double *lon2, const double *crs23, double *lat3, double *lon3, int *status, int n);
+AVCALCAPI void AVCALCCALL RadialIntersectionBatchFrom(const double *lat1, const double *lon1, const double *crs13, const double *lat2, const double *lon2, const double *crs23, double *lat3, double *lon3, int *status, int n);
+AVCALCAPI int AVCALCCALL DistanceMatrix(const double *lat1, const double *lon1, int n, const double *lat2, const double *lon2, int m, double *dist, int threads);
+AVCALCAPI int AVCALCCALL DistanceMatrixSymmetric(const double *lat, const double *lon, int n, double *dist, int threads);
+AVCALCAPI double AVCALCCALL ClosestApproach(const double *lat1, const double *lon1, const double *track1, const double *speed1, const double *lat2, const double *lon2, const double *track2, const double *speed2, const double *lookahead, double *tcpa);
+AVCALCAPI int AVCALCCALL ConflictDetect(const double *lat, const double *lon, const double *track, const double *speed, int n, const double *lookahead, const double *separation, int *first, int *second, double *tcpa, double *dcpa, int max_conflicts, int threads);
+
+/* Accuracy tiers of the polynomial math kernels, see AccuracySelect() */
+#define AVCALC_ACCURACY_GLOBAL  -1  // The tier set by AccuracySelect()
+#define AVCALC_ACCURACY_FULL     0  // Full double precision
+#define AVCALC_ACCURACY_NAV      1  // About 1e-9 rad
+#define AVCALC_ACCURACY_DISPLAY  2  // About 1e-6 rad
+
+/* Functions evaluated by MathBatch() */
+#define AVCALC_MATH_SIN   0
+#define AVCALC_MATH_COS   1
+#define AVCALC_MATH_ASIN  2
+#define AVCALC_MATH_ATAN2 3
+#define AVCALC_MATH_EXP   4
+#define AVCALC_MATH_LOG   5
+#define AVCALC_MATH_POW   6
+#define AVCALC_MATH_FMOD  7
+
+AVCALCAPI int AVCALCCALL AccuracySelect(int accuracy);
+AVCALCAPI int AVCALCCALL AccuracyActive(void);
+AVCALCAPI int AVCALCCALL MathBatch(int function, const double *x, const double *y, double *result, int n, int accuracy);
+
 
 AVCALCAPI double AVCALCCALL Standard_temperature(const double *h);
 AVCALCAPI double AVCALCCALL TAS_2(const double *CAS, const double *pressure_alt, const double *oat);
@@ -49,6 +206,52 @@ AVCALCAPI double AVCALCCALL Speed_of_sound(const double *oat);
 AVCALCAPI double AVCALCCALL Pressure_at_altitude(const double *h);
 AVCALCAPI double AVCALCCALL Density_at_altitude(const double *pressure_alt, const double *oat);
 
+/* Altitude step in feet of a table that stays in L1 cache, see AtmosphereTableSelect() */
+#define AVCALC_ATMOSPHERE_TABLE_STEP 100.0
+
+AVCALCAPI double AVCALCCALL AtmosphereTableSelect(const double *step);
+
+/* Arrays of the state of the atmosphere, see AtmosphereStateBatch() */
+typedef struct {
+    double *temperature;      // °C
+    double *pressure;         // Pa
+    double *density;          // kg/m3
+    double *speed_of_sound;   // knots
+    double *sigma;            // density over that at sea level
+} AtmosphereState;
+
+AVCALCAPI int AVCALCCALL AtmosphereStateBatch(const double *pressure_alt, const double *isa_dev, AtmosphereState *state, int n);
+AVCALCAPI int AVCALCCALL TrueAirspeedBatch(const double *cas, const double *pressure_alt, const double *oat, double *tas, int n);
+AVCALCAPI int AVCALCCALL CalibratedAirspeedBatch(const double *tas, const double *pressure_alt, const double *oat, double *cas, int n);
+
+/* Kinds of speed converted by AirspeedConvert() */
+#define AVCALC_SPEED_CAS   0  // Calibrated airspeed, knots
+#define AVCALC_SPEED_EAS   1  // Equivalent airspeed, knots
+#define AVCALC_SPEED_TAS   2  // True airspeed, knots
+#define AVCALC_SPEED_MACH  3  // Mach number
+
+/* The air at one pressure altitude and OAT, see AirDataInit() */
+typedef struct {
+    double pressure_alt;      // feet
+    double oat;               // °C
+    double pressure;          // static pressure, Pa
+    double delta;             // static pressure over that at sea level
+    double sigma;             // density over that at sea level
+    double sound;             // speed of sound, knots
+    double eas_per_mach;      // EAS of Mach 1, knots, a0*sqrt(delta)
+} AirData;
+
+/* Air data of recent pressure altitudes and OATs, see AirDataCacheCreate() */
+typedef struct AirDataCache AirDataCache;
+
+AVCALCAPI int AVCALCCALL AirDataInit(const double *pressure_alt, const double *oat, AirData *air);
+AVCALCAPI double AVCALCCALL AirspeedConvert(const AirData *air, int from, int to, const double *speed);
+AVCALCAPI int AVCALCCALL AirspeedConvertBatch(const AirData *air, int from, int to, const double *speed, double *result, int n);
+AVCALCAPI AirDataCache* AVCALCCALL AirDataCacheCreate(int capacity);
+AVCALCAPI void AVCALCCALL AirDataCacheFree(AirDataCache *cache);
+AVCALCAPI const AirData* AVCALCCALL AirDataCacheGet(AirDataCache *cache, const double *pressure_alt, const double *oat);
+AVCALCAPI int AVCALCCALL AirspeedConvertLevels(AirDataCache *cache, const double *pressure_alt, const double *oat, int from, int to, const double *speed, double *result, int n);
+
 
 
 #ifdef __cplusplus
@@ -0,0 +1,1031 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "AvCalc.h"
+
+#ifdef _WIN32
+    #include <Windows.h>
+#else
+    #include <time.h>
+#endif
+
+// Wall clock time in seconds
+static double bench_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Uniform random number in [lo, hi)
+static double bench_random(double lo, double hi) {
+    return lo + (hi - lo) * (rand() / (RAND_MAX + 1.0));
+}
+
+#define PAIRS  (1 << 16)   // Pairs per call, sized to stay in L2 cache
+#define ROUNDS 200
+
+static double lat1[PAIRS], lon1[PAIRS], lat2[PAIRS], lon2[PAIRS], dist[PAIRS];
+static volatile double sink;
+
+static void bench_Distance(void) {
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            dist[i] = Distance(&lat1[i], &lon1[i], &lat2[i], &lon2[i]);
+        }
+        sink = dist[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "Distance()", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_DistancePrepared(void) {
+    static PreparedPoint p1[PAIRS], p2[PAIRS];
+
+    PreparePoints(lat1, lon1, p1, PAIRS);
+    PreparePoints(lat2, lon2, p2, PAIRS);
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            dist[i] = DistancePrepared(&p1[i], &p2[i]);
+        }
+        sink = dist[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "DistancePrepared()", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_DistanceBatch(void) {
+    static const char *names[] = {"Auto", "Scalar", "AVX2", "AVX-512"};
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        char label[40];
+
+        sprintf(label, "DistanceBatch %s", names[kernel]);
+        if (BatchKernelSelect(kernel) < 0) {
+            printf("%-24s not supported by this CPU\n", label);
+            continue;
+        }
+        double start = bench_seconds();
+        for (int r = 0; r < ROUNDS; r++) {
+            DistanceBatch(lat1, lon1, lat2, lon2, dist, PAIRS);
+            sink = dist[r];
+        }
+        double elapsed = bench_seconds() - start;
+        printf("%-24s %10.1f Mpairs/s\n", label, PAIRS * (double)ROUNDS / elapsed * 1e-6);
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+static void bench_Inverse(void) {
+    // Distance() and CourseInitial() called on the same pair, against the fused forms
+    static double course1[PAIRS], course2[PAIRS];
+    static const char *names[] = {"Auto", "Scalar", "AVX2", "AVX-512"};
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            dist[i]    = Distance(&lat1[i], &lon1[i], &lat2[i], &lon2[i]);
+            course1[i] = CourseInitial(&lat1[i], &lon1[i], &lat2[i], &lon2[i]);
+        }
+        sink = course1[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "Distance+CourseInitial", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            Inverse(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &dist[i], &course1[i], &course2[i]);
+        }
+        sink = course1[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "Inverse()", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        char label[40];
+
+        sprintf(label, "InverseBatch %s", names[kernel]);
+        if (BatchKernelSelect(kernel) < 0) {
+            printf("%-24s not supported by this CPU\n", label);
+            continue;
+        }
+        start = bench_seconds();
+        for (int r = 0; r < ROUNDS; r++) {
+            InverseBatch(lat1, lon1, lat2, lon2, dist, course1, course2, PAIRS);
+            sink = course1[r];
+        }
+        elapsed = bench_seconds() - start;
+        printf("%-24s %10.1f Mpairs/s\n", label, PAIRS * (double)ROUNDS / elapsed * 1e-6);
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+static void bench_Direct(void) {
+    // Extrapolating state vectors: course from lon2, distance from lat2
+    static double course[PAIRS], range[PAIRS], lat[PAIRS], lon[PAIRS];
+    static const char *names[] = {"Auto", "Scalar", "AVX2", "AVX-512"};
+
+    for (int i = 0; i < PAIRS; i++) {
+        course[i] = lon2[i] + 180.0;
+        range[i]  = lat2[i] + 90.0;
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            Direct(&lat1[i], &lon1[i], &course[i], &range[i], &lat[i], &lon[i]);
+        }
+        sink = lat[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "Direct()", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        char label[40];
+
+        sprintf(label, "DirectBatch %s", names[kernel]);
+        if (BatchKernelSelect(kernel) < 0) {
+            printf("%-24s not supported by this CPU\n", label);
+            continue;
+        }
+        start = bench_seconds();
+        for (int r = 0; r < ROUNDS; r++) {
+            DirectBatch(lat1, lon1, course, range, lat, lon, PAIRS);
+            sink = lat[r];
+        }
+        elapsed = bench_seconds() - start;
+        printf("%-24s %10.1f Mpoints/s\n", label, PAIRS * (double)ROUNDS / elapsed * 1e-6);
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        DirectBatchFrom(&lat1[r], &lon1[r], course, range, lat, lon, PAIRS);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "DirectBatchFrom", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_CrossTrack(void) {
+    // Every position against one leg, against Distance() and CourseInitial() per position
+    static double xtd[PAIRS], atd[PAIRS];
+    double latA = 33.95, lonA = -118.4, latB = 40.63, lonB = -73.78;
+    double crsAB = D2R * CourseInitial(&latA, &lonA, &latB, &lonB);
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            double distAD = D2R * Distance(&latA, &lonA, &lat1[i], &lon1[i]) / 60;
+            double crsAD  = D2R * CourseInitial(&latA, &lonA, &lat1[i], &lon1[i]);
+            xtd[i] = asin(sin(distAD) * sin(crsAD - crsAB));
+            atd[i] = acos(cos(distAD) / cos(xtd[i]));
+        }
+        sink = xtd[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "avform.txt formulas", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        CrossTrackBatch(&latA, &lonA, &latB, &lonB, lat1, lon1, xtd, atd, PAIRS);
+        sink = xtd[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "CrossTrackBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_RouteMatcher(void) {
+    // Positions near a 300 leg route, against CrossTrack() on every leg
+    enum { waypoints = 301, positions = 20000 };
+    static double route_lat[waypoints], route_lon[waypoints], lat[positions], lon[positions];
+    double xtd, atd;
+    int hint = -1;
+
+    for (int i = 0; i < waypoints; i++) {
+        route_lat[i] = 40.0 + 10.0 * sin(i * 0.1);
+        route_lon[i] = -150.0 + i;
+    }
+    for (int i = 0; i < positions; i++) {
+        double fraction = (i % 60) / 60.0;
+        int k = i * (waypoints - 1) / positions;
+
+        IntermediatePoint(&route_lat[k], &route_lon[k], &route_lat[k+1], &route_lon[k+1], &fraction, &lat[i], &lon[i]);
+        lat[i] += bench_random(-0.2, 0.2);
+    }
+    RouteMatcher *route = RouteMatcherCreate(route_lat, route_lon, waypoints);
+
+    double start = bench_seconds();
+    for (int i = 0; i < positions; i++) {
+        double best = 1e9;
+        for (int k = 0; k + 1 < waypoints; k++) {
+            CrossTrack(&route_lat[k], &route_lon[k], &route_lat[k+1], &route_lon[k+1], &lat[i], &lon[i], &xtd, &atd);
+            best = (fabs(xtd) < best) ? fabs(xtd) : best;
+        }
+        sink = best;
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.3f us/position\n", "CrossTrack every leg", elapsed / positions * 1e6);
+
+    start = bench_seconds();
+    for (int i = 0; i < positions; i++) {
+        int none = -1;
+        sink = RouteMatchNearest(route, &lat[i], &lon[i], &none, &xtd, &atd);
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.3f us/position\n", "RouteMatchNearest", elapsed / positions * 1e6);
+
+    start = bench_seconds();
+    for (int i = 0; i < positions; i++) {
+        sink = RouteMatchNearest(route, &lat[i], &lon[i], &hint, &xtd, &atd);
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.3f us/position\n", "RouteMatchNearest hint", elapsed / positions * 1e6);
+
+    RouteMatcherFree(route);
+}
+
+static void bench_SphericalPolygon(void) {
+    // A 200 vertex airspace, with positions all over the globe and all near it
+    enum { vertices = 200 };
+    static double poly_lat[vertices], poly_lon[vertices], lat[PAIRS], lon[PAIRS];
+    static int inside[PAIRS];
+
+    for (int i = 0; i < vertices; i++) {
+        double a = 2 * M_PI * i / vertices;
+        poly_lat[i] = 60.0 + (4.0 + sin(7 * a)) * sin(a);
+        poly_lon[i] = 10.0 + (8.0 + 2 * sin(7 * a)) * cos(a);
+    }
+    SphericalPolygon *poly = SphericalPolygonCreate(poly_lat, poly_lon, vertices);
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        sink = SphericalPolygonContainsBatch(poly, lat1, lon1, inside, PAIRS);
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "Polygon, global points", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    for (int i = 0; i < PAIRS; i++) {
+        lat[i] = bench_random(54.0, 66.0);
+        lon[i] = bench_random(-2.0, 22.0);
+    }
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS / 10; r++) {
+        sink = SphericalPolygonContainsBatch(poly, lat, lon, inside, PAIRS);
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "Polygon, nearby points", PAIRS * (double)(ROUNDS / 10) / elapsed * 1e-6);
+
+    SphericalPolygonFree(poly);
+}
+
+static void bench_RadialIntersection(void) {
+    // Random radial pairs, scalar against batch and one radial against many
+    static double crs1[PAIRS], crs2[PAIRS], lat[PAIRS], lon[PAIRS];
+    static int status[PAIRS];
+    double lat_from = 40.0, lon_from = -100.0, crs_from = 75.0;
+
+    for (int i = 0; i < PAIRS; i++) {
+        crs1[i] = bench_random(-180.0, 180.0);
+        crs2[i] = bench_random(-180.0, 180.0);
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            status[i] = RadialIntersection(&lat1[i], &lon1[i], &crs1[i], &lat2[i], &lon2[i], &crs2[i], &lat[i], &lon[i]);
+        }
+        sink = lat[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "RadialIntersection", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        RadialIntersectionBatch(lat1, lon1, crs1, lat2, lon2, crs2, lat, lon, status, PAIRS);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "RadialIntersectionBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        RadialIntersectionBatchFrom(&lat_from, &lon_from, &crs_from, lat2, lon2, crs2, lat, lon, status, PAIRS);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "RadialIntersectionFrom", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_CrossParallel(void) {
+    // 1024 legs against 64 parallels, and the vertices of all random pairs
+    enum { legs = 1024, parallels = 64 };
+    static double lat[parallels], north[legs * parallels], south[legs * parallels], latv[PAIRS], lonv[PAIRS];
+    static int reached[PAIRS];
+
+    for (int j = 0; j < parallels; j++) {
+        lat[j] = -80.0 + 2.5 * j;
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS / 10; r++) {
+        for (int i = 0; i < legs; i++) {
+            for (int j = 0; j < parallels; j++) {
+                CrossParallel(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &lat[j], &north[i * parallels + j], &south[i * parallels + j]);
+            }
+        }
+        sink = north[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcrossings/s\n", "CrossParallel", legs * parallels * (double)(ROUNDS / 10) / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS / 10; r++) {
+        CrossParallelBatch(lat1, lon1, lat2, lon2, legs, lat, parallels, north, south);
+        sink = north[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcrossings/s\n", "CrossParallelBatch", legs * parallels * (double)(ROUNDS / 10) / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            reached[i] = LegVertex(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &latv[i], &lonv[i]);
+        }
+        sink = latv[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mlegs/s\n", "LegVertex", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        LegVertexBatch(lat1, lon1, lat2, lon2, latv, lonv, reached, PAIRS);
+        sink = latv[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mlegs/s\n", "LegVertexBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_Rhumb(void) {
+    // The formulas of avform.txt with the C library, against the scalar, prepared and batch functions
+    static PreparedPoint p1[PAIRS], p2[PAIRS];
+    static double course[PAIRS], lat[PAIRS], lon[PAIRS];
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            double phi1 = D2R * lat1[i], phi2 = D2R * lat2[i];
+            double dlon = remainder(D2R * (lon2[i] - lon1[i]), 2 * M_PI);
+            double dphi = log(tan(phi2 / 2 + M_PI / 4) / tan(phi1 / 2 + M_PI / 4));
+            double q = (fabs(phi2 - phi1) < sqrt(1e-15)) ? cos(phi1) : (phi2 - phi1) / dphi;
+
+            course[i] = atan2(dlon, dphi);
+            dist[i] = sqrt(q * q * dlon * dlon + (phi2 - phi1) * (phi2 - phi1));
+        }
+        sink = dist[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "avform.txt rhumb", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            RhumbInverse(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &dist[i], &course[i]);
+        }
+        sink = dist[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "RhumbInverse", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    PreparePoints(lat1, lon1, p1, PAIRS);
+    PreparePoints(lat2, lon2, p2, PAIRS);
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            RhumbInversePrepared(&p1[i], &p2[i], &dist[i], &course[i]);
+        }
+        sink = dist[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "RhumbInversePrepared", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        RhumbInverseBatch(lat1, lon1, lat2, lon2, dist, course, PAIRS);
+        sink = dist[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "RhumbInverseBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        RhumbDirectBatch(lat1, lon1, course, dist, lat, lon, PAIRS);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "RhumbDirectBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_LocalFrame(void) {
+    // Positions within 50 nm of an airport, against Distance() and CourseInitial()
+    static double lat[PAIRS], lon[PAIRS], north[PAIRS], east[PAIRS], range[PAIRS], bearing[PAIRS];
+    double lat0 = 40.63, lon0 = -73.78;
+    LocalFrame frame;
+
+    for (int i = 0; i < PAIRS; i++) {
+        lat[i] = lat0 + bench_random(-0.6, 0.6);
+        lon[i] = lon0 + bench_random(-0.8, 0.8);
+    }
+    LocalFrameInit(&lat0, &lon0, AVCALC_EARTH_SPHERE, &frame);
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            range[i]   = Distance(&lat0, &lon0, &lat[i], &lon[i]);
+            bearing[i] = CourseInitial(&lat0, &lon0, &lat[i], &lon[i]);
+        }
+        sink = range[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "Distance+CourseInitial", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        LocalFrameRange(&frame, lat, lon, range, bearing, PAIRS);
+        sink = range[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "LocalFrameRange", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        LocalFrameToNE(&frame, lat, lon, north, east, PAIRS);
+        sink = north[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "LocalFrameToNE", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_ConflictDetect(void) {
+    // Traffic over a 1500 nm region, brute force against the spatial hash
+    enum { aircraft = 4000, capacity = 100000 };
+    static double lat[aircraft], lon[aircraft], track[aircraft], speed[aircraft];
+    static int first[capacity], second[capacity];
+    static double tcpa[capacity], dcpa[capacity];
+    static const int threads[] = {1, 4};
+    double lookahead = 300.0, separation = 5.0;
+    int count = 0;
+
+    for (int i = 0; i < aircraft; i++) {
+        lat[i]   = bench_random(40.0, 60.0);
+        lon[i]   = bench_random(-10.0, 25.0);
+        track[i] = bench_random(0.0, 360.0);
+        speed[i] = bench_random(250.0, 500.0);
+    }
+
+    double start = bench_seconds();
+    for (int i = 0; i < aircraft; i++) {
+        for (int j = i + 1; j < aircraft; j++) {
+            double t;
+            double d = ClosestApproach(&lat[i], &lon[i], &track[i], &speed[i], &lat[j], &lon[j], &track[j], &speed[j], &lookahead, &t);
+            count += d < separation;
+        }
+    }
+    double elapsed = bench_seconds() - start;
+    double pairs = aircraft * (aircraft - 1) / 2.0;
+    sink = count;
+    printf("%-24s %10.1f Mpairs/s\n", "ClosestApproach all", pairs / elapsed * 1e-6);
+
+    for (int t = 0; t < 2; t++) {
+        char label[40];
+
+        sprintf(label, "ConflictDetect %d thr", threads[t]);
+        start = bench_seconds();
+        for (int r = 0; r < 10; r++) {
+            count = ConflictDetect(lat, lon, track, speed, aircraft, &lookahead, &separation, first, second, tcpa, dcpa, capacity, threads[t]);
+        }
+        elapsed = (bench_seconds() - start) / 10;
+        sink = count;
+        printf("%-24s %10.1f Mpairs/s\n", label, pairs / elapsed * 1e-6);
+    }
+}
+
+static void bench_PointIndex(void) {
+    // Nearest of 200k fixes, a scan of Distance() against the index
+    enum { fixes = 200000, queries = 20000, k = 8 };
+    static double lat[fixes], lon[fixes], qlat[queries], qlon[queries], dist[queries * k];
+    static int found[queries * k], count[queries];
+    double radius = 25.0;
+
+    for (int i = 0; i < fixes; i++) {
+        lat[i] = bench_random(-70.0, 75.0);
+        lon[i] = bench_random(-180.0, 180.0);
+    }
+    for (int q = 0; q < queries; q++) {
+        qlat[q] = bench_random(-70.0, 75.0);
+        qlon[q] = bench_random(-180.0, 180.0);
+    }
+
+    double start = bench_seconds();
+    for (int q = 0; q < 200; q++) {
+        double best = 1e9;
+        for (int i = 0; i < fixes; i++) {
+            double d = Distance(&qlat[q], &qlon[q], &lat[i], &lon[i]);
+            best = (d < best) ? d : best;
+        }
+        sink = best;
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Kqueries/s\n", "Nearest by scan", 200 / elapsed * 1e-3);
+
+    start = bench_seconds();
+    PointIndex *index = PointIndexCreate(lat, lon, fixes);
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f ms\n", "PointIndexCreate", elapsed * 1e3);
+
+    start = bench_seconds();
+    for (int q = 0; q < queries; q++) {
+        PointIndexNearest(index, &qlat[q], &qlon[q], 1, &found[q], &dist[q]);
+    }
+    elapsed = bench_seconds() - start;
+    sink = dist[0];
+    printf("%-24s %10.1f Kqueries/s\n", "PointIndexNearest k=1", queries / elapsed * 1e-3);
+
+    start = bench_seconds();
+    PointIndexNearestBatch(index, qlat, qlon, queries, k, found, dist, 4);
+    elapsed = bench_seconds() - start;
+    sink = dist[0];
+    printf("%-24s %10.1f Kqueries/s\n", "PointIndexNearestBatch 8", queries / elapsed * 1e-3);
+
+    start = bench_seconds();
+    PointIndexWithinBatch(index, qlat, qlon, queries, &radius, count, found, dist, k, 4);
+    elapsed = bench_seconds() - start;
+    sink = count[0];
+    printf("%-24s %10.1f Kqueries/s\n", "PointIndexWithinBatch", queries / elapsed * 1e-3);
+    PointIndexFree(index);
+}
+
+static void bench_Route(void) {
+    // Position at a distance along a 200 waypoint route, summing Distance()
+    // over the legs against the running sums of a Route
+    enum { waypoints = 200, queries = 100000 };
+    static double lat[waypoints], lon[waypoints], d[queries], plat[queries], plon[queries];
+    double total = 0.0;
+
+    for (int i = 0; i < waypoints; i++) {
+        lat[i] = 40.0 + 10.0 * sin(i * 0.05);
+        lon[i] = -120.0 + 0.9 * i;
+    }
+    Route *route = RouteCreate(lat, lon, waypoints);
+    total = RouteLength(route);
+    for (int q = 0; q < queries; q++) {
+        d[q] = bench_random(0.0, total);
+    }
+
+    double start = bench_seconds();
+    for (int q = 0; q < queries / 10; q++) {
+        double along = 0.0, leg = 0.0, fraction;
+        int i = 0;
+        for (; i < waypoints - 1; i++) {
+            leg = Distance(&lat[i], &lon[i], &lat[i + 1], &lon[i + 1]);
+            if (along + leg >= d[q]) break;
+            along += leg;
+        }
+        fraction = (d[q] - along) / leg;
+        IntermediatePoint(&lat[i], &lon[i], &lat[i + 1], &lon[i + 1], &fraction, &plat[q], &plon[q]);
+    }
+    double elapsed = bench_seconds() - start;
+    sink = plat[0];
+    printf("%-24s %10.1f Mqueries/s\n", "Distance sum", queries / 10 / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int q = 0; q < queries; q++) {
+        RoutePositionAt(route, &d[q], &plat[q], &plon[q], NULL);
+    }
+    elapsed = bench_seconds() - start;
+    sink = plat[0];
+    printf("%-24s %10.1f Mqueries/s\n", "RoutePositionAt", queries / elapsed * 1e-6);
+
+    start = bench_seconds();
+    RoutePositionAtBatch(route, d, plat, plon, NULL, NULL, queries);
+    elapsed = bench_seconds() - start;
+    sink = plat[0];
+    printf("%-24s %10.1f Mqueries/s\n", "RoutePositionAtBatch", queries / elapsed * 1e-6);
+    RouteFree(route);
+}
+
+static void bench_Geodesic(void) {
+    // WGS-84 geodesics over the global pairs, against the spherical Distance()
+    static double course1[PAIRS], course2[PAIRS], lat[PAIRS], lon[PAIRS];
+    enum { rounds = ROUNDS / 10 };
+
+    double start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            dist[i] = Distance(&lat1[i], &lon1[i], &lat2[i], &lon2[i]);
+        }
+        sink = dist[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "Distance", PAIRS * (double)rounds / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            GeodesicInverse(&lat1[i], &lon1[i], &lat2[i], &lon2[i], AVCALC_EARTH_WGS84, &dist[i], &course1[i], &course2[i]);
+        }
+        sink = dist[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "GeodesicInverse", PAIRS * (double)rounds / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        GeodesicInverseBatch(lat1, lon1, lat2, lon2, AVCALC_EARTH_WGS84, dist, course1, course2, PAIRS);
+        sink = dist[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpairs/s\n", "GeodesicInverseBatch", PAIRS * (double)rounds / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        GeodesicDirectBatch(lat1, lon1, course1, dist, AVCALC_EARTH_WGS84, lat, lon, course2, PAIRS);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "GeodesicDirectBatch", PAIRS * (double)rounds / elapsed * 1e-6);
+}
+
+static void bench_EcefConversion(void) {
+    // Round trip of radar plots between WGS-84 geodetic and ECEF coordinates
+    static double height[PAIRS], x[PAIRS], y[PAIRS], z[PAIRS], lat[PAIRS], lon[PAIRS];
+
+    for (int i = 0; i < PAIRS; i++) {
+        height[i] = bench_random(0.0, 8.0);
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        GeodeticToEcef(lat1, lon1, height, AVCALC_EARTH_WGS84, x, y, z, PAIRS);
+        sink = x[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "GeodeticToEcef", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        EcefToGeodetic(x, y, z, AVCALC_EARTH_WGS84, lat, lon, height, PAIRS);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mpoints/s\n", "EcefToGeodetic", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_Atmosphere(void) {
+    // Standard atmosphere over altitudes spread across every band
+    static double h[PAIRS], result[PAIRS];
+    double oat = 0.0;
+
+    for (int i = 0; i < PAIRS; i++) {
+        h[i] = bench_random(-16000.0, 262000.0);
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            result[i] = Standard_temperature(&h[i]);
+        }
+        sink = result[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "Standard_temperature", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            result[i] = Pressure_at_altitude(&h[i]);
+        }
+        sink = result[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "Pressure_at_altitude", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            result[i] = Density_at_altitude(&h[i], &oat);
+        }
+        sink = result[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "Density_at_altitude", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    // The whole state: four scalar calls against one batch pass
+    static double T[PAIRS], p[PAIRS], rho[PAIRS], a[PAIRS], sigma[PAIRS];
+    AtmosphereState state = {T, p, rho, a, sigma};
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            T[i]     = Standard_temperature(&h[i]);
+            p[i]     = Pressure_at_altitude(&h[i]);
+            rho[i]   = Density_at_altitude(&h[i], &T[i]);
+            a[i]     = Speed_of_sound(&T[i]);
+            sigma[i] = rho[i] / rho_0;
+        }
+        sink = sigma[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mstates/s\n", "State, scalar calls", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        AtmosphereStateBatch(h, NULL, &state, PAIRS);
+        sink = sigma[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mstates/s\n", "AtmosphereStateBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    // Pressure and density by table lookup
+    double step = AVCALC_ATMOSPHERE_TABLE_STEP, none = 0.0;
+    double bound = AtmosphereTableSelect(&step);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            result[i] = Pressure_at_altitude(&h[i]);
+        }
+        sink = result[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s  (error %.1e)\n", "Pressure, table", PAIRS * (double)ROUNDS / elapsed * 1e-6, bound);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            result[i] = Density_at_altitude(&h[i], &oat);
+        }
+        sink = result[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "Density, table", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+    AtmosphereTableSelect(&none);
+}
+
+static void bench_Airspeed(void) {
+    // Flight data samples of an airliner, Mach 0.2 to 0.85 across the altitudes of a flight
+    static double cas[PAIRS], pa[PAIRS], oat[PAIRS], tas[PAIRS], back[PAIRS];
+
+    for (int i = 0; i < PAIRS; i++) {
+        pa[i]  = bench_random(0.0, 41000.0);
+        oat[i] = Standard_temperature(&pa[i]) + bench_random(-10.0, 10.0);
+        tas[i] = bench_random(0.2, 0.85) * Speed_of_sound(&oat[i]);
+        cas[i] = CAS_2(&tas[i], &pa[i], &oat[i]);
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            tas[i] = TAS_2(&cas[i], &pa[i], &oat[i]);
+        }
+        sink = tas[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "TAS_2", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        TrueAirspeedBatch(cas, pa, oat, tas, PAIRS);
+        sink = tas[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mconv/s\n", "TrueAirspeedBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            back[i] = CAS_2(&tas[i], &pa[i], &oat[i]);
+        }
+        sink = back[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "CAS_2", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        CalibratedAirspeedBatch(tas, pa, oat, back, PAIRS);
+        sink = back[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mconv/s\n", "CalibratedAirspeedBatch", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+}
+
+static void bench_AirspeedConvert(void) {
+    // Flight data samples sorted by flight level: 40 levels, each with its OAT, Mach 0.2 to 0.85
+    static double cas[PAIRS], pa[PAIRS], oat[PAIRS], tas[PAIRS];
+    AirDataCache *cache = AirDataCacheCreate(64);
+
+    for (int i = 0; i < PAIRS; i++) {
+        int level = i * 40 / PAIRS;
+
+        pa[i]  = 1000.0 * level;
+        oat[i] = Standard_temperature(&pa[i]) + 5.0;
+        tas[i] = bench_random(0.2, 0.85) * Speed_of_sound(&oat[i]);
+        cas[i] = CAS_2(&tas[i], &pa[i], &oat[i]);
+    }
+
+    double start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            tas[i] = TAS_2(&cas[i], &pa[i], &oat[i]);
+        }
+        sink = tas[r];
+    }
+    double elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "TAS_2", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+            tas[i] = AirspeedConvert(AirDataCacheGet(cache, &pa[i], &oat[i]), AVCALC_SPEED_CAS, AVCALC_SPEED_TAS, &cas[i]);
+        }
+        sink = tas[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mcalls/s\n", "AirspeedConvert, cached", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        AirspeedConvertLevels(cache, pa, oat, AVCALC_SPEED_CAS, AVCALC_SPEED_TAS, cas, tas, PAIRS);
+        sink = tas[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mconv/s\n", "AirspeedConvertLevels", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+
+    start = bench_seconds();
+    for (int r = 0; r < ROUNDS; r++) {
+        AirspeedConvertLevels(cache, pa, oat, AVCALC_SPEED_TAS, AVCALC_SPEED_MACH, tas, cas, PAIRS);
+        sink = cas[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f Mconv/s\n", "Levels, TAS to Mach", PAIRS * (double)ROUNDS / elapsed * 1e-6);
+    AirDataCacheFree(cache);
+}
+
+static void bench_MathBatch(void) {
+    static const char *functions[] = {"sin", "cos", "asin", "atan2", "exp", "log", "pow", "fmod"};
+    static const char *tiers[] = {"full", "nav", "display"};
+    // Arguments inside the documented range of every function
+    static double x[PAIRS], y[PAIRS];
+
+    for (int i = 0; i < PAIRS; i++) {
+        x[i] = bench_random(0.1, 1.0);
+        y[i] = bench_random(0.5, 6.0);
+    }
+
+    printf("\n%-8s %12s %12s %12s %12s   (Mvalues/s)\n", "", "libm", tiers[0], tiers[1], tiers[2]);
+    for (int f = AVCALC_MATH_SIN; f <= AVCALC_MATH_FMOD; f++) {
+        double rate[4];
+
+        double start = bench_seconds();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < PAIRS; i++) {
+                switch (f) {
+                case AVCALC_MATH_SIN:   dist[i] = sin(x[i]);         break;
+                case AVCALC_MATH_COS:   dist[i] = cos(x[i]);         break;
+                case AVCALC_MATH_ASIN:  dist[i] = asin(x[i]);        break;
+                case AVCALC_MATH_ATAN2: dist[i] = atan2(x[i], y[i]); break;
+                case AVCALC_MATH_EXP:   dist[i] = exp(x[i]);         break;
+                case AVCALC_MATH_LOG:   dist[i] = log(x[i]);         break;
+                case AVCALC_MATH_POW:   dist[i] = pow(x[i], y[i]);   break;
+                default:                dist[i] = fmod(y[i], x[i]);  break;
+                }
+            }
+            sink = dist[r];
+        }
+        rate[0] = PAIRS * (double)ROUNDS / (bench_seconds() - start) * 1e-6;
+
+        for (int tier = AVCALC_ACCURACY_FULL; tier <= AVCALC_ACCURACY_DISPLAY; tier++) {
+            start = bench_seconds();
+            for (int r = 0; r < ROUNDS; r++) {
+                if (f == AVCALC_MATH_FMOD) {
+                    MathBatch(f, y, x, dist, PAIRS, tier);
+                } else {
+                    MathBatch(f, x, y, dist, PAIRS, tier);
+                }
+                sink = dist[r];
+            }
+            rate[tier + 1] = PAIRS * (double)ROUNDS / (bench_seconds() - start) * 1e-6;
+        }
+        printf("%-8s %12.1f %12.1f %12.1f %12.1f\n", functions[f], rate[0], rate[1], rate[2], rate[3]);
+    }
+    printf("\n");
+}
+
+static void bench_IntermediatePoints(void) {
+    // A 5000 nm leg at 0.1 nm spacing, against one IntermediatePoint() per point
+    enum { legs = 20 };
+    double latA = 0.0, lonA = 0.0, latB = 0.0, lonB = 5000.0 / 60.0;
+    double spacing = 0.1;
+    int n = IntermediatePointsSpacing(&latA, &lonA, &latB, &lonB, &spacing, NULL, NULL, 0);
+    double *lat = (double *)malloc(sizeof(double) * n);
+    double *lon = (double *)malloc(sizeof(double) * n);
+
+    if (lat == NULL || lon == NULL) {
+        printf("IntermediatePoints: out of memory\n");
+        free(lat);
+        free(lon);
+        return;
+    }
+
+    double start = bench_seconds();
+    for (int i = 0; i < n; i++) {
+        double fraction = i / (n - 1.0);
+        IntermediatePoint(&latA, &lonA, &latB, &lonB, &fraction, &lat[i], &lon[i]);
+    }
+    double elapsed = bench_seconds() - start;
+    sink = lat[n / 2];
+    printf("%-24s %10.1f us/leg (%d points)\n", "IntermediatePoint()", elapsed * 1e6, n);
+
+    start = bench_seconds();
+    for (int r = 0; r < legs; r++) {
+        IntermediatePointsSpacing(&latA, &lonA, &latB, &lonB, &spacing, lat, lon, n);
+        sink = lat[r];
+    }
+    elapsed = bench_seconds() - start;
+    printf("%-24s %10.1f us/leg\n", "IntermediatePointsSpacing", elapsed / legs * 1e6);
+
+    free(lat);
+    free(lon);
+}
+
+static void bench_DistanceMatrix(void) {
+    // Rows from the first pair array, columns from the second
+    enum { rows = 2000, cols = 5000 };
+    double *matrix = (double *)malloc(sizeof(double) * rows * cols);
+    static const int threads[] = {1, 4};
+
+    if (matrix == NULL) {
+        printf("DistanceMatrix: out of memory\n");
+        return;
+    }
+    for (int t = 0; t < 2; t++) {
+        char label[40];
+
+        sprintf(label, "DistanceMatrix %d thr", threads[t]);
+        double start = bench_seconds();
+        DistanceMatrix(lat1, lon1, rows, lat2, lon2, cols, matrix, threads[t]);
+        double elapsed = bench_seconds() - start;
+        sink = matrix[rows];
+        printf("%-24s %10.1f Mpairs/s\n", label, rows * (double)cols / elapsed * 1e-6);
+    }
+    free(matrix);
+}
+
+int main() {
+    printf("AvCalc benchmark, %d pairs x %d rounds\n", PAIRS, ROUNDS);
+    printf("--------------------------------------------------\n");
+
+    srand(1);
+    for (int i = 0; i < PAIRS; i++) {
+        lat1[i] = bench_random(-90.0, 90.0);
+        lon1[i] = bench_random(-180.0, 180.0);
+        lat2[i] = bench_random(-90.0, 90.0);
+        lon2[i] = bench_random(-180.0, 180.0);
+    }
+
+    bench_Distance();
+    bench_DistancePrepared();
+    bench_DistanceBatch();
+    bench_Inverse();
+    bench_Direct();
+    bench_CrossTrack();
+    bench_RouteMatcher();
+    bench_SphericalPolygon();
+    bench_RadialIntersection();
+    bench_CrossParallel();
+    bench_Rhumb();
+    bench_LocalFrame();
+    bench_ConflictDetect();
+    bench_PointIndex();
+    bench_Route();
+    bench_Geodesic();
+    bench_EcefConversion();
+    bench_Atmosphere();
+    bench_Airspeed();
+    bench_AirspeedConvert();
+    bench_DistanceMatrix();
+    bench_IntermediatePoints();
+    bench_MathBatch();
+    return 0;
+}
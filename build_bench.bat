@@ -0,0 +1,17 @@
+@echo off
+REM filepath: build_bench.bat
+if not exist ".\bin" mkdir ".\bin"
+
+echo Building AvCalc benchmark...
+gcc -O3 -fno-math-errno AvCalc.c AvCalc_bench.c -o bin\AvCalc_bench.exe -lm
+
+if %ERRORLEVEL% neq 0 (
+    echo Build failed
+    exit /b %ERRORLEVEL%
+)
+
+echo Build successful!
+echo Running benchmark...
+echo.
+bin\AvCalc_bench.exe
+pause
@@ -3,7 +3,7 @@ REM filepath: build_dll.bat
 if not exist ".\bin" mkdir ".\bin"
 
 echo Building AvCalc.dll...
-gcc -D BUILD_DLL -shared -o bin\AvCalc.dll AvCalc.c -lm
+gcc -O3 -fno-math-errno -D BUILD_DLL -shared -o bin\AvCalc.dll AvCalc.c -lm
 
 if %ERRORLEVEL% neq 0 (
     echo DLL build failed with error code %ERRORLEVEL%.
@@ -1,6 +1,7 @@
 #include "unity.h"
 #include "../AvCalc.h"
 #include <math.h>
+#include <stdio.h>
 
 void setUp(void) {
     // Run before each test
@@ -10,7 +11,16 @@ void tearDown(void) {
     // Run after each test
 }
 
-void test_Distance(void) {
+// Evaluates the distance for n pairs of points in one call
+typedef void (AVCALCCALL *distance_eval_fn)(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n);
+
+static void AVCALCCALL distance_each(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *dist, int n) {
+    for (int i = 0; i < n; i++) {
+        dist[i] = Distance(&lat1[i], &lon1[i], &lat2[i], &lon2[i]);
+    }
+}
+
+static void check_distance_table(distance_eval_fn eval, const char *label) {
     // Test various known distances between latitude/longitude points
     // Expected distances have been pre-calculated using Ed Williams 
     // Great Circle Calculator (http://edwilliams.org/gccalc.htm)
@@ -115,21 +125,32 @@ void test_Distance(void) {
          {67.269559610, 14.369525560}, 0.003750/ 1852, "Very small distance"} //Positions are 3.750 mm apart (3.764 mm WGS84, 3.803 in ArcGIS) 
     };
     
-    int num_cases = sizeof(test_cases) / sizeof(test_cases[0]);
-    char message[100];
+    enum { num_cases = sizeof(test_cases) / sizeof(test_cases[0]) };
+    double lat1[num_cases], lon1[num_cases], lat2[num_cases], lon2[num_cases], dist[num_cases];
+    char message[160];
 
     for (int i = 0; i < num_cases; i++) {
-        double dist = Distance(&test_cases[i].from.lat, &test_cases[i].from.lon,
-                               &test_cases[i].to.lat, &test_cases[i].to.lon);
-        sprintf(message, "Case %d: %s", i, test_cases[i].description);
+        lat1[i] = test_cases[i].from.lat;
+        lon1[i] = test_cases[i].from.lon;
+        lat2[i] = test_cases[i].to.lat;
+        lon2[i] = test_cases[i].to.lon;
+    }
+    eval(lat1, lon1, lat2, lon2, dist, num_cases);
+
+    for (int i = 0; i < num_cases; i++) {
+        sprintf(message, "%s case %d: %s", label, i, test_cases[i].description);
         TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(
             expectedAccuracy,                 // Test for value within expected accuracy of expected value
             test_cases[i].expected_dist, 
-            dist,
+            dist[i],
             message
         );
     }
-    
+}
+
+void test_Distance(void) {
+    check_distance_table(distance_each, "Distance");
+
     double lat1 = 33.95;
     double lon1 = -118.4;
     double lat2 = 40.633333;
@@ -140,6 +161,191 @@ void test_Distance(void) {
     TEST_ASSERT_DOUBLE_WITHIN(5.0, 2144.0, dist);
 }
 
+// Fills lat/lon with n pseudo random points covering the whole earth
+static void random_points(double *lat, double *lon, int n, unsigned int seed) {
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u; lat[i] = (seed >> 8) * (180.0 / 16777216.0) - 90.0;
+        seed = seed * 1103515245u + 12345u; lon[i] = (seed >> 8) * (360.0 / 16777216.0) - 180.0;
+    }
+}
+
+void test_DistanceBatch(void) {
+    // The Distance table must pass on every kernel the CPU supports, and all
+    // kernels must agree with each other and with Distance()
+    static const char *names[] = {"Auto", "Scalar", "AVX2", "AVX-512"};
+    enum { n = 1003 };
+    static double lat1[n], lon1[n], lat2[n], lon2[n], dist[n], reference[n];
+
+    random_points(lat1, lon1, n, 12345);
+    random_points(lat2, lon2, n, 54321);
+
+    TEST_ASSERT_EQUAL_INT(AVCALC_KERNEL_SCALAR, BatchKernelSelect(AVCALC_KERNEL_SCALAR));
+    DistanceBatch(lat1, lon1, lat2, lon2, reference, n);
+    for (int i = 0; i < n; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, Distance(&lat1[i], &lon1[i], &lat2[i], &lon2[i]), reference[i]);
+    }
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) < 0) {
+            printf("%s kernel not supported by this CPU, skipped\n", names[kernel]);
+            continue;
+        }
+        TEST_ASSERT_EQUAL_INT(kernel, BatchKernelActive());
+        check_distance_table(DistanceBatch, names[kernel]);
+
+        DistanceBatch(lat1, lon1, lat2, lon2, dist, n);
+        for (int i = 0; i < n; i++) {
+            TEST_ASSERT_DOUBLE_WITHIN(1e-12, reference[i], dist[i]);
+        }
+    }
+
+    TEST_ASSERT_NOT_EQUAL(-1, BatchKernelSelect(AVCALC_KERNEL_AUTO));
+}
+
+void test_DistanceMatrix(void) {
+    // Sizes chosen to cross the tile boundaries in both directions
+    enum { n = 70, m = 600 };
+    static double lat1[n], lon1[n], lat2[m], lon2[m], dist[n * m];
+    double expected;
+    char message[100];
+
+    random_points(lat1, lon1, n, 1);
+    random_points(lat2, lon2, m, 2);
+    lat1[0] = 90.0;  lat2[0] = -90.0;   // Pole to pole
+    lat1[1] = 10.0;  lon1[1] = 179.9;   // Across the antimeridian
+    lat2[1] = 10.0;  lon2[1] = -179.9;
+
+    TEST_ASSERT_EQUAL_INT(0, DistanceMatrix(lat1, lon1, n, lat2, lon2, m, dist, 3));
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            DistanceBatch(&lat1[i], &lon1[i], &lat2[j], &lon2[j], &expected, 1);
+            sprintf(message, "Element [%d][%d]", i, j);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, expected, dist[i * m + j], message);
+        }
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10800.0, dist[0]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, 12.0 * cos(10.0 * D2R), dist[m + 1]);
+}
+
+void test_DistanceMatrixSymmetric(void) {
+    enum { n = 600 };
+    static double lat[n], lon[n], dist[n * n];
+    double expected;
+
+    random_points(lat, lon, n, 3);
+    for (int k = 0; k < n * n; k++) {
+        dist[k] = -1.0;
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, DistanceMatrixSymmetric(lat, lon, n, dist, 4));
+    for (int i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_DOUBLE(0.0, dist[i * n + i]);
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT_EQUAL_DOUBLE(-1.0, dist[i * n + j]);   // Lower triangle untouched
+        }
+        for (int j = i + 1; j < n; j += 7) {
+            DistanceBatch(&lat[i], &lon[i], &lat[j], &lon[j], &expected, 1);
+            TEST_ASSERT_DOUBLE_WITHIN(1e-9, expected, dist[i * n + j]);
+        }
+    }
+}
+
+void test_MathBatch(void) {
+    // Maximum errors against the C library, as documented in AvCalc.c
+    static const struct {
+        int function;
+        double x_lo, x_hi;      // Range of x, or of log10(x) when log_x is set
+        double y_lo, y_hi;
+        int log_x;
+        int relative;
+        double max_error[3];    // FULL, NAV, DISPLAY
+        const char *description;
+    } cases[] = {
+        {AVCALC_MATH_SIN,   -100.0, 100.0,  0.0, 0.0,     0, 0, {3e-16, 1e-10, 1e-6}, "sin"},
+        {AVCALC_MATH_COS,   -100.0, 100.0,  0.0, 0.0,     0, 0, {3e-16, 1e-10, 1e-6}, "cos"},
+        {AVCALC_MATH_ASIN,    -1.0,   1.0,  0.0, 0.0,     0, 0, {5e-16, 2e-10, 6e-8}, "asin"},
+        {AVCALC_MATH_ATAN2,   -1.0,   1.0, -1.0, 1.0,     0, 0, {5e-16, 2e-10, 2e-7}, "atan2"},
+        {AVCALC_MATH_EXP,   -708.0, 708.0,  0.0, 0.0,     0, 1, {3e-16, 6e-11, 2e-7}, "exp"},
+        {AVCALC_MATH_LOG,   -300.0, 300.0,  0.0, 0.0,     1, 1, {1e-15, 1e-11, 2e-7}, "log"},
+        {AVCALC_MATH_LOG,     -0.3,   0.3,  0.0, 0.0,     1, 1, {1e-15, 1e-11, 2e-7}, "log near 1"},
+        {AVCALC_MATH_POW,      0.1,   2.0, -6.0, 6.0,     0, 1, {3e-15, 1e-10, 4e-7}, "pow"},
+        {AVCALC_MATH_FMOD,   -20.0,  20.0, 2*M_PI, 2*M_PI, 0, 0, {0.0, 0.0, 0.0},     "fmod"},
+    };
+    static const char *kernel_names[] = {"Auto", "Scalar", "AVX2", "AVX-512"};
+    enum { n = 20001 };
+    static double x[n], y[n], result[n];
+    char message[120];
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) < 0) {
+            continue;
+        }
+        for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++) {
+            unsigned int seed = 99;
+
+            for (int i = 0; i < n; i++) {
+                seed = seed * 1103515245u + 12345u;
+                x[i] = cases[c].x_lo + (cases[c].x_hi - cases[c].x_lo) * (seed >> 8) / 16777216.0;
+                seed = seed * 1103515245u + 12345u;
+                y[i] = cases[c].y_lo + (cases[c].y_hi - cases[c].y_lo) * (seed >> 8) / 16777216.0;
+                if (cases[c].log_x) {
+                    x[i] = pow(10.0, x[i]);
+                }
+                if (cases[c].function == AVCALC_MATH_ATAN2) {
+                    x[i] *= pow(10.0, 6.0 * (i % 7) / 6.0 - 3.0);   // Spread the ratio y/x
+                }
+            }
+            x[0] = cases[c].x_lo;
+            x[1] = cases[c].x_hi;
+
+            for (int tier = AVCALC_ACCURACY_FULL; tier <= AVCALC_ACCURACY_DISPLAY; tier++) {
+                double max_error = 0.0;
+
+                TEST_ASSERT_EQUAL_INT(0, MathBatch(cases[c].function, x, y, result, n, tier));
+                for (int i = 0; i < n; i++) {
+                    double expected, error;
+
+                    switch (cases[c].function) {
+                    case AVCALC_MATH_SIN:   expected = sin(x[i]);         break;
+                    case AVCALC_MATH_COS:   expected = cos(x[i]);         break;
+                    case AVCALC_MATH_ASIN:  expected = asin(x[i]);        break;
+                    case AVCALC_MATH_ATAN2: expected = atan2(x[i], y[i]); break;
+                    case AVCALC_MATH_EXP:   expected = exp(x[i]);         break;
+                    case AVCALC_MATH_LOG:   expected = log(x[i]);         break;
+                    case AVCALC_MATH_POW:   expected = pow(x[i], y[i]);   break;
+                    default:                expected = fmod(x[i], y[i]);  break;
+                    }
+                    error = fabs(result[i] - expected);
+                    if (cases[c].relative && expected != 0.0) {
+                        error /= fabs(expected);
+                    }
+                    max_error = (error > max_error) ? error : max_error;
+                }
+                sprintf(message, "%s kernel, %s, tier %d: max error %.3g", kernel_names[kernel],
+                        cases[c].description, tier, max_error);
+                TEST_ASSERT_TRUE_MESSAGE(max_error <= cases[c].max_error[tier], message);
+            }
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+
+    // The global tier is used when AVCALC_ACCURACY_GLOBAL is given
+    double expected[4], angles[4] = {0.1, 1.0, 2.0, 3.0};
+    TEST_ASSERT_EQUAL_INT(AVCALC_ACCURACY_FULL, AccuracyActive());
+    TEST_ASSERT_EQUAL_INT(AVCALC_ACCURACY_DISPLAY, AccuracySelect(AVCALC_ACCURACY_DISPLAY));
+    MathBatch(AVCALC_MATH_SIN, angles, NULL, expected, 4, AVCALC_ACCURACY_DISPLAY);
+    MathBatch(AVCALC_MATH_SIN, angles, NULL, result, 4, AVCALC_ACCURACY_GLOBAL);
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_DOUBLE(expected[i], result[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(AVCALC_ACCURACY_FULL, AccuracySelect(AVCALC_ACCURACY_FULL));
+
+    // Invalid arguments
+    TEST_ASSERT_EQUAL_INT(-1, AccuracySelect(3));
+    TEST_ASSERT_EQUAL_INT(-1, MathBatch(99, angles, NULL, result, 4, AVCALC_ACCURACY_FULL));
+    TEST_ASSERT_EQUAL_INT(-1, MathBatch(AVCALC_MATH_SIN, angles, NULL, result, 4, 5));
+}
+
 void test_CourseInitial_LAX_to_JFK(void) {
     double lat1 = 33.95;
     double lon1 = -118.4;
@@ -165,6 +371,1261 @@ void test_IntermediatePoint(void) {
     TEST_ASSERT_DOUBLE_WITHIN(0.05, -101.62617, lon_result);
 }
 
+void test_PreparedPoint(void) {
+    // The prepared variants must agree with the plain functions
+    enum { n = 500 };
+    static double lat[n], lon[n];
+    static PreparedPoint points[n];
+    double fraction = 0.3;
+    char message[100];
+
+    random_points(lat, lon, n, 7);
+    lat[0] = 90.0;                      // From a pole
+    lat[2] = -33.0; lon[2] = 151.0;     // Across the antimeridian
+    lat[3] = -37.0; lon[3] = -175.0;
+    PreparePoints(lat, lon, points, n);
+
+    for (int i = 0; i + 1 < n; i++) {
+        double lat_expected, lon_expected, lat_result, lon_result;
+
+        sprintf(message, "Pair %d", i);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, Distance(&lat[i], &lon[i], &lat[i+1], &lon[i+1]),
+                                          DistancePrepared(&points[i], &points[i+1]), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, CourseInitial(&lat[i], &lon[i], &lat[i+1], &lon[i+1]),
+                                          CourseInitialPrepared(&points[i], &points[i+1]), message);
+
+        IntermediatePoint(&lat[i], &lon[i], &lat[i+1], &lon[i+1], &fraction, &lat_expected, &lon_expected);
+        IntermediatePointPrepared(&points[i], &points[i+1], &fraction, &lat_result, &lon_result);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat_expected, lat_result, message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lon_expected, lon_result, message);
+    }
+
+    // Coincident points give point 1 rather than NaN
+    double lat_result, lon_result;
+    IntermediatePointPrepared(&points[5], &points[5], &fraction, &lat_result, &lon_result);
+    TEST_ASSERT_EQUAL_DOUBLE(lat[5], lat_result);
+    TEST_ASSERT_EQUAL_DOUBLE(lon[5], lon_result);
+}
+
+void test_IntermediatePoints(void) {
+    // Must agree with IntermediatePoint() on every kernel
+    enum { n = 101 };
+    static double fractions[n], lat[n], lon[n];
+    double lat1 = 60.0, lon1 = 5.0, lat2 = -33.9, lon2 = 151.2;   // Bergen - Sydney
+    char message[100];
+
+    for (int i = 0; i < n; i++) {
+        fractions[i] = i / (n - 1.0);
+    }
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        IntermediatePoints(&lat1, &lon1, &lat2, &lon2, fractions, lat, lon, n);
+        for (int i = 0; i < n; i++) {
+            double lat_expected, lon_expected;
+
+            IntermediatePoint(&lat1, &lon1, &lat2, &lon2, &fractions[i], &lat_expected, &lon_expected);
+            sprintf(message, "Kernel %d, fraction %g", kernel, fractions[i]);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat_expected, lat[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lon_expected, lon[i], message);
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+
+    // Steps include both end points
+    TEST_ASSERT_EQUAL_INT(n, IntermediatePointsSteps(&lat1, &lon1, &lat2, &lon2, n - 1, lat, lon));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, lat1, lat[0]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, lon1, lon[0]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, lat2, lat[n - 1]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, lon2, lon[n - 1]);
+    TEST_ASSERT_EQUAL_INT(-1, IntermediatePointsSteps(&lat1, &lon1, &lat2, &lon2, 0, lat, lon));
+}
+
+void test_IntermediatePointsSpacing(void) {
+    // 600 nm along the equator
+    enum { n = 601 };
+    static double lat[n], lon[n];
+    double lat1 = 0.0, lon1 = 0.0, lat2 = 0.0, lon2 = 10.0;
+    double spacing = 1.0;
+
+    TEST_ASSERT_EQUAL_INT(601, IntermediatePointsSpacing(&lat1, &lon1, &lat2, &lon2, &spacing, lat, lon, n));
+    for (int i = 0; i < n; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, lat[i]);
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, i / 60.0, lon[i]);
+    }
+
+    // A shorter last step ends on point 2
+    spacing = 7.0;
+    TEST_ASSERT_EQUAL_INT(87, IntermediatePointsSpacing(&lat1, &lon1, &lat2, &lon2, &spacing, lat, lon, n));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 85 * 7.0 / 60.0, lon[85]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10.0, lon[86]);
+
+    // Arrays that are too small are filled as far as they go
+    lon[10] = -1.0;
+    TEST_ASSERT_EQUAL_INT(87, IntermediatePointsSpacing(&lat1, &lon1, &lat2, &lon2, &spacing, lat, lon, 10));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 9 * 7.0 / 60.0, lon[9]);
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, lon[10]);
+
+    // Coincident points give the point itself
+    TEST_ASSERT_EQUAL_INT(1, IntermediatePointsSpacing(&lat1, &lon1, &lat1, &lon1, &spacing, lat, lon, n));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, lon1, lon[0]);
+
+    spacing = 0.0;
+    TEST_ASSERT_EQUAL_INT(-1, IntermediatePointsSpacing(&lat1, &lon1, &lat2, &lon2, &spacing, lat, lon, n));
+}
+
+void test_Inverse(void) {
+    // Must agree with Distance() and CourseInitial(), in scalar and batch form
+    enum { n = 500 };
+    static double lat1[n], lon1[n], lat2[n], lon2[n], dist[n], initial[n], final[n];
+    char message[100];
+
+    random_points(lat1, lon1, n, 11);
+    random_points(lat2, lon2, n, 12);
+    lat1[0] =  90.0;                        // From the poles
+    lat1[1] = -90.0;
+    lat2[2] =  90.0;                        // To the poles
+    lat2[3] = -90.0;
+    lat1[4] = -33.0; lon1[4] =  151.0;      // Across the antimeridian
+    lat2[4] = -37.0; lon2[4] = -175.0;
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        InverseBatch(lat1, lon1, lat2, lon2, dist, initial, final, n);
+        for (int i = 0; i < n; i++) {
+            double d, c1, c2, reverse;
+
+            Inverse(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &d, &c1, &c2);
+            sprintf(message, "Kernel %d, pair %d", kernel, i);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, Distance(&lat1[i], &lon1[i], &lat2[i], &lon2[i]), d, message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, CourseInitial(&lat1[i], &lon1[i], &lat2[i], &lon2[i]), c1, message);
+            if (i > 3) {
+                // Final course is the reverse course turned around
+                reverse = CourseInitial(&lat2[i], &lon2[i], &lat1[i], &lon1[i]) + 180.0;
+                reverse = (reverse > 180.0) ? reverse - 360.0 : reverse;
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, reverse, c2, message);
+            }
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, d,  dist[i],    message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, c1, initial[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, c2, final[i],   message);
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+
+    // Arriving at a pole
+    TEST_ASSERT_EQUAL_DOUBLE(360.0, final[2]);
+    TEST_ASSERT_EQUAL_DOUBLE(180.0, final[3]);
+}
+
+void test_Direct(void) {
+    // Going out the initial course for the distance must end at point 2
+    enum { n = 500 };
+    static double lat1[n], lon1[n], lat2[n], lon2[n], course[n], dist[n], final[n], lat[n], lon[n];
+    double start_lat = 60.3, start_lon = 5.2;
+    char message[100];
+
+    random_points(lat1, lon1, n, 21);
+    random_points(lat2, lon2, n, 22);
+    InverseBatch(lat1, lon1, lat2, lon2, dist, course, final, n);
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        DirectBatch(lat1, lon1, course, dist, lat, lon, n);
+        for (int i = 0; i < n; i++) {
+            double lat_result, lon_result;
+
+            Direct(&lat1[i], &lon1[i], &course[i], &dist[i], &lat_result, &lon_result);
+            sprintf(message, "Kernel %d, pair %d", kernel, i);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat2[i], lat_result, message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 / cos(D2R * lat2[i]), 0.0, remainder(lon2[i] - lon_result, 360.0), message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat_result, lat[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lon_result, lon[i], message);
+        }
+
+        // Shared start point
+        DirectBatchFrom(&start_lat, &start_lon, course, dist, lat, lon, n);
+        for (int i = 0; i < n; i++) {
+            double lat_result, lon_result;
+
+            Direct(&start_lat, &start_lon, &course[i], &dist[i], &lat_result, &lon_result);
+            sprintf(message, "Kernel %d, point %d", kernel, i);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat_result, lat[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lon_result, lon[i], message);
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+
+    // Beyond a quarter of the earth along the equator, and from the North pole
+    double lat_result, lon_result, zero = 0.0, east = 90.0, south = 180.0, far = 7000.0, pole = 90.0;
+    Direct(&zero, &zero, &east, &far, &lat_result, &lon_result);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, lat_result);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 7000.0 / 60.0, lon_result);
+    Direct(&pole, &start_lon, &south, &far, &lat_result, &lon_result);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 90.0 - 7000.0 / 60.0, lat_result);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, start_lon, lon_result);
+}
+
+void test_CrossTrack(void) {
+    // Worked example of avform.txt: LAX to JFK, off course at N34:30 W116:30
+    double latA = 33.0 + 57.0/60, lonA = -(118.0 + 24.0/60);
+    double latB = 40.0 + 38.0/60, lonB = -( 73.0 + 47.0/60);
+    double latD = 34.5,           lonD = -116.5;
+    double xtd, atd;
+
+    TEST_ASSERT_EQUAL_INT(0, CrossTrack(&latA, &lonA, &latB, &lonB, &latD, &lonD, &xtd, &atd));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, 7.4523, xtd);      // Right of course
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, 99.5884, atd);
+
+    // Batch against the formulas of avform.txt on random positions
+    enum { n = 500 };
+    static double lat[n], lon[n], xtds[n], atds[n];
+    double crsAB = D2R * CourseInitial(&latA, &lonA, &latB, &lonB);
+    char message[100];
+
+    random_points(lat, lon, n, 31);
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL_INT(0, CrossTrackBatch(&latA, &lonA, &latB, &lonB, lat, lon, xtds, atds, n));
+        for (int i = 0; i < n; i++) {
+            double distAD = D2R * Distance(&latA, &lonA, &lat[i], &lon[i]) / 60;
+            double crsAD  = D2R * CourseInitial(&latA, &lonA, &lat[i], &lon[i]);
+            double x      = asin(sin(distAD) * sin(crsAD - crsAB));
+
+            sprintf(message, "Kernel %d, position %d", kernel, i);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, 60 * R2D * x, xtds[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, 60 * R2D * acos(cos(distAD) / cos(x)), fabs(atds[i]), message);
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+
+    // Behind A the along track distance is negative
+    latD = 30.0; lonD = -125.0;
+    CrossTrack(&latA, &lonA, &latB, &lonB, &latD, &lonD, &xtd, &atd);
+    TEST_ASSERT_TRUE(atd < 0.0);
+
+    // A leg of coincident points is undefined
+    TEST_ASSERT_EQUAL_INT(-1, CrossTrack(&latA, &lonA, &latA, &lonA, &latD, &lonD, &xtd, &atd));
+    TEST_ASSERT_EQUAL_INT(-1, CrossTrackBatch(&latA, &lonA, &latA, &lonA, lat, lon, xtds, atds, n));
+
+    // So is a leg between antipodal points, whose cross product is rounding noise
+    double lat1 = 10.0, lon1 = 20.0, lat2 = -10.0, lon2 = -160.0;
+    TEST_ASSERT_EQUAL_INT(-1, CrossTrack(&lat1, &lon1, &lat2, &lon2, &latD, &lonD, &xtd, &atd));
+    TEST_ASSERT_EQUAL_INT(-1, CrossTrackBatch(&lat1, &lon1, &lat2, &lon2, lat, lon, xtds, atds, n));
+}
+
+// Distance from a position to the nearest point of the leg from A to B, by brute force
+static double leg_distance(double latA, double lonA, double latB, double lonB, double lat, double lon) {
+    double xtd, atd, toA, toB;
+
+    CrossTrack(&latA, &lonA, &latB, &lonB, &lat, &lon, &xtd, &atd);
+    if (atd >= 0.0 && atd <= Distance(&latA, &lonA, &latB, &lonB)) {
+        return fabs(xtd);
+    }
+    toA = Distance(&latA, &lonA, &lat, &lon);
+    toB = Distance(&latB, &lonB, &lat, &lon);
+    return (toA < toB) ? toA : toB;
+}
+
+void test_RouteMatcher(void) {
+    // A winding route of 200 legs against brute force
+    enum { waypoints = 201, n = 2000 };
+    static double route_lat[waypoints], route_lon[waypoints], lat[n], lon[n], xtds[n], atds[n];
+    static int legs[n];
+    char message[100];
+
+    for (int i = 0; i < waypoints; i++) {
+        route_lat[i] = 40.0 + 10.0 * sin(i * 0.1);
+        route_lon[i] = -170.0 + 1.7 * i;            // Across the antimeridian
+    }
+    RouteMatcher *route = RouteMatcherCreate(route_lat, route_lon, waypoints);
+    TEST_ASSERT_NOT_NULL(route);
+
+    random_points(lat, lon, n, 41);
+    for (int i = 0; i < n; i++) {
+        double best = 1e9, xtd, atd, found;
+        int hint = (i * 7) % (waypoints - 1);       // Mostly wrong hints
+        int leg;
+
+        for (int k = 0; k + 1 < waypoints; k++) {
+            double d = leg_distance(route_lat[k], route_lon[k], route_lat[k+1], route_lon[k+1], lat[i], lon[i]);
+            best = (d < best) ? d : best;
+        }
+        leg = RouteMatchNearest(route, &lat[i], &lon[i], &hint, &xtd, &atd);
+        sprintf(message, "Position %d", i);
+        TEST_ASSERT_TRUE_MESSAGE(leg >= 0 && leg < waypoints - 1, message);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(leg, hint, message);
+        found = leg_distance(route_lat[leg], route_lon[leg], route_lat[leg+1], route_lon[leg+1], lat[i], lon[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, best, found, message);
+    }
+
+    // A flight along the route, 20 nm right of it, matched as a track
+    for (int i = 0; i < n; i++) {
+        double fraction = (i % 10) / 10.0, course = 0.0, right, dist = 20.0;
+        int k = i / 10;
+
+        IntermediatePoint(&route_lat[k], &route_lon[k], &route_lat[k+1], &route_lon[k+1], &fraction, &lat[i], &lon[i]);
+        course = CourseInitial(&lat[i], &lon[i], &route_lat[k+1], &route_lon[k+1]);
+        right = course + 90.0;
+        Direct(&lat[i], &lon[i], &right, &dist, &lat[i], &lon[i]);
+    }
+    int hint = -1;
+    TEST_ASSERT_EQUAL_INT(0, RouteMatchBatch(route, lat, lon, &hint, legs, xtds, atds, n));
+    for (int i = 0; i < n; i++) {
+        sprintf(message, "Track position %d", i);
+        if (i % 10 > 1) {   // Clear of the waypoints
+            TEST_ASSERT_EQUAL_INT_MESSAGE(i / 10, legs[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-3, 20.0, xtds[i], message);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(legs[n - 1], hint);
+
+    RouteMatcherFree(route);
+    TEST_ASSERT_NULL(RouteMatcherCreate(route_lat, route_lon, 1));
+}
+
+void test_SphericalPolygon(void) {
+    // Across the antimeridian, vertices clockwise and closed with the first vertex
+    double lat_a[] = {-10.0,  10.0,   10.0, -10.0, -10.0};
+    double lon_a[] = {170.0, 170.0, -170.0, -170.0, 170.0};
+    // Around the North pole, anticlockwise
+    double lat_p[] = {80.0, 80.0, 80.0, 80.0, 80.0, 80.0, 80.0, 80.0};
+    double lon_p[] = { 0.0, 45.0, 90.0, 135.0, 180.0, -135.0, -90.0, -45.0};
+    // An L shape
+    double lat_l[] = {0.0, 0.0, 2.0, 2.0, 6.0, 6.0};
+    double lon_l[] = {0.0, 6.0, 6.0, 2.0, 2.0, 0.0};
+    struct {
+        double *lat, *lon;
+        int vertices;
+        double lat_test, lon_test;
+        int inside;
+    } cases[] = {
+        {lat_a, lon_a, 5,  0.0,  180.0, 1},
+        {lat_a, lon_a, 5,  5.0, -175.0, 1},
+        {lat_a, lon_a, 5, -5.0,  175.0, 1},
+        {lat_a, lon_a, 5,  0.0,  165.0, 0},
+        {lat_a, lon_a, 5,  0.0,    0.0, 0},
+        {lat_a, lon_a, 5, 11.0,  180.0, 0},
+        {lat_p, lon_p, 8, 90.0,    0.0, 1},
+        {lat_p, lon_p, 8, 85.0,  123.0, 1},
+        {lat_p, lon_p, 8, 75.0,  123.0, 0},
+        {lat_p, lon_p, 8,-90.0,    0.0, 0},
+        {lat_l, lon_l, 6,  1.0,    5.0, 1},
+        {lat_l, lon_l, 6,  5.0,    1.0, 1},
+        {lat_l, lon_l, 6,  1.0,    1.0, 1},
+        {lat_l, lon_l, 6,  4.0,    4.0, 0},
+        {lat_l, lon_l, 6, -1.0,    1.0, 0},
+    };
+    char message[100];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        SphericalPolygon *poly = SphericalPolygonCreate(cases[i].lat, cases[i].lon, cases[i].vertices);
+
+        sprintf(message, "Case %d", (int)i);
+        TEST_ASSERT_NOT_NULL_MESSAGE(poly, message);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(cases[i].inside, SphericalPolygonContains(poly, &cases[i].lat_test, &cases[i].lon_test), message);
+        SphericalPolygonFree(poly);
+    }
+
+    // A convex quadrilateral against the signs of its edge normals, on every kernel
+    enum { n = 3000 };
+    static double lat[n], lon[n];
+    static int inside[n];
+    double lat_q[] = {40.0, 55.0, 60.0, 45.0};
+    double lon_q[] = {-10.0, -20.0, 15.0, 20.0};
+    PreparedPoint q[4];
+    SphericalPolygon *poly = SphericalPolygonCreate(lat_q, lon_q, 4);
+
+    PreparePoints(lat_q, lon_q, q, 4);
+    for (int i = 0; i < n; i++) {
+        lat[i] = 35.0 + 30.0 * ((i * 7919) % n) / n;
+        lon[i] = -30.0 + 60.0 * ((i * 104729) % n) / n;
+    }
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        int count = 0;
+
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        TEST_ASSERT_TRUE(SphericalPolygonContainsBatch(poly, lat, lon, inside, n) > 0);
+        for (int i = 0; i < n; i++) {
+            PreparedPoint p;
+            int expected = 1;
+
+            PreparePoint(&lat[i], &lon[i], &p);
+            for (int e = 0; e < 4; e++) {
+                const PreparedPoint *a = &q[e], *b = &q[(e + 1) % 4];
+                double side = p.x * (a->y * b->z - a->z * b->y) + p.y * (a->z * b->x - a->x * b->z) + p.z * (a->x * b->y - a->y * b->x);
+                expected = (side < 0.0) ? expected : 0;     // Clockwise, so inside is right of every edge
+            }
+            sprintf(message, "Kernel %d, position %d", kernel, i);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(expected, inside[i], message);
+            count += inside[i];
+        }
+        TEST_ASSERT_EQUAL_INT(count, SphericalPolygonContainsBatch(poly, lat, lon, inside, n));
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+    SphericalPolygonFree(poly);
+
+    TEST_ASSERT_NULL(SphericalPolygonCreate(lat_q, lon_q, 2));
+}
+
+void test_RadialIntersection(void) {
+    // Worked example of avform.txt: 51 degrees from REO and 137 degrees from BKE meet at BOI
+    double lat1 = 42.60, lon1 = -117.866, crs13 = 51.0;
+    double lat2 = 44.84, lon2 = -117.806, crs23 = 137.0;
+    double lat3, lon3, reverse;
+
+    TEST_ASSERT_EQUAL_INT(AVCALC_INTERSECT_UNIQUE, RadialIntersection(&lat1, &lon1, &crs13, &lat2, &lon2, &crs23, &lat3, &lon3));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-4, R2D * 0.760473, lat3);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-4, -R2D * 2.027876, lon3);
+
+    // Radials that diverge, and radials along the same great circle
+    reverse = crs23 - 180.0;
+    TEST_ASSERT_EQUAL_INT(AVCALC_INTERSECT_AMBIGUOUS, RadialIntersection(&lat1, &lon1, &crs13, &lat2, &lon2, &reverse, &lat3, &lon3));
+    TEST_ASSERT_TRUE(isnan(lat3));
+    crs13 = CourseInitial(&lat1, &lon1, &lat2, &lon2);
+    reverse = CourseInitial(&lat2, &lon2, &lat1, &lon1);
+    TEST_ASSERT_EQUAL_INT(AVCALC_INTERSECT_INFINITE, RadialIntersection(&lat1, &lon1, &crs13, &lat2, &lon2, &reverse, &lat3, &lon3));
+
+    // Courses from two points towards a third meet at the third, on every kernel
+    enum { n = 500 };
+    static double lat_1[n], lon_1[n], lat_2[n], lon_2[n], lat_3[n], lon_3[n], crs_13[n], crs_23[n], lat[n], lon[n];
+    static double lat_from[n], lon_from[n];
+    static int status[n], status_from[n];
+    char message[100];
+
+    random_points(lat_1, lon_1, n, 51);
+    random_points(lat_2, lon_2, n, 52);
+    random_points(lat_3, lon_3, n, 53);
+    for (int i = 0; i < n; i++) {
+        crs_13[i] = CourseInitial(&lat_1[i], &lon_1[i], &lat_3[i], &lon_3[i]);
+        crs_23[i] = CourseInitial(&lat_2[i], &lon_2[i], &lat_3[i], &lon_3[i]);
+    }
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        RadialIntersectionBatch(lat_1, lon_1, crs_13, lat_2, lon_2, crs_23, lat, lon, status, n);
+        for (int i = 0; i < n; i++) {
+            sprintf(message, "Kernel %d, pair %d", kernel, i);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(AVCALC_INTERSECT_UNIQUE, status[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, lat_3[i], lat[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6 / cos(D2R * lat_3[i]), 0.0, remainder(lon_3[i] - lon[i], 360.0), message);
+        }
+
+        // One radial against many gives the same as repeating it
+        for (int i = 0; i < n; i++) {
+            lat_3[i] = lat_1[0];        // Reused as copies of point 1
+            lon_3[i] = lon_1[0];
+            crs_23[i] = crs_13[0];
+        }
+        RadialIntersectionBatch(lat_3, lon_3, crs_23, lat_2, lon_2, crs_13, lat, lon, status, n);
+        RadialIntersectionBatchFrom(&lat_1[0], &lon_1[0], &crs_13[0], lat_2, lon_2, crs_13, lat_from, lon_from, status_from, n);
+        for (int i = 0; i < n; i++) {
+            sprintf(message, "Kernel %d, radial %d", kernel, i);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(status[i], status_from[i], message);
+            if (status[i] == AVCALC_INTERSECT_UNIQUE) {
+                TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(lat[i], lat_from[i], message);
+                TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(lon[i], lon_from[i], message);
+            }
+        }
+        random_points(lat_3, lon_3, n, 53);
+        for (int i = 0; i < n; i++) {
+            crs_23[i] = CourseInitial(&lat_2[i], &lon_2[i], &lat_3[i], &lon_3[i]);
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+void test_LegVertex(void) {
+    // Clairaut's formula from LAX towards JFK, and Sydney to Santiago over the southern vertex
+    double latA = 33.0 + 57.0/60, lonA = -(118.0 + 24.0/60);
+    double latB = 40.0 + 38.0/60, lonB = -( 73.0 + 47.0/60);
+    double latS = -33.95, lonS = 151.18, latC = -33.39, lonC = -70.79;
+    double latv, lonv;
+    double crs = D2R * CourseInitial(&latA, &lonA, &latB, &lonB);
+
+    TEST_ASSERT_EQUAL_INT(1, LegVertex(&latA, &lonA, &latB, &lonB, &latv, &lonv));     // Reached shortly before JFK
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, R2D * acos(fabs(sin(crs) * cos(D2R * latA))), latv);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, -79.6959, lonv);
+    TEST_ASSERT_EQUAL_INT(1, LegVertex(&latS, &lonS, &latC, &lonC, &latv, &lonv));
+    TEST_ASSERT_TRUE(latv < -60.0);
+    TEST_ASSERT_EQUAL_INT(-1, LegVertex(&latA, &lonA, &latA, &lonA, &latv, &lonv));
+    TEST_ASSERT_TRUE(isnan(latv));
+    double latP = 10.0, lonP = 20.0, latQ = -10.0, lonQ = -160.0;                      // Antipodal points
+    TEST_ASSERT_EQUAL_INT(-1, LegVertex(&latP, &lonP, &latQ, &lonQ, &latv, &lonv));
+
+    // Random legs against the extreme latitude of the densified leg
+    enum { n = 200, steps = 2000 };
+    static double lat1[n], lon1[n], lat[steps + 1], lon[steps + 1], latvs[n], lonvs[n];
+    static int reached[n];
+    char message[100];
+
+    random_points(lat1, lon1, n, 61);
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        LegVertexBatch(lat1, lon1, lat1 + 1, lon1 + 1, latvs, lonvs, reached, n - 1);
+        for (int i = 0; i + 1 < n; i++) {
+            double north = (latvs[i] < 0.0) ? -1.0 : 1.0;
+            double extreme = -90.0;
+
+            sprintf(message, "Kernel %d, leg %d", kernel, i);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(LegVertex(&lat1[i], &lon1[i], &lat1[i+1], &lon1[i+1], &latv, &lonv), reached[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, latv, latvs[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lonv, lonvs[i], message);
+
+            IntermediatePointsSteps(&lat1[i], &lon1[i], &lat1[i+1], &lon1[i+1], steps, lat, lon);
+            for (int k = 0; k <= steps; k++) {
+                extreme = fmax(extreme, north * lat[k]);
+            }
+            if (reached[i]) {
+                // Within half a step of the vertex
+                double half_step = Distance(&lat1[i], &lon1[i], &lat1[i+1], &lon1[i+1]) / 60 / steps / 2;
+
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(half_step, fabs(latvs[i]), extreme, message);
+            } else {
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, fmax(north * lat1[i], north * lat1[i+1]), extreme, message);
+            }
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+void test_CrossParallel(void) {
+    // A leg along a meridian crosses the equator once, an equatorial leg never
+    double lat1 = -10.0, lon1 = 20.0, lat2 = 10.0, lon2 = 20.0, equator = 0.0;
+    double north, south;
+
+    TEST_ASSERT_EQUAL_INT(1, CrossParallel(&lat1, &lon1, &lat2, &lon2, &equator, &north, &south));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 20.0, north);
+    TEST_ASSERT_TRUE(isnan(south));
+    TEST_ASSERT_EQUAL_INT(1, CrossParallel(&lat2, &lon2, &lat1, &lon1, &equator, &north, &south));
+    TEST_ASSERT_TRUE(isnan(north));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 20.0, south);
+    lat1 = lat2 = 0.0;
+    lon2 = 30.0;
+    TEST_ASSERT_EQUAL_INT(0, CrossParallel(&lat1, &lon1, &lat2, &lon2, &equator, &north, &south));
+    TEST_ASSERT_EQUAL_INT(-1, CrossParallel(&lat1, &lon1, &lat1, &lon1, &equator, &north, &south));
+    lat1 = 10.0, lat2 = -10.0, lon2 = -160.0;                                             // Antipodal points
+    TEST_ASSERT_EQUAL_INT(-1, CrossParallel(&lat1, &lon1, &lat2, &lon2, &equator, &north, &south));
+    TEST_ASSERT_TRUE(isnan(north) && isnan(south));
+
+    // Random legs against parallels every 5 degrees, checked on the densified leg
+    enum { n = 100, m = 36, steps = 2000 };
+    static double lat_1[n], lon_1[n], lat[steps + 1], lon[steps + 1], parallels[m];
+    static double norths[n * m], souths[n * m];
+    char message[100];
+
+    random_points(lat_1, lon_1, n, 67);
+    for (int j = 0; j < m; j++) {
+        parallels[j] = -87.5 + 5.0 * j;
+    }
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL_INT(0, CrossParallelBatch(lat_1, lon_1, lat_1 + 1, lon_1 + 1, n - 1, parallels, m, norths, souths));
+        TEST_ASSERT_EQUAL_INT(0, CrossParallelBatch(&lat1, &lon1, &lat2, &lon2, 1, parallels, m, norths, souths));
+        for (int j = 0; j < m; j++) {
+            TEST_ASSERT_TRUE(isnan(norths[j]) && isnan(souths[j]));     // No crossings on a degenerate leg
+        }
+        TEST_ASSERT_EQUAL_INT(0, CrossParallelBatch(lat_1, lon_1, lat_1 + 1, lon_1 + 1, n - 1, parallels, m, norths, souths));
+        for (int i = 0; i + 1 < n; i++) {
+            double latv, lonv, dist = Distance(&lat_1[i], &lon_1[i], &lat_1[i+1], &lon_1[i+1]);
+
+            LegVertex(&lat_1[i], &lon_1[i], &lat_1[i+1], &lon_1[i+1], &latv, &lonv);
+            IntermediatePointsSteps(&lat_1[i], &lon_1[i], &lat_1[i+1], &lon_1[i+1], steps, lat, lon);
+            for (int j = 0; j < m; j++) {
+                double crossing[2] = {norths[i * m + j], souths[i * m + j]};
+                int up = 0, down = 0;
+
+                sprintf(message, "Kernel %d, leg %d, parallel %d", kernel, i, j);
+                CrossParallel(&lat_1[i], &lon_1[i], &lat_1[i+1], &lon_1[i+1], &parallels[j], &north, &south);
+                TEST_ASSERT_EQUAL_INT_MESSAGE(isnan(north), isnan(crossing[0]), message);
+                TEST_ASSERT_EQUAL_INT_MESSAGE(isnan(south), isnan(crossing[1]), message);
+
+                for (int k = 0; k < steps; k++) {
+                    up   += (lat[k] < parallels[j] && lat[k+1] >= parallels[j]);
+                    down += (lat[k] >= parallels[j] && lat[k+1] < parallels[j]);
+                }
+                if (fabs(fabs(latv) - fabs(parallels[j])) > 0.01 && fabs(lat_1[i] - parallels[j]) > 0.01 &&
+                    fabs(lat_1[i+1] - parallels[j]) > 0.01) {
+                    TEST_ASSERT_EQUAL_INT_MESSAGE(up, !isnan(crossing[0]), message);
+                    TEST_ASSERT_EQUAL_INT_MESSAGE(down, !isnan(crossing[1]), message);
+                }
+                for (int c = 0; c < 2; c++) {
+                    double xtd, atd;
+
+                    if (isnan(crossing[c])) {
+                        continue;
+                    }
+                    TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, (c == 0) ? north : south, crossing[c], message);
+                    CrossTrack(&lat_1[i], &lon_1[i], &lat_1[i+1], &lon_1[i+1], &parallels[j], &crossing[c], &xtd, &atd);
+                    TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, 0.0, xtd, message);
+                    TEST_ASSERT_TRUE_MESSAGE(atd > -1e-6 && atd < dist + 1e-6, message);
+                }
+            }
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+void test_Rhumb(void) {
+    // Worked example of avform.txt: LAX to JFK, 2164.6 nm on 79.32 degrees
+    double latA = 33.0 + 57.0/60, lonA = -(118.0 + 24.0/60);
+    double latB = 40.0 + 38.0/60, lonB = -( 73.0 + 47.0/60);
+    double dist, course, lat, lon;
+    PreparedPoint pA, pB;
+
+    RhumbInverse(&latA, &lonA, &latB, &lonB, &dist, &course);
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, 2164.6, dist);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, R2D * 1.384464, course);
+    RhumbDirect(&latA, &lonA, &course, &dist, &lat, &lon);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, latB, lat);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, lonB, lon);
+    PreparePoint(&latA, &lonA, &pA);
+    PreparePoint(&latB, &lonB, &pB);
+    RhumbInversePrepared(&pA, &pB, &lat, &lon);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, dist, lat);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, course, lon);
+
+    // Across the antimeridian the shorter way, and to the pole along the meridian
+    latA = 0.0; lonA = 179.0; latB = 0.0; lonB = -179.0;
+    RhumbInverse(&latA, &lonA, &latB, &lonB, &dist, &course);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 120.0, dist);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 90.0, course);
+    latA = 89.0; latB = 90.0;
+    RhumbInverse(&latA, &lonA, &latB, &lonB, &dist, &course);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 60.0, dist);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, course);
+    dist = 61.0;
+    RhumbDirect(&latA, &lonA, &course, &dist, &lat, &lon);
+    TEST_ASSERT_TRUE(isnan(lat) && isnan(lon));
+
+    // Courses near east and west, on both sides of the switch to the series
+    const double offsets[] = {0.0, 1e-12, 1e-8, 1e-6, 0.9e-4, 1.1e-4, 1e-3};
+    char message[100];
+
+    for (int k = 0; k < (int)(sizeof(offsets) / sizeof(offsets[0])); k++) {
+        long double l1 = 0.9L, l2 = 0.9L + offsets[k], dlon = 0.5L, q;
+
+        q = (offsets[k] < 1e-6) ? cosl(0.5L * (l1 + l2)) : (l2 - l1) / (atanhl(sinl(l2)) - atanhl(sinl(l1)));
+        latA = R2D * (double)l1;
+        latB = R2D * (double)l2;
+        lonA = 0.0;
+        lonB = R2D * (double)dlon;
+        RhumbInverse(&latA, &lonA, &latB, &lonB, &dist, &course);
+        sprintf(message, "Offset %g", offsets[k]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-11 * dist, 60 * R2D * (double)sqrtl((l2 - l1) * (l2 - l1) + q * q * dlon * dlon), dist, message);
+    }
+
+    // Round trips, and the batch on every kernel against the scalar functions
+    enum { n = 1000 };
+    static double lat1[n], lon1[n], lat2[n], lon2[n], dists[n], courses[n], lats[n], lons[n];
+
+    random_points(lat1, lon1, n, 71);
+    random_points(lat2, lon2, n, 73);
+    for (int i = 0; i < n; i++) {
+        lat1[i] *= 0.98;        // Clear of the poles, where rhumb lines wind without end
+        lat2[i] *= 0.98;
+    }
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        RhumbInverseBatch(lat1, lon1, lat2, lon2, dists, courses, n);
+        RhumbDirectBatch(lat1, lon1, courses, dists, lats, lons, n);
+        for (int i = 0; i < n; i++) {
+            sprintf(message, "Kernel %d, pair %d", kernel, i);
+            RhumbInverse(&lat1[i], &lon1[i], &lat2[i], &lon2[i], &dist, &course);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, dist, dists[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, course, courses[i], message);
+            RhumbDirect(&lat1[i], &lon1[i], &course, &dist, &lat, &lon);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat, lats[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lon, lons[i], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat2[i], lat, message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, 0.0, remainder(lon2[i] - lon, 360.0), message);
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+void test_LocalFrame(void) {
+    // Scale factors of WGS-84 on the equator, per degree of latitude and of longitude
+    double lat0 = 0.0, lon0 = 0.0, d = 50.0;
+    LocalFrame frame;
+
+    TEST_ASSERT_EQUAL_INT(0, LocalFrameInit(&lat0, &lon0, AVCALC_EARTH_WGS84, &frame));
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 110574.27, frame.north_per_deg * 1852);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 111319.49, frame.east_per_deg * 1852);
+    TEST_ASSERT_EQUAL_INT(0, LocalFrameInit(&lat0, &lon0, AVCALC_EARTH_SPHERE, &frame));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 60.0, frame.north_per_deg);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 60.0, frame.east_per_deg);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-15, (d / (60 * R2D)) * (d / (60 * R2D)), LocalFrameErrorBound(&frame, &d));
+    lat0 = 90.0;
+    TEST_ASSERT_EQUAL_INT(-1, LocalFrameInit(&lat0, &lon0, AVCALC_EARTH_SPHERE, &frame));
+    TEST_ASSERT_EQUAL_INT(-1, LocalFrameInit(&lon0, &lon0, 99, &frame));
+
+    // Across the antimeridian
+    double lat = 0.0, lon = -179.9, north, east;
+
+    lon0 = 179.9;
+    LocalFrameInit(&lat, &lon0, AVCALC_EARTH_SPHERE, &frame);
+    LocalFrameToNE(&frame, &lat, &lon, &north, &east, 1);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 12.0, east);
+
+    // Points within 50 nm of reference points from the equator to 80 degrees, against
+    // Distance() and CourseInitial() within the error bound, and back
+    enum { n = 400 };
+    static double lats[n], lons[n], norths[n], easts[n], dists[n], bearings[n], lats2[n], lons2[n];
+    char message[100];
+
+    for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+        if (BatchKernelSelect(kernel) != kernel) {
+            continue;
+        }
+        for (lat0 = 0.0; lat0 <= 80.0; lat0 += 20.0) {
+            lon0 = -73.78;
+            LocalFrameInit(&lat0, &lon0, AVCALC_EARTH_SPHERE, &frame);
+            for (int i = 0; i < n; i++) {
+                double course = 0.9 * i, range = 50.0 * (i + 1) / n;
+
+                Direct(&lat0, &lon0, &course, &range, &lats[i], &lons[i]);
+            }
+            LocalFrameToNE(&frame, lats, lons, norths, easts, n);
+            LocalFrameFromNE(&frame, norths, easts, lats2, lons2, n);
+            LocalFrameRange(&frame, lats, lons, dists, bearings, n);
+            for (int i = 0; i < n; i++) {
+                double gc = Distance(&lat0, &lon0, &lats[i], &lons[i]);
+                double bound = LocalFrameErrorBound(&frame, &gc);
+
+                sprintf(message, "Kernel %d, lat0 %g, point %d", kernel, lat0, i);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lats[i], lats2[i], message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lons[i], lons2[i], message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12, sqrt(norths[i] * norths[i] + easts[i] * easts[i]), dists[i], message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(bound * gc, gc, dists[i], message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(R2D * bound, 0.0,
+                                                  remainder(bearings[i] - CourseInitial(&lat0, &lon0, &lats[i], &lons[i]), 360.0), message);
+            }
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+void test_ClosestApproach(void) {
+    // Head on along the equator, 60 nm apart closing at 600 kt
+    double lat1 = 0.0, lon1 = 0.0, track1 = 90.0, speed = 300.0;
+    double lat2 = 0.0, lon2 = 1.0, track2 = 270.0;
+    double lookahead = 600.0, tcpa, dcpa;
+
+    dcpa = ClosestApproach(&lat1, &lon1, &track1, &speed, &lat2, &lon2, &track2, &speed, &lookahead, &tcpa);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 360.0, tcpa);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.0, dcpa);
+    lookahead = 100.0;
+    dcpa = ClosestApproach(&lat1, &lon1, &track1, &speed, &lat2, &lon2, &track2, &speed, &lookahead, &tcpa);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0, tcpa);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 60.0 - 600.0 * 100.0 / 3600.0, dcpa);
+
+    // Random crossings near the North pole, against sampling the tracks every 0.05 s with Direct()
+    lookahead = 300.0;
+    for (int i = 0; i < 20; i++) {
+        double speed1 = 250.0 + 20 * i, speed2 = 480.0 - 10 * i, best = 1e9, tbest = 0.0;
+        char message[100];
+
+        lat1 = 89.2 + 0.02 * i;  lon1 = 18.0 * i;       track1 = 37.0 * i;
+        lat2 = 89.5 - 0.01 * i;  lon2 = 160.0 - 9 * i;  track2 = 200.0 - 23.0 * i;
+        for (int k = 0; k <= 6000; k++) {
+            double t = 0.05 * k, d1 = speed1 * t / 3600, d2 = speed2 * t / 3600, la1, lo1, la2, lo2, d;
+
+            Direct(&lat1, &lon1, &track1, &d1, &la1, &lo1);
+            Direct(&lat2, &lon2, &track2, &d2, &la2, &lo2);
+            d = Distance(&la1, &lo1, &la2, &lo2);
+            if (d < best) {
+                best = d;
+                tbest = t;
+            }
+        }
+        dcpa = ClosestApproach(&lat1, &lon1, &track1, &speed1, &lat2, &lon2, &track2, &speed2, &lookahead, &tcpa);
+        sprintf(message, "Pair %d", i);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-4, best, dcpa, message);
+        TEST_ASSERT_TRUE_MESSAGE(dcpa <= best + 1e-9, message);
+        if (tbest > 0.05 && tbest < lookahead - 0.05) {
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(0.5, tbest, tcpa, message);
+        }
+    }
+}
+
+void test_ConflictDetect(void) {
+    // Dense traffic over Europe, the North pole and the antimeridian against all pairs
+    enum { n = 1200, capacity = 4000 };
+    static double lat[n], lon[n], track[n], speed[n], tcpa[capacity], dcpa[capacity], tcpa2[capacity], dcpa2[capacity];
+    static int first[capacity], second[capacity], first2[capacity], second2[capacity];
+    double lookahead = 300.0, separation = 5.0;
+    const double centre_lat[3] = {50.0, 90.0, 0.0}, centre_lon[3] = {10.0, 0.0, 180.0};
+    char message[100];
+    int count = 0;
+
+    random_points(lat, lon, n, 79);
+    for (int i = 0; i < n; i++) {
+        double course = lon[i] + 180.0, range = 300.0 * (lat[i] + 90.0) / 180.0;
+
+        Direct(&centre_lat[i % 3], &centre_lon[i % 3], &course, &range, &lat[i], &lon[i]);
+        track[i] = 0.3 * i;
+        speed[i] = 200.0 + (i % 7) * 50.0;
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            double t, d = ClosestApproach(&lat[i], &lon[i], &track[i], &speed[i], &lat[j], &lon[j], &track[j], &speed[j], &lookahead, &t);
+
+            if (d < separation) {
+                TEST_ASSERT_TRUE(count < capacity);
+                first2[count] = i;
+                second2[count] = j;
+                tcpa2[count] = t;
+                dcpa2[count] = d;
+                count++;
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(count > 10);
+
+    for (int threads = 1; threads <= 4; threads += 3) {
+        TEST_ASSERT_EQUAL_INT(count, ConflictDetect(lat, lon, track, speed, n, &lookahead, &separation,
+                                                    first, second, tcpa, dcpa, capacity, threads));
+        for (int c = 0; c < count; c++) {
+            sprintf(message, "Threads %d, conflict %d", threads, c);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(first2[c], first[c], message);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(second2[c], second[c], message);
+            TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(tcpa2[c], tcpa[c], message);
+            TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(dcpa2[c], dcpa[c], message);
+        }
+    }
+
+    // Only as many as fit are written
+    first[2] = -1;
+    TEST_ASSERT_EQUAL_INT(count, ConflictDetect(lat, lon, track, speed, n, &lookahead, &separation,
+                                                first, second, tcpa, dcpa, 2, 1));
+    TEST_ASSERT_EQUAL_INT(-1, first[2]);
+}
+
+void test_PointIndex(void) {
+    // Random points with clusters at the poles, across the antimeridian and
+    // a repeated point, against a scan of Distance() over all points
+    enum { n = 4000, queries = 300, k = 12 };
+    static double lat[n], lon[n], qlat[queries], qlon[queries], reference[n];
+    static int found[queries * k], count[queries], batch_found[queries * k];
+    static double dist[queries * k], batch_dist[queries * k];
+    double radius = 400.0;
+    const char *path = "test_point_index.bin";
+    char message[100];
+
+    random_points(lat, lon, n, 777);
+    for (int i = 0; i < 300; i++) {
+        lat[i]       =  89.0 + (i % 10) * 0.1;
+        lat[300 + i] = -89.5 - (i % 5) * 0.1;
+        lon[i]       = lon[300 + i] = -180.0 + 1.2 * i;
+        lat[600 + i] = -5.0 + (i % 20) * 0.5;
+        lon[600 + i] = (i % 2) ? 179.9 - (i % 15) * 0.05 : -180.0 + (i % 15) * 0.05;
+    }
+    for (int i = 900; i < 920; i++) {
+        lat[i] = 50.0;
+        lon[i] = 10.0;
+    }
+    random_points(qlat, qlon, queries, 4242);
+    qlat[0] = 90.0;  qlon[0] = 0.0;
+    qlat[1] = -90.0; qlon[1] = 45.0;
+    qlat[2] = 0.0;   qlon[2] = 180.0;
+    qlat[3] = 0.0;   qlon[3] = -179.99;
+    qlat[4] = 50.0;  qlon[4] = 10.0;
+
+    PointIndex *index = PointIndexCreate(lat, lon, n);
+    TEST_ASSERT_NOT_NULL(index);
+    TEST_ASSERT_EQUAL_INT(n, PointIndexSize(index));
+    TEST_ASSERT_NULL(PointIndexCreate(lat, lon, 0));
+
+    for (int q = 0; q < queries; q++) {
+        int within = 0, m;
+
+        for (int i = 0; i < n; i++) {
+            reference[i] = Distance(&qlat[q], &qlon[q], &lat[i], &lon[i]);
+            within += reference[i] <= radius;
+        }
+        m = PointIndexNearest(index, &qlat[q], &qlon[q], k, &found[q * k], &dist[q * k]);
+        sprintf(message, "Query %d", q);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(k, m, message);
+        for (int j = 0; j < k; j++) {
+            int closer = 0;
+
+            // As near as the j-th nearest of the scan, and reported with Distance()
+            for (int i = 0; i < n; i++) {
+                closer += reference[i] < dist[q * k + j] - 1e-9;
+            }
+            TEST_ASSERT_TRUE_MESSAGE(closer <= j, message);
+            TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(reference[found[q * k + j]], dist[q * k + j], message);
+            TEST_ASSERT_TRUE_MESSAGE(j == 0 || dist[q * k + j] >= dist[q * k + j - 1] - 1e-12, message);
+        }
+
+        m = PointIndexWithin(index, &qlat[q], &qlon[q], &radius, &found[q * k], &dist[q * k], k);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(within, m, message);
+        for (int j = 0; j < (m < k ? m : k); j++) {
+            TEST_ASSERT_TRUE_MESSAGE(dist[q * k + j] <= radius, message);
+        }
+    }
+
+    // Batches in several threads give the same rows
+    for (int q = 0; q < queries; q++) {
+        PointIndexNearest(index, &qlat[q], &qlon[q], k, &found[q * k], &dist[q * k]);
+    }
+    TEST_ASSERT_EQUAL_INT(0, PointIndexNearestBatch(index, qlat, qlon, queries, k, batch_found, batch_dist, 3));
+    TEST_ASSERT_EQUAL_INT_ARRAY(found, batch_found, queries * k);
+    TEST_ASSERT_EQUAL_DOUBLE_ARRAY(dist, batch_dist, queries * k);
+    TEST_ASSERT_EQUAL_INT(0, PointIndexWithinBatch(index, qlat, qlon, queries, &radius, count, batch_found, batch_dist, k, 3));
+    for (int q = 0; q < queries; q++) {
+        sprintf(message, "Query %d", q);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(PointIndexWithin(index, &qlat[q], &qlon[q], &radius, &found[q * k], &dist[q * k], k), count[q], message);
+        for (int j = count[q]; j < k; j++) {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(-1, batch_found[q * k + j], message);
+        }
+    }
+
+    // Fewer points than asked for
+    double one_lat = 10.0, one_lon = 20.0;
+    PointIndex *single = PointIndexCreate(&one_lat, &one_lon, 1);
+    TEST_ASSERT_EQUAL_INT(1, PointIndexNearest(single, &qlat[0], &qlon[0], k, found, dist));
+    TEST_ASSERT_EQUAL_INT(0, found[0]);
+    PointIndexFree(single);
+
+    // Saved and read back, the index answers the same
+    TEST_ASSERT_EQUAL_INT(0, PointIndexSave(index, path));
+    PointIndex *loaded = PointIndexLoad(path);
+    TEST_ASSERT_NOT_NULL(loaded);
+    TEST_ASSERT_EQUAL_INT(0, PointIndexNearestBatch(loaded, qlat, qlon, queries, k, batch_found, batch_dist, 1));
+    PointIndexNearestBatch(index, qlat, qlon, queries, k, found, dist, 1);
+    TEST_ASSERT_EQUAL_INT_ARRAY(found, batch_found, queries * k);
+    TEST_ASSERT_EQUAL_DOUBLE_ARRAY(dist, batch_dist, queries * k);
+    PointIndexFree(loaded);
+
+    // A file cut short is refused
+    FILE *file = fopen(path, "wb");
+    fwrite("AVCINDEX", 8, 1, file);
+    fclose(file);
+    TEST_ASSERT_NULL(PointIndexLoad(path));
+    remove(path);
+    TEST_ASSERT_NULL(PointIndexLoad(path));
+
+    PointIndexFree(index);
+}
+
+// Asserts that two routes hold the same waypoints, legs and distances
+static void assert_same_route(const Route *a, const Route *b) {
+    double lat_a, lon_a, along_a, lat_b, lon_b, along_b, crs_a, crs_b;
+
+    TEST_ASSERT_EQUAL_INT(RouteSize(b), RouteSize(a));
+    for (int k = 0; k < RouteSize(a); k++) {
+        RouteWaypoint(a, k, &lat_a, &lon_a, &along_a);
+        RouteWaypoint(b, k, &lat_b, &lon_b, &along_b);
+        TEST_ASSERT_EQUAL_DOUBLE(lat_b, lat_a);
+        TEST_ASSERT_EQUAL_DOUBLE(lon_b, lon_a);
+        TEST_ASSERT_EQUAL_DOUBLE(along_b, along_a);
+        if (k < RouteSize(a) - 1) {
+            RouteLeg(a, k, &along_a, &crs_a);
+            RouteLeg(b, k, &along_b, &crs_b);
+            TEST_ASSERT_EQUAL_DOUBLE(along_b, along_a);
+            TEST_ASSERT_EQUAL_DOUBLE(crs_b, crs_a);
+        }
+    }
+}
+
+void test_Route(void) {
+    // Across the Pacific and the antimeridian, with a repeated waypoint
+    double lat[] = {33.94, 21.32, 21.32, -17.75, -33.95, -37.01};
+    double lon[] = {-118.40, -157.92, -157.92, 177.44, 151.18, 174.79};
+    enum { n = sizeof(lat) / sizeof(lat[0]) };
+    double total = 0.0, along, plat, plon, crs, dist, leg_dist, leg_crs;
+    char message[100];
+
+    Route *route = RouteCreate(lat, lon, n);
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_INT(n, RouteSize(route));
+    for (int k = 0; k < n; k++) {
+        sprintf(message, "Waypoint %d", k);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(0, RouteWaypoint(route, k, &plat, &plon, &along), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-8, total, along, message);
+
+        // At the distance of a waypoint the position is the waypoint, on
+        // the leg after the empty one for the repeated waypoint
+        TEST_ASSERT_EQUAL_INT_MESSAGE((k == 1) ? 2 : (k < n - 1) ? k : n - 2, RoutePositionAt(route, &along, &plat, &plon, NULL), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat[k], plat, message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, 0.0, remainder(lon[k] - plon, 360.0), message);
+        if (k == n - 1) {
+            break;
+        }
+
+        // Halfway along a leg, against IntermediatePoint() and CourseInitial()
+        double half = 0.5, mid_lat, mid_lon;
+        leg_dist = Distance(&lat[k], &lon[k], &lat[k + 1], &lon[k + 1]);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(0, RouteLeg(route, k, &dist, &leg_crs), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-8, leg_dist, dist, message);
+        if (leg_dist > 0.0) {
+            crs = CourseInitial(&lat[k], &lon[k], &lat[k + 1], &lon[k + 1]);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, 0.0, remainder(crs - leg_crs, 360.0), message);
+            TEST_ASSERT_TRUE_MESSAGE(leg_crs >= 0.0 && leg_crs < 360.0, message);
+
+            IntermediatePoint(&lat[k], &lon[k], &lat[k + 1], &lon[k + 1], &half, &mid_lat, &mid_lon);
+            along = total + 0.5 * leg_dist;
+            TEST_ASSERT_EQUAL_INT_MESSAGE(k, RoutePositionAt(route, &along, &plat, &plon, &crs), message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, mid_lat, plat, message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, 0.0, remainder(mid_lon - plon, 360.0), message);
+
+            // The course there is the course on to the end of the leg
+            double to_end = CourseInitial(&plat, &plon, &lat[k + 1], &lon[k + 1]);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-7, 0.0, remainder(to_end - crs, 360.0), message);
+        }
+        total += leg_dist;
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(1e-8, total, RouteLength(route));
+
+    // Outside the route
+    dist = -1.0;
+    TEST_ASSERT_EQUAL_INT(-1, RoutePositionAt(route, &dist, &plat, &plon, NULL));
+    dist = total + 1.0;
+    TEST_ASSERT_EQUAL_INT(-1, RoutePositionAt(route, &dist, &plat, &plon, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, RouteWaypoint(route, n, &plat, &plon, &along));
+    TEST_ASSERT_EQUAL_INT(-1, RouteLeg(route, n - 1, &dist, &crs));
+
+    // A batch in any order agrees with single positions
+    enum { m = 500 };
+    static double d[m], blat[m], blon[m], bcrs[m];
+    static int bleg[m];
+    for (int j = 0; j < m; j++) {
+        d[j] = total * ((j * 7919) % (m + 10)) / (m - 1) - 5.0;
+    }
+    int outside = 0;
+    for (int j = 0; j < m; j++) {
+        outside += d[j] < 0.0 || d[j] > total;
+    }
+    TEST_ASSERT_EQUAL_INT(outside, RoutePositionAtBatch(route, d, blat, blon, bcrs, bleg, m));
+    for (int j = 0; j < m; j++) {
+        int k = RoutePositionAt(route, &d[j], &plat, &plon, &crs);
+
+        sprintf(message, "Distance %d", j);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(k, bleg[j], message);
+        if (k >= 0) {
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12, plat, blat[j], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12, plon, blon[j], message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, 0.0, remainder(crs - bcrs[j], 360.0), message);
+        } else {
+            TEST_ASSERT_TRUE_MESSAGE(isnan(blat[j]) && isnan(blon[j]), message);
+        }
+    }
+
+    // Built up and taken down one waypoint at a time, the route matches one
+    // created whole at every step, also past the first block it was given
+    Route *grown = RouteCreate(NULL, NULL, 0);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, RouteLength(grown));
+    static double glat[40], glon[40];
+    random_points(glat, glon, 40, 99);
+    for (int k = 0; k < 40; k++) {
+        int at = (k * 13) % (k + 1);
+        double tlat = glat[k], tlon = glon[k];
+
+        for (int i = k; i > at; i--) {
+            glat[i] = glat[i - 1];
+            glon[i] = glon[i - 1];
+        }
+        glat[at] = tlat;
+        glon[at] = tlon;
+        TEST_ASSERT_EQUAL_INT(0, RouteInsert(grown, at, &tlat, &tlon));
+        Route *whole = RouteCreate(glat, glon, k + 1);
+        assert_same_route(grown, whole);
+        RouteFree(whole);
+    }
+    for (int k = 40; k > 0; k--) {
+        int at = (k * 7) % k;
+
+        for (int i = at; i < k - 1; i++) {
+            glat[i] = glat[i + 1];
+            glon[i] = glon[i + 1];
+        }
+        TEST_ASSERT_EQUAL_INT(0, RouteDelete(grown, at));
+        Route *whole = RouteCreate(glat, glon, k - 1);
+        assert_same_route(grown, whole);
+        RouteFree(whole);
+    }
+    TEST_ASSERT_EQUAL_INT(-1, RouteDelete(grown, 0));
+    TEST_ASSERT_EQUAL_INT(-1, RouteInsert(grown, 1, &lat[0], &lon[0]));
+    RouteFree(grown);
+    RouteFree(route);
+}
+
+void test_Geodesic(void) {
+    // Published solutions on WGS-84 (Karney, Algorithms for geodesics, 2013),
+    // the second nearly antipodal, Vincenty's example on GRS80, and antipodal
+    // points on the equator, which have two shortest paths
+    struct {
+        int model;
+        double lat1, lon1, lat2, lon2, dist_m, initial, final;
+        double course_tolerance;
+    } inverse[] = {
+        {AVCALC_EARTH_WGS84, -30.12345, 0.0, -30.12344, 0.00005, 4.944208, 77.043533542, 77.043508449, 1e-6},
+        {AVCALC_EARTH_WGS84, -30.0, 0.0, 29.9, 179.8, 19989832.827610, 161.890524736, 18.090737246, 1e-7},
+        {AVCALC_EARTH_GRS80, -(37 + 57 / 60.0 + 3.72030 / 3600), 144 + 25 / 60.0 + 29.52440 / 3600,
+                             -(37 + 39 / 60.0 + 10.15610 / 3600), 143 + 55 / 60.0 + 35.38390 / 3600,
+                             54972.271, -(53 + 7 / 60.0 + 54.63 / 3600), -(52 + 49 / 60.0 + 34.93 / 3600), 1e-5},
+        {AVCALC_EARTH_WGS84, 0.0, 0.0, 0.0, 180.0, 20003931.4586, 180.0, 0.0, 1e-6},      // Over the South pole
+    };
+    double dist, initial, final, lat, lon, course;
+    char message[100];
+
+    for (size_t i = 0; i < sizeof(inverse) / sizeof(inverse[0]); i++) {
+        sprintf(message, "Case %d", (int)i);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(0, GeodesicInverse(&inverse[i].lat1, &inverse[i].lon1, &inverse[i].lat2, &inverse[i].lon2,
+                                                         inverse[i].model, &dist, &initial, &final), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-3, inverse[i].dist_m, dist * 1852, message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(inverse[i].course_tolerance, 0.0, remainder(inverse[i].initial - initial, 360.0), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(inverse[i].course_tolerance, 0.0, remainder(inverse[i].final - final, 360.0), message);
+    }
+
+    double lat1 = 40.0, lon1 = 0.0, crs = 30.0, s = 10000e3 / 1852;
+    TEST_ASSERT_EQUAL_INT(0, GeodesicDirect(&lat1, &lon1, &crs, &s, AVCALC_EARTH_WGS84, &lat, &lon, &course));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 41.79331020506, lat);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 137.84490004377, lon);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 149.09016931807, course);
+    TEST_ASSERT_EQUAL_INT(-1, GeodesicDirect(&lat1, &lon1, &crs, &s, 99, &lat, &lon, &course));
+    TEST_ASSERT_EQUAL_INT(-1, GeodesicInverse(&lat1, &lon1, &lat1, &lon1, -1, &dist, &initial, &final));
+
+    // On the sphere the geodesic is the great circle
+    double lat2 = -20.0, lon2 = 120.0;
+    GeodesicInverse(&lat1, &lon1, &lat2, &lon2, AVCALC_EARTH_SPHERE, &dist, &initial, &final);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, Distance(&lat1, &lon1, &lat2, &lon2), dist);
+
+    // Random pairs, a quarter of them nearly antipodal and some on the
+    // equator, must come back to point 2 by the direct solution, read the
+    // same both ways, and agree between the batch kernels
+    enum { n = 2000 };
+    static double la1[n], lo1[n], la2[n], lo2[n], d[n], c1[n], c2[n], bd[n], bc1[n], bc2[n];
+    static double rlat[n], rlon[n], rcrs[n];
+    random_points(la1, lo1, n, 2024);
+    random_points(la2, lo2, n, 4202);
+    for (int i = 0; i < n; i += 4) {
+        la2[i] = -la1[i] + 0.01 * (la2[i] / 90.0);
+        lo2[i] = lo1[i] + 180.0 - 0.5 * fabs(lo2[i] / 180.0);
+    }
+    for (int i = 1; i < n; i += 40) {
+        la1[i] = la2[i] = 0.0;
+    }
+    for (int model = AVCALC_EARTH_WGS84; model <= AVCALC_EARTH_CLARKE66; model += 6) {
+        for (int i = 0; i < n; i++) {
+            double back, back_initial, back_final;
+
+            sprintf(message, "Model %d pair %d", model, i);
+            GeodesicInverse(&la1[i], &lo1[i], &la2[i], &lo2[i], model, &d[i], &c1[i], &c2[i]);
+            GeodesicInverse(&la2[i], &lo2[i], &la1[i], &lo1[i], model, &back, &back_initial, &back_final);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-8, d[i], back, message);
+            TEST_ASSERT_TRUE_MESSAGE(d[i] <= 10820.0, message);      // Half the meridian
+            TEST_ASSERT_TRUE_MESSAGE(fabs(d[i] - Distance(&la1[i], &lo1[i], &la2[i], &lo2[i])) < 0.01 * d[i] + 1e-9, message);
+
+            GeodesicDirect(&la1[i], &lo1[i], &c1[i], &d[i], model, &lat, &lon, &course);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-8, la2[i], lat, message);
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-8 / fmax(cos(la2[i] * M_PI / 180), 1e-6), 0.0, remainder(lo2[i] - lon, 360.0), message);
+        }
+        for (int kernel = AVCALC_KERNEL_SCALAR; kernel <= AVCALC_KERNEL_AVX512; kernel++) {
+            if (BatchKernelSelect(kernel) != kernel) {
+                continue;
+            }
+            TEST_ASSERT_EQUAL_INT(0, GeodesicInverseBatch(la1, lo1, la2, lo2, model, bd, bc1, bc2, n));
+            TEST_ASSERT_EQUAL_INT(0, GeodesicDirectBatch(la1, lo1, c1, d, model, rlat, rlon, rcrs, n));
+            for (int i = 0; i < n; i++) {
+                sprintf(message, "Model %d kernel %d pair %d", model, kernel, i);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, d[i], bd[i], message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, 0.0, remainder(c1[i] - bc1[i], 360.0), message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-6, 0.0, remainder(c2[i] - bc2[i], 360.0), message);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-8, la2[i], rlat[i], message);
+            }
+        }
+    }
+    BatchKernelSelect(AVCALC_KERNEL_AUTO);
+}
+
+void test_EcefConversion(void) {
+    // WGS-84 in metres, and the geocentric formulas of the formulary
+    const double a = 6378137.0 / 1852, b = a * (1 - 1 / 298.257223563);
+    enum { n = 2000 };
+    static double lat[n], lon[n], height[n], x[n], y[n], z[n], lat2[n], lon2[n], height2[n], latc[n], radius[n];
+    char message[100];
+
+    random_points(lat, lon, n, 2468);
+    for (int i = 0; i < n; i++) {
+        // From below the sea floor out past geostationary orbit
+        height[i] = (i % 4 == 0) ? -5.0 + 20.0 * (double)(i % 97) / 97.0 : 25000.0 * (double)(i % 89) / 89.0;
+    }
+    lat[0] = 90.0;
+    lat[1] = -90.0;
+    lat[2] = 0.0;
+    height[2] = 0.0;
+    lon[2] = 0.0;
+
+    TEST_ASSERT_EQUAL_INT(0, GeodeticToEcef(lat, lon, height, AVCALC_EARTH_WGS84, x, y, z, n));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, a, x[2]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, y[2]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, b + height[0], z[0]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, -b - height[1], z[1]);
+
+    TEST_ASSERT_EQUAL_INT(0, EcefToGeodetic(x, y, z, AVCALC_EARTH_WGS84, lat2, lon2, height2, n));
+    TEST_ASSERT_EQUAL_INT(0, GeodeticToGeocentric(lat, height, AVCALC_EARTH_WGS84, latc, radius, n));
+    for (int i = 0; i < n; i++) {
+        double sinv = sin(lat[i] * M_PI / 180), cosv = cos(lat[i] * M_PI / 180);
+        double q = height[i] * sqrt(a * a * cosv * cosv + b * b * sinv * sinv);
+        double r2 = height[i] * height[i] + 2 * height[i] * sqrt(a * a * cosv * cosv + b * b * sinv * sinv)
+                    + (pow(a, 4) - (pow(a, 4) - pow(b, 4)) * sinv * sinv) / (a * a - (a * a - b * b) * sinv * sinv);
+        double u = atan2(sinv * (q + b * b), cosv * (q + a * a)) * 180 / M_PI;
+
+        sprintf(message, "Point %d at %.6f, %.6f, %.3f nm", i, lat[i], lon[i], height[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat[i], lat2[i], message);
+        if (fabs(lat[i]) < 90.0) {
+            TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, 0.0, remainder(lon[i] - lon2[i], 360.0), message);
+        }
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, height[i], height2[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, u, latc[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * sqrt(r2), sqrt(r2), radius[i], message);
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, GeocentricToGeodetic(latc, radius, AVCALC_EARTH_WGS84, lat2, height2, n));
+    for (int i = 0; i < n; i++) {
+        sprintf(message, "Point %d", i);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, lat[i], lat2[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, height[i], height2[i], message);
+    }
+
+    // The polar axis and the centre of the earth
+    double axis[3] = {0.0, 0.0, 0.0}, pole = 3500.0;
+    EcefToGeodetic(&axis[0], &axis[1], &pole, AVCALC_EARTH_WGS84, &lat2[0], &lon2[0], &height2[0], 1);
+    TEST_ASSERT_EQUAL_DOUBLE(90.0, lat2[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, lon2[0]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, pole - b, height2[0]);
+    EcefToGeodetic(&axis[0], &axis[1], &axis[2], AVCALC_EARTH_WGS84, &lat2[0], &lon2[0], &height2[0], 1);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, lat2[0]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, -a, height2[0]);
+
+    // On the sphere the geocentric and geodetic latitudes are equal
+    TEST_ASSERT_EQUAL_INT(0, GeodeticToGeocentric(lat, height, AVCALC_EARTH_SPHERE, latc, radius, 10));
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(1e-12, lat[i], latc[i]);
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 60 * 180 / M_PI + height[i], radius[i]);
+    }
+    TEST_ASSERT_EQUAL_INT(-1, EcefToGeodetic(x, y, z, 8, lat2, lon2, height2, n));
+    TEST_ASSERT_EQUAL_INT(-1, GeodeticToEcef(lat, lon, height, -1, x, y, z, n));
+}
+
 void test_Standard_temperature(void) {
     // Standard atmosphere temperatures at various altitudes
     // Format: altitude in feet, expected temperature in Celsius
@@ -242,18 +1703,376 @@ void test_Pressure_at_tropopause(void) {
     TEST_ASSERT_DOUBLE_WITHIN(1.0, 22632.06, p);
 }
 
+void test_Pressure_and_density_bands(void) {
+    // U.S. Standard Atmosphere 1976 at the band bases, by geopotential
+    // altitude, which equals the ICAO atmosphere to 80 km
+    struct {
+        double km, pressure, density;
+    } table[] = {
+        { 0.0, 101325.0,   1.225000},
+        {11.0,  22632.06,  0.3639176},
+        {20.0,   5474.889, 0.08803471},
+        {32.0,    868.0187, 0.01322500},
+        {47.0,    110.9063, 1.427532e-3},
+        {51.0,    66.93887, 8.616010e-4},
+        {71.0,    3.956420, 6.421078e-5},
+        {80.0,    0.8862745, 1.570e-5},
+    };
+    char message[100];
+
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        double h = table[i].km * 1000 / 0.3048, oat = 0.0;
+
+        sprintf(message, "%.0f km", table[i].km);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-5 * table[i].pressure, table[i].pressure, Pressure_at_altitude(&h), message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(2e-4 * table[i].density, table[i].density, Density_at_altitude(&h, &oat), message);
+    }
+
+    // Continuous across the band bases
+    double bases[] = {11.0, 20.0, 32.0, 47.0, 51.0, 71.0};
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        double below = bases[i] * 1000 / 0.3048 - 1e-6, above = below + 2e-6, oat = 0.0;
+        double p = Pressure_at_altitude(&below);
+
+        sprintf(message, "%.0f km", bases[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * p, p, Pressure_at_altitude(&above), message);
+        p = Density_at_altitude(&below, &oat);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * p, p, Density_at_altitude(&above, &oat), message);
+    }
+
+    double low = -16500.0, high = 262500.0, oat = 0.0;
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, Pressure_at_altitude(&low));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, Pressure_at_altitude(&high));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, Density_at_altitude(&low, &oat));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, Density_at_altitude(&high, &oat));
+}
+
+void test_AtmosphereStateBatch(void) {
+    // The same state as the scalar functions, with and without a deviation from ISA
+    enum { n = 1000 };
+    static double h[n], dev[n], T[n], p[n], rho[n], a[n], sigma[n];
+    static double Td[n], pd[n], rhod[n], ad[n], sigmad[n];
+    AtmosphereState state = {T, p, rho, a, sigma}, hot = {Td, pd, rhod, ad, sigmad};
+    char message[100];
+
+    for (int i = 0; i < n; i++) {
+        h[i]   = -16400.0 + (262400.0 + 16400.0) * i / (n - 1);
+        dev[i] = -30.0 + 60.0 * (i % 7) / 6.0;
+    }
+    h[1] = 0.0;
+    TEST_ASSERT_EQUAL_INT(0, AtmosphereStateBatch(h, NULL, &state, n));
+    TEST_ASSERT_EQUAL_INT(0, AtmosphereStateBatch(h, dev, &hot, n));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 1.0, sigma[1]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-7, rho_0, rho[1]);
+
+    for (int i = 0; i < n; i++) {
+        double oat = Standard_temperature(&h[i]), oat_hot = oat + dev[i];
+        double pressure = Pressure_at_altitude(&h[i]), density = Density_at_altitude(&h[i], &oat);
+
+        sprintf(message, "Altitude %.1f ft", h[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, oat, T[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12 * pressure, pressure, p[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12 * density, density, rho[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, Speed_of_sound(&oat), a[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12, density / rho[1], sigma[i], message);
+
+        // The pressure is set by the pressure altitude, the density by the gas law
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, oat_hot, Td[i], message);
+        TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(p[i], pd[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12 * density, density * (oat + 273.15) / (oat_hot + 273.15), rhod[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9, Speed_of_sound(&oat_hot), ad[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-12, rhod[i] / rho[i] * sigma[i], sigmad[i], message);
+    }
+
+    // Outside the model every quantity is NaN
+    double outside[3] = {-16500.0, 10000.0, 262500.0};
+    TEST_ASSERT_EQUAL_INT(2, AtmosphereStateBatch(outside, NULL, &state, 3));
+    for (int i = 0; i < 3; i += 2) {
+        TEST_ASSERT_TRUE(isnan(T[i]) && isnan(p[i]) && isnan(rho[i]) && isnan(a[i]) && isnan(sigma[i]));
+    }
+    TEST_ASSERT_FALSE(isnan(T[1]) || isnan(p[1]) || isnan(rho[1]) || isnan(a[1]) || isnan(sigma[1]));
+    TEST_ASSERT_EQUAL_INT(0, AtmosphereStateBatch(outside, NULL, &state, 0));
+}
+
+void test_AtmosphereTable(void) {
+    // Table lookup within its stated bound of the exact functions, and the bound tight
+    enum { n = 100001 };
+    static double h[n], exact_p[n], exact_rho[n];
+    double none = 0.0, step = AVCALC_ATMOSPHERE_TABLE_STEP, half = step / 2, oat = 0.0;
+    char message[100];
+
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, AtmosphereTableSelect(&none));
+    for (int i = 0; i < n; i++) {
+        h[i] = -16404.0 + (262467.0 + 16404.0) * i / (n - 1);
+        exact_p[i]   = Pressure_at_altitude(&h[i]);
+        exact_rho[i] = Density_at_altitude(&h[i], &oat);
+    }
+    double exact_T = Standard_temperature(&h[n / 3]);
+
+    double bound = AtmosphereTableSelect(&step);
+    TEST_ASSERT_TRUE(bound > 0.0 && bound < 1e-6);
+    double worst = 0.0;
+    for (int i = 0; i < n; i++) {
+        double p = Pressure_at_altitude(&h[i]), rho = Density_at_altitude(&h[i], &oat);
+
+        sprintf(message, "Altitude %.1f ft", h[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(bound * exact_p[i], exact_p[i], p, message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(bound * exact_rho[i], exact_rho[i], rho, message);
+        worst = fmax(worst, fabs(p / exact_p[i] - 1));
+    }
+    TEST_ASSERT_TRUE(worst > 0.8 * bound);
+    TEST_ASSERT_EQUAL_DOUBLE(exact_T, Standard_temperature(&h[n / 3]));
+
+    // Exact at the band bases, which are nodes
+    double bases[] = {11.0, 20.0, 32.0, 47.0, 51.0, 71.0};
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        double base = bases[i] * 1000 / 0.3048, p = Pressure_at_altitude(&base);
+
+        AtmosphereTableSelect(&none);
+        TEST_ASSERT_DOUBLE_WITHIN(1e-13 * p, Pressure_at_altitude(&base), p);
+        AtmosphereTableSelect(&step);
+    }
+
+    // Half the step, a quarter of the error
+    TEST_ASSERT_DOUBLE_WITHIN(0.01 * bound, bound / 4, AtmosphereTableSelect(&half));
+    double low = -16500.0, high = 262500.0;
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, Pressure_at_altitude(&low));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, Density_at_altitude(&high, &oat));
+
+    double invalid[] = {-100.0, 0.5, NAN, INFINITY, -INFINITY};
+    double tabled = Pressure_at_altitude(&h[n / 3]);
+    TEST_ASSERT_TRUE(tabled != exact_p[n / 3]);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        TEST_ASSERT_EQUAL_DOUBLE(-1.0, AtmosphereTableSelect(&invalid[i]));
+    }
+
+    // A step rejected leaves the table of the half step selected
+    TEST_ASSERT_EQUAL_DOUBLE(tabled, Pressure_at_altitude(&h[n / 3]));
+    TEST_ASSERT_DOUBLE_WITHIN(0.01 * bound, bound / 4, AtmosphereTableSelect(&half));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, AtmosphereTableSelect(&none));
+    TEST_ASSERT_EQUAL_DOUBLE(exact_p[n / 3], Pressure_at_altitude(&h[n / 3]));
+}
+
+void test_TAS_CAS(void) {
+    // Worked example of the formulary: CAS 250 kt at 10000 ft and -6.72 C
+    double cas = 250.0, pa = 10000.0, oat = -6.72;
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, 287.7, TAS_2(&cas, &pa, &oat));
+
+    // Subsonic in the standard atmosphere: CAS 300 kt at FL300 is Mach 0.7906
+    pa = 30000.0;
+    oat = Standard_temperature(&pa);
+    cas = 300.0;
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 465.94079664732396, TAS_2(&cas, &pa, &oat));
+
+    // Mach 2 at 11 km: Rayleigh's equation for the Mach number and again for CAS
+    double tas = 1147.1384367518956;
+    pa = 11000 / 0.3048;
+    oat = -56.5;
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 702.2618561624321, CAS_2(&tas, &pa, &oat));
+    cas = 702.2618561624321;
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, tas, TAS_2(&cas, &pa, &oat));
+
+    // At sea level in the standard atmosphere CAS is TAS, on both sides of Mach 1
+    double sl = 0.0, isa = 15.0;
+    double speeds[] = {0.0, 120.0, 661.0, 661.478604273801, 662.0, 1400.0, 2600.0};
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9 * speeds[i] + 1e-12, speeds[i], TAS_2(&speeds[i], &sl, &isa));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9 * speeds[i] + 1e-12, speeds[i], CAS_2(&speeds[i], &sl, &isa));
+    }
+
+    // Each the inverse of the other, up the atmosphere
+    for (pa = -15000.0; pa <= 150000.0; pa += 5000.0) {
+        oat = Standard_temperature(&pa) + 10.0;
+        for (tas = 50.0; tas <= 2000.0; tas += 150.0) {
+            cas = CAS_2(&tas, &pa, &oat);
+            TEST_ASSERT_DOUBLE_WITHIN(1e-9 * tas, tas, TAS_2(&cas, &pa, &oat));
+        }
+    }
+
+    double negative = -1.0, frozen = -273.15, high = 262500.0;
+    cas = 250.0;
+    pa = 10000.0;
+    oat = 0.0;
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, TAS_2(&negative, &pa, &oat));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, CAS_2(&cas, &pa, &frozen));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, TAS_2(&cas, &high, &oat));
+}
+
+void test_AirspeedBatch(void) {
+    // The same as the scalar functions, subsonic and supersonic, with the invalid samples NaN
+    enum { n = 2000 };
+    static double cas[n], pa[n], oat[n], tas[n], back[n];
+    char message[100];
+
+    for (int i = 0; i < n; i++) {
+        pa[i]  = -16000.0 + 270000.0 * (i % 97) / 96.0;
+        oat[i] = Standard_temperature(&pa[i]) - 20.0 + (i % 5) * 10.0;
+        cas[i] = 30.0 * (i % 41);
+    }
+    pa[7]   = 263000.0;
+    oat[8]  = -300.0;
+    cas[9]  = -5.0;
+    TEST_ASSERT_EQUAL_INT(3, TrueAirspeedBatch(cas, pa, oat, tas, n));
+    TEST_ASSERT_EQUAL_INT(3, CalibratedAirspeedBatch(tas, pa, oat, back, n));
+
+    for (int i = 0; i < n; i++) {
+        sprintf(message, "CAS %.0f kt at %.0f ft", cas[i], pa[i]);
+        if (i >= 7 && i <= 9) {
+            TEST_ASSERT_TRUE_MESSAGE(isnan(tas[i]) && isnan(back[i]), message);
+            continue;
+        }
+        double expected = TAS_2(&cas[i], &pa[i], &oat[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * expected + 1e-9, expected, tas[i], message);
+        expected = CAS_2(&tas[i], &pa[i], &oat[i]);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * expected + 1e-9, expected, back[i], message);
+        TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * cas[i] + 1e-9, cas[i], back[i], message);
+    }
+    TEST_ASSERT_EQUAL_INT(0, TrueAirspeedBatch(cas, pa, oat, tas, 0));
+}
+
+void test_AirspeedConvert(void) {
+    // Every pair of kinds against TAS_2(), CAS_2() and the atmosphere at FL300, ISA+10
+    double pa = 30000.0, oat = Standard_temperature(&pa) + 10.0, sl = 0.0, isa = 15.0;
+    AirData air, sea;
+    char message[100];
+
+    TEST_ASSERT_EQUAL_INT(0, AirDataInit(&pa, &oat, &air));
+    TEST_ASSERT_EQUAL_INT(0, AirDataInit(&sl, &isa, &sea));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, Pressure_at_altitude(&pa) / 101325.0, air.delta);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, Speed_of_sound(&oat), air.sound);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 1.0, sea.sigma);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, air.delta * 288.15 / (oat + 273.15), air.sigma);
+
+    double speeds[] = {0.0, 150.0, 300.0, 500.0, 800.0, 1500.0};
+    for (size_t k = 0; k < sizeof(speeds) / sizeof(speeds[0]); k++) {
+        double tas = speeds[k], mach = tas / air.sound, eas = tas * sqrt(air.sigma), cas = CAS_2(&tas, &pa, &oat);
+        double value[4];
+
+        value[AVCALC_SPEED_CAS]  = cas;
+        value[AVCALC_SPEED_EAS]  = eas;
+        value[AVCALC_SPEED_TAS]  = tas;
+        value[AVCALC_SPEED_MACH] = mach;
+        for (int from = AVCALC_SPEED_CAS; from <= AVCALC_SPEED_MACH; from++) {
+            for (int to = AVCALC_SPEED_CAS; to <= AVCALC_SPEED_MACH; to++) {
+                sprintf(message, "TAS %.0f kt, %d to %d", tas, from, to);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * value[to] + 1e-12, value[to], AirspeedConvert(&air, from, to, &value[from]), message);
+            }
+        }
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9 * tas + 1e-12, tas, TAS_2(&cas, &pa, &oat));
+
+        // At sea level in the standard atmosphere CAS, EAS and TAS are one
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9 * tas + 1e-12, tas, AirspeedConvert(&sea, AVCALC_SPEED_TAS, AVCALC_SPEED_CAS, &tas));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9 * tas + 1e-12, tas, AirspeedConvert(&sea, AVCALC_SPEED_TAS, AVCALC_SPEED_EAS, &tas));
+    }
+
+    // Compressibility: at altitude EAS is below CAS
+    double cas = 300.0;
+    TEST_ASSERT_TRUE(AirspeedConvert(&air, AVCALC_SPEED_CAS, AVCALC_SPEED_EAS, &cas) < cas - 5.0);
+
+    double negative = -1.0, frozen = -274.0, high = 262500.0;
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, AirspeedConvert(&air, AVCALC_SPEED_CAS, AVCALC_SPEED_TAS, &negative));
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, AirspeedConvert(&air, 4, AVCALC_SPEED_TAS, &cas));
+    TEST_ASSERT_EQUAL_INT(-1, AirDataInit(&pa, &frozen, &sea));
+    TEST_ASSERT_EQUAL_INT(-1, AirDataInit(&high, &oat, &sea));
+}
+
+void test_AirspeedConvertBatch(void) {
+    // Batches and cached levels the same as AirspeedConvert(), subsonic and supersonic
+    enum { n = 600 };
+    static double pa[n], oat[n], speed[n], result[n];
+    double levels[] = {0.0, 10000.0, 35000.0, 65000.0};
+    AirDataCache *cache = AirDataCacheCreate(3);
+    char message[100];
+
+    for (int i = 0; i < n; i++) {
+        pa[i]    = levels[i / 150];
+        oat[i]   = Standard_temperature(&pa[i]) + (i / 50 % 3) * 5.0;
+        speed[i] = (i % 50) * 30.0;
+    }
+    speed[3] = -10.0;
+    speed[4] = NAN;
+
+    for (int from = AVCALC_SPEED_CAS; from <= AVCALC_SPEED_MACH; from++) {
+        for (int to = AVCALC_SPEED_CAS; to <= AVCALC_SPEED_MACH; to++) {
+            double scale = (from == AVCALC_SPEED_MACH) ? 1.0 / 400 : 1.0;
+            static double scaled[n];
+
+            for (int i = 0; i < n; i++) {
+                scaled[i] = speed[i] * scale;
+            }
+            TEST_ASSERT_EQUAL_INT(2, AirspeedConvertLevels(cache, pa, oat, from, to, scaled, result, n));
+            for (int i = 0; i < n; i++) {
+                AirData air;
+                double expected;
+
+                sprintf(message, "Speed %g at %.0f ft, %d to %d", scaled[i], pa[i], from, to);
+                AirDataInit(&pa[i], &oat[i], &air);
+                if (i == 3 || i == 4) {
+                    TEST_ASSERT_TRUE_MESSAGE(isnan(result[i]), message);
+                    continue;
+                }
+                expected = AirspeedConvert(&air, from, to, &scaled[i]);
+                TEST_ASSERT_DOUBLE_WITHIN_MESSAGE(1e-9 * expected + 1e-12, expected, result[i], message);
+            }
+        }
+    }
+
+    // The same pair gives the same slot, a pair outside the model none
+    const AirData *first = AirDataCacheGet(cache, &pa[200], &oat[200]);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_EQUAL_PTR(first, AirDataCacheGet(cache, &pa[200], &oat[200]));
+    TEST_ASSERT_EQUAL_DOUBLE(pa[200], first->pressure_alt);
+    double high = 262500.0;
+    TEST_ASSERT_NULL(AirDataCacheGet(cache, &high, &oat[0]));
+    TEST_ASSERT_EQUAL_INT(-1, AirspeedConvertLevels(cache, pa, oat, -1, AVCALC_SPEED_TAS, speed, result, n));
+    TEST_ASSERT_EQUAL_INT(0, AirspeedConvertLevels(cache, pa, oat, AVCALC_SPEED_CAS, AVCALC_SPEED_TAS, speed, result, 0));
+    TEST_ASSERT_NULL(AirDataCacheCreate(0));
+    AirDataCacheFree(cache);
+    AirDataCacheFree(NULL);
+}
+
 int main(void) {
     UNITY_BEGIN();
     
     RUN_TEST(test_Distance);
+    RUN_TEST(test_DistanceBatch);
+    RUN_TEST(test_DistanceMatrix);
+    RUN_TEST(test_DistanceMatrixSymmetric);
+    RUN_TEST(test_MathBatch);
     RUN_TEST(test_CourseInitial_LAX_to_JFK);
     RUN_TEST(test_IntermediatePoint);
+    RUN_TEST(test_PreparedPoint);
+    RUN_TEST(test_IntermediatePoints);
+    RUN_TEST(test_IntermediatePointsSpacing);
+    RUN_TEST(test_Inverse);
+    RUN_TEST(test_Direct);
+    RUN_TEST(test_CrossTrack);
+    RUN_TEST(test_RouteMatcher);
+    RUN_TEST(test_SphericalPolygon);
+    RUN_TEST(test_RadialIntersection);
+    RUN_TEST(test_LegVertex);
+    RUN_TEST(test_CrossParallel);
+    RUN_TEST(test_Rhumb);
+    RUN_TEST(test_LocalFrame);
+    RUN_TEST(test_ClosestApproach);
+    RUN_TEST(test_ConflictDetect);
+    RUN_TEST(test_PointIndex);
+    RUN_TEST(test_Route);
+    RUN_TEST(test_Geodesic);
+    RUN_TEST(test_EcefConversion);
 
     RUN_TEST(test_Standard_temperature);
     RUN_TEST(test_Speed_of_sound);
     RUN_TEST(test_Density_at_sea_level);
     RUN_TEST(test_Pressure_at_sea_level);
     RUN_TEST(test_Pressure_at_tropopause);
+    RUN_TEST(test_Pressure_and_density_bands);
+    RUN_TEST(test_AtmosphereStateBatch);
+    RUN_TEST(test_AtmosphereTable);
+    RUN_TEST(test_TAS_CAS);
+    RUN_TEST(test_AirspeedBatch);
+    RUN_TEST(test_AirspeedConvert);
+    RUN_TEST(test_AirspeedConvertBatch);
     
     return UNITY_END();
 }
\ No newline at end of file